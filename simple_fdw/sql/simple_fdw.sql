@@ -24,6 +24,63 @@ RETURNS void
 AS 'MODULE_PATHNAME'
 LANGUAGE C STRICT;
 
+CREATE FUNCTION simple_fdw_statement_cache(OUT hits bigint,
+    OUT misses bigint,
+    OUT evictions bigint,
+    OUT cached integer)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION simple_fdw_stats(OUT dbid oid,
+    OUT relid oid,
+    OUT scans bigint,
+    OUT remote_scans bigint,
+    OUT pushed_scans bigint,
+    OUT rows bigint,
+    OUT bytes bigint,
+    OUT connection_hits bigint,
+    OUT connection_misses bigint,
+    OUT statement_hits bigint,
+    OUT statement_misses bigint,
+    OUT open_time double precision,
+    OUT prepare_time double precision,
+    OUT step_time double precision,
+    OUT convert_time double precision)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION simple_fdw_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+CREATE VIEW simple_fdw_stats AS
+  SELECT * FROM simple_fdw_stats();
+
+CREATE FUNCTION simple_fdw_result_cache(OUT hits bigint,
+    OUT misses bigint,
+    OUT stores bigint,
+    OUT evictions bigint,
+    OUT rejections bigint,
+    OUT invalidations bigint,
+    OUT entries integer,
+    OUT bytes bigint)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Resets the results of a database file, or all of them by default.
+CREATE FUNCTION simple_fdw_result_cache_reset(database text DEFAULT NULL)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+-- Don't want these to be available to non-superusers.
+REVOKE ALL ON FUNCTION simple_fdw_stats_reset() FROM PUBLIC;
+REVOKE ALL ON FUNCTION simple_fdw_result_cache_reset(text) FROM PUBLIC;
+
 CREATE FOREIGN DATA WRAPPER simple_fdw
   HANDLER simple_fdw_handler
   VALIDATOR simple_fdw_validator;
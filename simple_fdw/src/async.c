@@ -0,0 +1,410 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Background fetching of SQLite rows, for asynchronous foreign scans.
+ *
+ * Each asynchronous scan gets a thread that steps through its statement,
+ * a batch of rows at a time, while the backend does something else, like
+ * reading the other partitions of an Append.  The thread only calls SQLite
+ * functions: it copies the values of the rows with sqlite3_value_dup, and
+ * the backend converts them into Datums once the batch is complete.  The
+ * end of a batch is signalled by writing to a pipe, which the executor
+ * waits on along with the other asynchronous requests.
+ *
+ * The statement belongs to the thread from simpleAsyncStart until the
+ * batch has been taken by simpleAsyncTake, or until simpleAsyncWait
+ * returns; the backend must not touch it in between.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/async.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#if (PG_VERSION_NUM >= 140000)
+
+#include "lib/ilist.h"
+
+#include "simple_fdw.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+typedef enum SimpleAsyncState
+{
+	ASYNC_IDLE,					/* nothing to do, the backend owns stmt */
+	ASYNC_RUNNING,				/* the thread is fetching a batch */
+	ASYNC_READY,				/* a batch is ready to be taken */
+	ASYNC_STOP					/* the thread must exit */
+} SimpleAsyncState;
+
+struct SimpleAsyncFetcher
+{
+	dlist_node	node;			/* in the list of all the fetchers */
+
+	pthread_t	thread;
+	pthread_mutex_t mutex;		/* protects the fields below */
+	pthread_cond_t wakeup;		/* signalled by the backend */
+	pthread_cond_t done;		/* signalled by the thread */
+	SimpleAsyncState state;
+
+	int			pipefd[2];		/* read end is waited on by the backend */
+
+	sqlite3_stmt *stmt;			/* statement of the current batch */
+	int			ncolumns;
+	int			fetch_size;
+
+	/* The current batch, row by row */
+	sqlite3_value **values;		/* ncolumns * fetch_size values */
+	int			nrows;
+	bool		eof;			/* has the statement returned all its rows? */
+	int			rc;				/* SQLite error code, if an error happened */
+	char	   *errmsg;			/* its message, malloc'd */
+};
+
+/*
+ * All the fetchers created by this backend, so that their threads can be
+ * stopped at the end of the transaction, even after an error.  The
+ * fetchers are malloc'd, as they have to outlive the memory contexts of the
+ * scans in that case.
+ */
+static dlist_head all_fetchers = DLIST_STATIC_INIT(all_fetchers);
+
+static void *fetcher_main(void *arg);
+static void free_batch(SimpleAsyncFetcher *fetcher);
+static void destroy_fetcher(SimpleAsyncFetcher *fetcher);
+
+
+/*
+ * Asynchronous scans need a SQLite library built in serialized mode, as
+ * the connection may be used by the backend while a thread steps through
+ * one of its statements.
+ */
+bool
+simpleAsyncSupported(void)
+{
+	return sqlite3_threadsafe() == 1;
+}
+
+/*
+ * Create a fetcher and its thread.  Returns NULL if that's not possible,
+ * in which case the scan fetches its rows synchronously.
+ */
+SimpleAsyncFetcher *
+simpleAsyncCreate(int ncolumns, int fetch_size)
+{
+	SimpleAsyncFetcher *fetcher;
+	sigset_t	sigs;
+	sigset_t	oldsigs;
+	int			rc;
+
+	fetcher = (SimpleAsyncFetcher *) calloc(1, sizeof(SimpleAsyncFetcher));
+	if (fetcher == NULL)
+		return NULL;
+
+	fetcher->ncolumns = ncolumns;
+	fetcher->fetch_size = fetch_size;
+	fetcher->values = (sqlite3_value **) calloc((size_t) Max(ncolumns, 1) * fetch_size,
+												sizeof(sqlite3_value *));
+	if (fetcher->values == NULL)
+	{
+		free(fetcher);
+		return NULL;
+	}
+
+	if (pipe(fetcher->pipefd) != 0)
+	{
+		free(fetcher->values);
+		free(fetcher);
+		return NULL;
+	}
+	fcntl(fetcher->pipefd[0], F_SETFL, O_NONBLOCK);
+	fcntl(fetcher->pipefd[1], F_SETFL, O_NONBLOCK);
+
+	pthread_mutex_init(&fetcher->mutex, NULL);
+	pthread_cond_init(&fetcher->wakeup, NULL);
+	pthread_cond_init(&fetcher->done, NULL);
+	fetcher->state = ASYNC_IDLE;
+
+	/* The signals are for the backend, block them in the thread */
+	sigfillset(&sigs);
+	pthread_sigmask(SIG_SETMASK, &sigs, &oldsigs);
+	rc = pthread_create(&fetcher->thread, NULL, fetcher_main, fetcher);
+	pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+	if (rc != 0)
+	{
+		close(fetcher->pipefd[0]);
+		close(fetcher->pipefd[1]);
+		pthread_mutex_destroy(&fetcher->mutex);
+		pthread_cond_destroy(&fetcher->wakeup);
+		pthread_cond_destroy(&fetcher->done);
+		free(fetcher->values);
+		free(fetcher);
+		return NULL;
+	}
+
+	dlist_push_head(&all_fetchers, &fetcher->node);
+
+	return fetcher;
+}
+
+/*
+ * Returns the file descriptor to wait on for the end of a batch.
+ */
+int
+simpleAsyncGetFd(SimpleAsyncFetcher *fetcher)
+{
+	return fetcher->pipefd[0];
+}
+
+/*
+ * Have the next batch of rows of stmt fetched in the background.  Does
+ * nothing if a batch is already being fetched, or is ready.
+ */
+void
+simpleAsyncStart(SimpleAsyncFetcher *fetcher, sqlite3_stmt *stmt)
+{
+	pthread_mutex_lock(&fetcher->mutex);
+	if (fetcher->state == ASYNC_IDLE)
+	{
+		fetcher->stmt = stmt;
+		fetcher->state = ASYNC_RUNNING;
+		pthread_cond_signal(&fetcher->wakeup);
+	}
+	pthread_mutex_unlock(&fetcher->mutex);
+}
+
+/*
+ * Take the batch fetched in the background, if it's ready.  Its values are
+ * returned in *values, row after row, and stay valid until the next call
+ * to simpleAsyncStart or simpleAsyncWait.  Raises the error SQLite
+ * returned, if any.
+ */
+bool
+simpleAsyncTake(SimpleAsyncFetcher *fetcher, sqlite3_value ***values,
+				int *nrows, bool *eof)
+{
+	char		buf[64];
+	bool		ready;
+
+	/* Empty the pipe, the state tells what happened */
+	while (read(fetcher->pipefd[0], buf, sizeof(buf)) > 0)
+		;
+
+	pthread_mutex_lock(&fetcher->mutex);
+	ready = (fetcher->state == ASYNC_READY);
+	if (ready)
+		fetcher->state = ASYNC_IDLE;
+	pthread_mutex_unlock(&fetcher->mutex);
+
+	if (!ready)
+		return false;
+
+	if (fetcher->rc != SQLITE_OK && fetcher->rc != SQLITE_DONE)
+	{
+		char	   *msg = pstrdup(fetcher->errmsg ? fetcher->errmsg : "");
+		int			rc = fetcher->rc;
+
+		free(fetcher->errmsg);
+		fetcher->errmsg = NULL;
+		fetcher->rc = SQLITE_OK;
+		ereport(ERROR,
+			(errcode(simpleSqliteErrcode(rc)),
+			errmsg("SQL error during fetch: %s", msg)
+			));
+	}
+
+	*values = fetcher->values;
+	*nrows = fetcher->nrows;
+	*eof = fetcher->eof;
+
+	return true;
+}
+
+/*
+ * Wait for the batch being fetched, if any, and throw it away.  The
+ * backend owns the statement again afterwards, to reset it for example.
+ */
+void
+simpleAsyncWait(SimpleAsyncFetcher *fetcher)
+{
+	char		buf[64];
+
+	pthread_mutex_lock(&fetcher->mutex);
+	while (fetcher->state == ASYNC_RUNNING)
+		pthread_cond_wait(&fetcher->done, &fetcher->mutex);
+	if (fetcher->state == ASYNC_READY)
+		fetcher->state = ASYNC_IDLE;
+	pthread_mutex_unlock(&fetcher->mutex);
+
+	while (read(fetcher->pipefd[0], buf, sizeof(buf)) > 0)
+		;
+
+	free_batch(fetcher);
+	free(fetcher->errmsg);
+	fetcher->errmsg = NULL;
+	fetcher->rc = SQLITE_OK;
+}
+
+/*
+ * Wait for the fetchers running stmt, if any, before it is reset by the
+ * cleanup of an aborted subtransaction.
+ */
+void
+simpleAsyncWaitStatement(sqlite3_stmt *stmt)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &all_fetchers)
+	{
+		SimpleAsyncFetcher *fetcher = dlist_container(SimpleAsyncFetcher,
+													  node, iter.cur);
+
+		if (fetcher->stmt == stmt)
+			simpleAsyncWait(fetcher);
+	}
+}
+
+/*
+ * Stop the thread of a fetcher, and free it.
+ */
+void
+simpleAsyncDestroy(SimpleAsyncFetcher *fetcher)
+{
+	dlist_delete(&fetcher->node);
+	destroy_fetcher(fetcher);
+}
+
+/*
+ * Stop all the fetchers of the backend.  Called at the end of each
+ * transaction, before the statements are released: after an error, the
+ * scans that created them didn't get a chance to do it.
+ */
+void
+simpleAsyncDestroyAll(void)
+{
+	dlist_mutable_iter iter;
+
+	dlist_foreach_modify(iter, &all_fetchers)
+	{
+		SimpleAsyncFetcher *fetcher = dlist_container(SimpleAsyncFetcher,
+													  node, iter.cur);
+
+		dlist_delete(&fetcher->node);
+		destroy_fetcher(fetcher);
+	}
+}
+
+static void
+destroy_fetcher(SimpleAsyncFetcher *fetcher)
+{
+	pthread_mutex_lock(&fetcher->mutex);
+	while (fetcher->state == ASYNC_RUNNING)
+		pthread_cond_wait(&fetcher->done, &fetcher->mutex);
+	fetcher->state = ASYNC_STOP;
+	pthread_cond_signal(&fetcher->wakeup);
+	pthread_mutex_unlock(&fetcher->mutex);
+
+	pthread_join(fetcher->thread, NULL);
+
+	close(fetcher->pipefd[0]);
+	close(fetcher->pipefd[1]);
+	pthread_mutex_destroy(&fetcher->mutex);
+	pthread_cond_destroy(&fetcher->wakeup);
+	pthread_cond_destroy(&fetcher->done);
+	free_batch(fetcher);
+	free(fetcher->values);
+	free(fetcher->errmsg);
+	free(fetcher);
+}
+
+/*
+ * Free the values of the current batch.
+ */
+static void
+free_batch(SimpleAsyncFetcher *fetcher)
+{
+	int			i;
+
+	for (i = 0; i < fetcher->nrows * fetcher->ncolumns; i++)
+	{
+		sqlite3_value_free(fetcher->values[i]);
+		fetcher->values[i] = NULL;
+	}
+	fetcher->nrows = 0;
+}
+
+/*
+ * Main loop of a fetcher thread.  Nothing here may call into PostgreSQL:
+ * no palloc, no elog, only SQLite and the C library.
+ */
+static void *
+fetcher_main(void *arg)
+{
+	SimpleAsyncFetcher *fetcher = (SimpleAsyncFetcher *) arg;
+
+	pthread_mutex_lock(&fetcher->mutex);
+	for (;;)
+	{
+		int			rc = SQLITE_OK;
+
+		while (fetcher->state == ASYNC_IDLE || fetcher->state == ASYNC_READY)
+			pthread_cond_wait(&fetcher->wakeup, &fetcher->mutex);
+		if (fetcher->state == ASYNC_STOP)
+			break;
+
+		/* ASYNC_RUNNING: the batch and the statement are ours */
+		pthread_mutex_unlock(&fetcher->mutex);
+
+		free_batch(fetcher);
+		fetcher->eof = false;
+		while (fetcher->nrows < fetcher->fetch_size)
+		{
+			int			row = fetcher->nrows;
+			int			x;
+
+			rc = sqlite3_step(fetcher->stmt);
+			if (rc != SQLITE_ROW)
+			{
+				fetcher->eof = true;
+				break;
+			}
+
+			for (x = 0; x < fetcher->ncolumns; x++)
+				fetcher->values[row * fetcher->ncolumns + x] =
+					sqlite3_value_dup(sqlite3_column_value(fetcher->stmt, x));
+			fetcher->nrows++;
+		}
+
+		if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+		{
+			fetcher->rc = rc;
+			fetcher->errmsg = strdup(sqlite3_errmsg(sqlite3_db_handle(fetcher->stmt)));
+		}
+
+		pthread_mutex_lock(&fetcher->mutex);
+		fetcher->state = ASYNC_READY;
+		pthread_cond_signal(&fetcher->done);
+		if (write(fetcher->pipefd[1], "x", 1) < 0)
+		{
+			/* the pipe is full, the backend will see the state anyway */
+		}
+	}
+	pthread_mutex_unlock(&fetcher->mutex);
+
+	return NULL;
+}
+
+#endif
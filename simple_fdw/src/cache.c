@@ -0,0 +1,828 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Result cache of the scans of immutable databases, shared by all the
+ * backends.
+ *
+ * A scan of a server with the result_cache option looks its result up
+ * before running its query, and returns the cached rows if it's found.
+ * Otherwise, it records the rows it fetches, and stores them when it has
+ * read them all, if they are not too many.  A result is found again by a
+ * key made of the identity of the database file (device, inode, size and
+ * modification time), the query, the types of its result columns and the
+ * values bound to its parameters, so replacing a database file makes its
+ * results unreachable.
+ *
+ * The results are kept, converted to Datums, in a ring buffer of
+ * simple_fdw.result_cache_size, the oldest ones being evicted to make room
+ * for new ones; a shared hash table, of at most
+ * simple_fdw.result_cache_entries entries, finds them from a digest of
+ * their key.  Both are allocated at server start, which needs simple_fdw
+ * in shared_preload_libraries.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#if (PG_VERSION_NUM >= 130000)
+#include "common/hashfn.h"
+#endif
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+#include "simple_fdw.h"
+
+#include <sys/stat.h>
+
+/* GUC variables */
+int			simple_result_cache_size = 0;
+int			simple_result_cache_entries = 1000;
+int			simple_result_cache_max_entry = 1024;
+
+PG_FUNCTION_INFO_V1(simple_fdw_result_cache);
+PG_FUNCTION_INFO_V1(simple_fdw_result_cache_reset);
+
+/* What a scan did with the cache */
+typedef enum SimpleCacheStatus
+{
+	SIMPLE_CACHE_NEW,			/* not looked up yet */
+	SIMPLE_CACHE_HIT,			/* found, the rows are read from the cache */
+	SIMPLE_CACHE_RECORDING,		/* not found, the rows fetched are recorded */
+	SIMPLE_CACHE_MISS,			/* not found, nor recorded */
+	SIMPLE_CACHE_STORED			/* not found, the rows fetched were stored */
+} SimpleCacheStatus;
+
+/*
+ * Cache state of a scan.  The rows, recorded or read from the cache, are
+ * laid out one after the other, each one as the datumSerialize() images
+ * of its values.
+ */
+struct SimpleCacheScan
+{
+	SimpleCacheStatus status;
+	char	   *database;		/* database file */
+	StringInfoData prefix;		/* query and column types, for the key */
+	int			ncolumns;
+	int16	   *typlens;		/* type lengths of the result columns */
+	bool	   *typbyvals;		/* are they passed by value? */
+
+	/* Key and rows of the current result, in their own context */
+	MemoryContext cxt;
+	StringInfoData key;
+	StringInfoData rows;
+	char	   *next;			/* next row to read from rows */
+};
+
+#if (PG_VERSION_NUM >= 130000)
+/*
+ * Digest of the key of a cached result.  The key itself is kept with the
+ * result, to tell collisions apart.
+ */
+typedef struct SimpleCacheKey
+{
+	uint64		hash1;
+	uint64		hash2;
+} SimpleCacheKey;
+
+/*
+ * Shared hash table entry, for a cached result
+ */
+typedef struct SimpleCacheEntry
+{
+	SimpleCacheKey key;			/* hash key (must be first) */
+	uint64		dbhash;			/* hash of the database file name */
+	uint64		offset;			/* position of the result in the ring */
+	Size		keylen;			/* length of the key */
+	Size		rowslen;		/* length of the rows */
+} SimpleCacheEntry;
+
+/*
+ * Header of a result in the ring, followed by its key and its rows.  The
+ * positions in the ring only grow, the actual place of a byte being its
+ * position modulo the size of the ring.
+ */
+typedef struct SimpleCacheItem
+{
+	SimpleCacheKey key;
+	Size		size;			/* size of the header, key and rows */
+} SimpleCacheItem;
+
+/*
+ * Shared state: the lock protects the ring and the hash table, and the
+ * counters that are not atomic.
+ */
+typedef struct SimpleCacheShared
+{
+	LWLock	   *lock;
+	Size		size;			/* size of the ring */
+	uint64		head;			/* position of the next result stored */
+	uint64		tail;			/* position of the oldest result */
+	pg_atomic_uint64 hits;		/* results found */
+	pg_atomic_uint64 misses;	/* results not found */
+	pg_atomic_uint64 rejections;	/* results too large to be stored */
+	uint64		stores;			/* results stored */
+	uint64		evictions;		/* results evicted to make room */
+	uint64		invalidations;	/* results removed by a reset */
+	char		ring[FLEXIBLE_ARRAY_MEMBER];
+} SimpleCacheShared;
+
+static SimpleCacheShared *cache_shared = NULL;
+static HTAB *cache_hash = NULL;
+
+#if (PG_VERSION_NUM >= 150000)
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size cache_memsize(void);
+static void cache_shmem_request(void);
+static void cache_shmem_startup(void);
+static bool cache_type_supported(Oid typid);
+static void append_param(StringInfo buf, Oid typid, Datum value, bool isnull);
+static void make_digest(const char *key, Size len, SimpleCacheKey *digest);
+static void ring_read(uint64 pos, void *dest, Size len);
+static void ring_write(uint64 pos, const void *src, Size len);
+static void evict_oldest(void);
+#endif
+
+/*
+ * Reserve the shared memory of the result cache, when loaded by
+ * shared_preload_libraries with a cache size set.  Called by _PG_init.
+ */
+void
+simpleCacheInit(void)
+{
+#if (PG_VERSION_NUM >= 130000)
+	if (!process_shared_preload_libraries_in_progress ||
+		simple_result_cache_size == 0)
+		return;
+
+#if (PG_VERSION_NUM >= 150000)
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = cache_shmem_request;
+#else
+	cache_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = cache_shmem_startup;
+#endif
+}
+
+/*
+ * Get the cache state of a scan running "sql" on "database", whose result
+ * columns have the given types.  Returns NULL if the result cache is not
+ * enabled, or if some columns have types whose conversion may depend on
+ * settings, like dates, as the rows are cached converted.
+ */
+SimpleCacheScan *
+simpleCacheBegin(const char *database, const char *sql,
+				 int ncolumns, const Oid *coltypes, const int32 *typmods)
+{
+#if (PG_VERSION_NUM >= 130000)
+	SimpleCacheScan *cs;
+	int			x;
+
+	if (cache_hash == NULL || simple_result_cache_max_entry == 0)
+		return NULL;
+
+	for (x = 0; x < ncolumns; x++)
+		if (!cache_type_supported(coltypes[x]))
+			return NULL;
+
+	cs = (SimpleCacheScan *) palloc0(sizeof(SimpleCacheScan));
+	cs->status = SIMPLE_CACHE_NEW;
+	cs->database = pstrdup(database);
+	cs->ncolumns = ncolumns;
+	cs->typlens = (int16 *) palloc(sizeof(int16) * Max(ncolumns, 1));
+	cs->typbyvals = (bool *) palloc(sizeof(bool) * Max(ncolumns, 1));
+
+	initStringInfo(&cs->prefix);
+	appendBinaryStringInfo(&cs->prefix, sql, strlen(sql) + 1);
+	appendBinaryStringInfo(&cs->prefix, (char *) &ncolumns, sizeof(int));
+	for (x = 0; x < ncolumns; x++)
+	{
+		appendBinaryStringInfo(&cs->prefix, (char *) &coltypes[x], sizeof(Oid));
+		appendBinaryStringInfo(&cs->prefix, (char *) &typmods[x], sizeof(int32));
+		get_typlenbyval(coltypes[x], &cs->typlens[x], &cs->typbyvals[x]);
+	}
+
+	cs->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									"simple_fdw result cache",
+									ALLOCSET_DEFAULT_SIZES);
+
+	return cs;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Look the result up, with the given values of the parameters, the first
+ * time the scan fetches rows.  Returns true if it was found, the rows then
+ * being read with simpleCacheRead.  Otherwise, the rows fetched should be
+ * passed to simpleCacheRecord, and simpleCacheStore called once they have
+ * all been fetched.
+ */
+bool
+simpleCacheLookup(SimpleCacheScan *cs, int nparams, const Oid *types,
+				  const Datum *values, const bool *isnull)
+{
+#if (PG_VERSION_NUM >= 130000)
+	MemoryContext oldcontext;
+	struct stat st;
+	int64		ident[4];
+	SimpleCacheKey digest;
+	SimpleCacheEntry *entry;
+	int			i;
+
+	if (cs->status != SIMPLE_CACHE_NEW)
+		return cs->status == SIMPLE_CACHE_HIT;
+
+	/* Without the identity of the file, the result can't be cached */
+	if (stat(cs->database, &st) != 0)
+	{
+		cs->status = SIMPLE_CACHE_MISS;
+		return false;
+	}
+
+	oldcontext = MemoryContextSwitchTo(cs->cxt);
+
+	/* The file, the query and its columns, then the parameters */
+	ident[0] = (int64) st.st_dev;
+	ident[1] = (int64) st.st_ino;
+	ident[2] = (int64) st.st_size;
+	ident[3] = (int64) st.st_mtime;
+	initStringInfo(&cs->key);
+	appendBinaryStringInfo(&cs->key, (char *) ident, sizeof(ident));
+	appendBinaryStringInfo(&cs->key, cs->database, strlen(cs->database) + 1);
+	appendBinaryStringInfo(&cs->key, cs->prefix.data, cs->prefix.len);
+	for (i = 0; i < nparams; i++)
+		append_param(&cs->key, types[i], values[i], isnull[i]);
+	make_digest(cs->key.data, cs->key.len, &digest);
+
+	initStringInfo(&cs->rows);
+
+	LWLockAcquire(cache_shared->lock, LW_SHARED);
+
+	entry = (SimpleCacheEntry *) hash_search(cache_hash, &digest,
+											 HASH_FIND, NULL);
+	if (entry != NULL && entry->keylen == (Size) cs->key.len)
+	{
+		uint64		pos = entry->offset + sizeof(SimpleCacheItem);
+		char	   *key = palloc(entry->keylen);
+
+		ring_read(pos, key, entry->keylen);
+		if (memcmp(key, cs->key.data, entry->keylen) == 0)
+		{
+			enlargeStringInfo(&cs->rows, entry->rowslen);
+			ring_read(pos + entry->keylen, cs->rows.data, entry->rowslen);
+			cs->rows.len = entry->rowslen;
+			cs->status = SIMPLE_CACHE_HIT;
+		}
+		pfree(key);
+	}
+
+	LWLockRelease(cache_shared->lock);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (cs->status == SIMPLE_CACHE_HIT)
+	{
+		pg_atomic_fetch_add_u64(&cache_shared->hits, 1);
+		cs->next = cs->rows.data;
+		return true;
+	}
+
+	pg_atomic_fetch_add_u64(&cache_shared->misses, 1);
+	cs->status = SIMPLE_CACHE_RECORDING;
+	return false;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Read up to maxrows rows of a result found in the cache into the
+ * prefetch buffer of the scan, kept column by column, "stride" values
+ * apart.  The values are allocated in the current memory context.
+ * Returns the number of rows read, 0 once they have all been read.
+ */
+int
+simpleCacheRead(SimpleCacheScan *cs, Datum *values, bool *nulls,
+				int stride, int maxrows)
+{
+#if (PG_VERSION_NUM >= 130000)
+	char	   *end = cs->rows.data + cs->rows.len;
+	int			row = 0;
+
+	Assert(cs->status == SIMPLE_CACHE_HIT);
+
+	while (row < maxrows && cs->next < end)
+	{
+		int			x;
+
+		for (x = 0; x < cs->ncolumns; x++)
+			values[x * stride + row] = datumRestore(&cs->next,
+													&nulls[x * stride + row]);
+		row++;
+	}
+
+	return row;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Record the rows just fetched by a scan whose result was not found.  The
+ * recording is given up, and the result won't be stored, once its size
+ * exceeds simple_fdw.result_cache_max_entry.
+ */
+void
+simpleCacheRecord(SimpleCacheScan *cs, const Datum *values, const bool *nulls,
+				  int stride, int nrows)
+{
+#if (PG_VERSION_NUM >= 130000)
+	Size		max_size = (Size) simple_result_cache_max_entry * 1024;
+	MemoryContext oldcontext;
+	int			row;
+
+	if (cs->status != SIMPLE_CACHE_RECORDING)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(cs->cxt);
+
+	for (row = 0; row < nrows; row++)
+	{
+		int			x;
+
+		for (x = 0; x < cs->ncolumns; x++)
+		{
+			Datum		value = values[x * stride + row];
+			bool		isnull = nulls[x * stride + row];
+			Size		size;
+			char	   *dest;
+
+			size = datumEstimateSpace(value, isnull,
+									  cs->typbyvals[x], cs->typlens[x]);
+			if (cs->rows.len + size > max_size)
+			{
+				pg_atomic_fetch_add_u64(&cache_shared->rejections, 1);
+				cs->status = SIMPLE_CACHE_MISS;
+				resetStringInfo(&cs->rows);
+				MemoryContextSwitchTo(oldcontext);
+				return;
+			}
+
+			enlargeStringInfo(&cs->rows, size);
+			dest = cs->rows.data + cs->rows.len;
+			datumSerialize(value, isnull, cs->typbyvals[x], cs->typlens[x],
+						   &dest);
+			cs->rows.len += size;
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+#endif
+}
+
+/*
+ * Store the result recorded by a scan, now that it has fetched all its
+ * rows, evicting the oldest results as needed.
+ */
+void
+simpleCacheStore(SimpleCacheScan *cs)
+{
+#if (PG_VERSION_NUM >= 130000)
+	SimpleCacheItem item;
+	SimpleCacheEntry *entry;
+	bool		found;
+
+	if (cs->status != SIMPLE_CACHE_RECORDING)
+		return;
+
+	item.size = MAXALIGN(sizeof(SimpleCacheItem) + cs->key.len + cs->rows.len);
+	if (item.size > cache_shared->size)
+	{
+		pg_atomic_fetch_add_u64(&cache_shared->rejections, 1);
+		cs->status = SIMPLE_CACHE_MISS;
+		return;
+	}
+	make_digest(cs->key.data, cs->key.len, &item.key);
+
+	LWLockAcquire(cache_shared->lock, LW_EXCLUSIVE);
+
+	/* Another scan may have stored the same result meanwhile */
+	if (hash_search(cache_hash, &item.key, HASH_FIND, NULL) == NULL)
+	{
+		/* Make room in the ring, and in the hash table */
+		while (cache_shared->head + item.size - cache_shared->tail >
+			   cache_shared->size)
+			evict_oldest();
+		while (hash_get_num_entries(cache_hash) >= simple_result_cache_entries &&
+			   cache_shared->tail < cache_shared->head)
+			evict_oldest();
+
+		entry = (SimpleCacheEntry *) hash_search(cache_hash, &item.key,
+												 HASH_ENTER_NULL, &found);
+		if (entry != NULL)
+		{
+			entry->dbhash = hash_bytes_extended((const unsigned char *) cs->database,
+												strlen(cs->database), 0);
+			entry->offset = cache_shared->head;
+			entry->keylen = cs->key.len;
+			entry->rowslen = cs->rows.len;
+
+			ring_write(entry->offset, &item, sizeof(SimpleCacheItem));
+			ring_write(entry->offset + sizeof(SimpleCacheItem),
+					   cs->key.data, cs->key.len);
+			ring_write(entry->offset + sizeof(SimpleCacheItem) + cs->key.len,
+					   cs->rows.data, cs->rows.len);
+			cache_shared->head += item.size;
+			cache_shared->stores++;
+		}
+	}
+
+	LWLockRelease(cache_shared->lock);
+
+	cs->status = SIMPLE_CACHE_STORED;
+	resetStringInfo(&cs->rows);
+#endif
+}
+
+/*
+ * Forget the result of a scan being restarted; it's looked up again, as
+ * the parameters may have changed.
+ */
+void
+simpleCacheRestart(SimpleCacheScan *cs)
+{
+	MemoryContextReset(cs->cxt);
+	cs->status = SIMPLE_CACHE_NEW;
+	cs->next = NULL;
+}
+
+/*
+ * Describe what a scan did with the cache, for EXPLAIN ANALYZE.
+ */
+const char *
+simpleCacheStatus(SimpleCacheScan *cs)
+{
+	switch (cs->status)
+	{
+		case SIMPLE_CACHE_HIT:
+			return "hit";
+		case SIMPLE_CACHE_STORED:
+			return "stored";
+		case SIMPLE_CACHE_RECORDING:
+		case SIMPLE_CACHE_MISS:
+			return "miss";
+		default:
+			return "not used";
+	}
+}
+
+#if (PG_VERSION_NUM >= 130000)
+static Size
+cache_memsize(void)
+{
+	Size		size;
+
+	size = add_size(offsetof(SimpleCacheShared, ring),
+					mul_size(simple_result_cache_size, 1024));
+	size = MAXALIGN(size);
+	return add_size(size,
+					hash_estimate_size(simple_result_cache_entries,
+									   sizeof(SimpleCacheEntry)));
+}
+
+static void
+cache_shmem_request(void)
+{
+#if (PG_VERSION_NUM >= 150000)
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(cache_memsize());
+	RequestNamedLWLockTranche("simple_fdw result cache", 1);
+}
+
+static void
+cache_shmem_startup(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	cache_shared = NULL;
+	cache_hash = NULL;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	cache_shared = ShmemInitStruct("simple_fdw result cache",
+								   offsetof(SimpleCacheShared, ring) +
+								   (Size) simple_result_cache_size * 1024,
+								   &found);
+	if (!found)
+	{
+		cache_shared->lock = &(GetNamedLWLockTranche("simple_fdw result cache"))->lock;
+		cache_shared->size = (Size) simple_result_cache_size * 1024;
+		cache_shared->head = 0;
+		cache_shared->tail = 0;
+		pg_atomic_init_u64(&cache_shared->hits, 0);
+		pg_atomic_init_u64(&cache_shared->misses, 0);
+		pg_atomic_init_u64(&cache_shared->rejections, 0);
+		cache_shared->stores = 0;
+		cache_shared->evictions = 0;
+		cache_shared->invalidations = 0;
+	}
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(SimpleCacheKey);
+	info.entrysize = sizeof(SimpleCacheEntry);
+	cache_hash = ShmemInitHash("simple_fdw result cache hash",
+							   simple_result_cache_entries,
+							   simple_result_cache_entries,
+							   &info,
+							   HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Types whose conversion from SQLite doesn't depend on any setting.
+ */
+static bool
+cache_type_supported(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		case BOOLOID:
+		case TEXTOID:
+		case VARCHAROID:
+		case BPCHAROID:
+		case BYTEAOID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Add a parameter to the key, as simpleBindParameter binds it: the values
+ * SQLite sees are the same if their keys are.
+ */
+static void
+append_param(StringInfo buf, Oid typid, Datum value, bool isnull)
+{
+	appendBinaryStringInfo(buf, (char *) &typid, sizeof(Oid));
+	appendStringInfoChar(buf, isnull ? 'n' : 'v');
+	if (isnull)
+		return;
+
+	switch (typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case BOOLOID:
+			{
+				int64		val;
+
+				if (typid == INT2OID)
+					val = DatumGetInt16(value);
+				else if (typid == INT4OID)
+					val = DatumGetInt32(value);
+				else if (typid == INT8OID)
+					val = DatumGetInt64(value);
+				else
+					val = DatumGetBool(value) ? 1 : 0;
+				appendBinaryStringInfo(buf, (char *) &val, sizeof(int64));
+			}
+			break;
+		case FLOAT4OID:
+		case FLOAT8OID:
+			{
+				double		val;
+
+				if (typid == FLOAT4OID)
+					val = DatumGetFloat4(value);
+				else
+					val = DatumGetFloat8(value);
+				appendBinaryStringInfo(buf, (char *) &val, sizeof(double));
+			}
+			break;
+		case BYTEAOID:
+		case TEXTOID:
+		case VARCHAROID:
+			{
+				struct varlena *v = PG_DETOAST_DATUM_PACKED(value);
+				int			len = VARSIZE_ANY_EXHDR(v);
+
+				appendBinaryStringInfo(buf, (char *) &len, sizeof(int));
+				appendBinaryStringInfo(buf, VARDATA_ANY(v), len);
+			}
+			break;
+		default:
+			{
+				Oid			typoutput;
+				bool		typIsVarlena;
+				char	   *extval;
+				int			len;
+				int			nestlevel;
+
+				/* the same text in every session sharing the cache */
+				nestlevel = simpleSetTransmissionModes();
+				getTypeOutputInfo(typid, &typoutput, &typIsVarlena);
+				extval = OidOutputFunctionCall(typoutput, value);
+				simpleResetTransmissionModes(nestlevel);
+				len = strlen(extval);
+				appendBinaryStringInfo(buf, (char *) &len, sizeof(int));
+				appendBinaryStringInfo(buf, extval, len);
+				pfree(extval);
+			}
+			break;
+	}
+}
+
+/*
+ * Digest of a key: two 64-bit hashes with different seeds.
+ */
+static void
+make_digest(const char *key, Size len, SimpleCacheKey *digest)
+{
+	digest->hash1 = hash_bytes_extended((const unsigned char *) key, len, 0);
+	digest->hash2 = hash_bytes_extended((const unsigned char *) key, len, 1);
+}
+
+/*
+ * Copy bytes from and to the ring, starting at position "pos", wrapping
+ * around its end.
+ */
+static void
+ring_read(uint64 pos, void *dest, Size len)
+{
+	Size		start = pos % cache_shared->size;
+	Size		first = Min(len, cache_shared->size - start);
+
+	memcpy(dest, cache_shared->ring + start, first);
+	memcpy((char *) dest + first, cache_shared->ring, len - first);
+}
+
+static void
+ring_write(uint64 pos, const void *src, Size len)
+{
+	Size		start = pos % cache_shared->size;
+	Size		first = Min(len, cache_shared->size - start);
+
+	memcpy(cache_shared->ring + start, src, first);
+	memcpy(cache_shared->ring, (const char *) src + first, len - first);
+}
+
+/*
+ * Evict the oldest result of the ring, unless it was already removed by a
+ * reset.  Called with the lock held exclusively.
+ */
+static void
+evict_oldest(void)
+{
+	SimpleCacheItem item;
+	SimpleCacheEntry *entry;
+
+	Assert(cache_shared->tail < cache_shared->head);
+
+	ring_read(cache_shared->tail, &item, sizeof(SimpleCacheItem));
+	entry = (SimpleCacheEntry *) hash_search(cache_hash, &item.key,
+											 HASH_FIND, NULL);
+	if (entry != NULL && entry->offset == cache_shared->tail)
+	{
+		hash_search(cache_hash, &item.key, HASH_REMOVE, NULL);
+		cache_shared->evictions++;
+	}
+	cache_shared->tail += item.size;
+}
+#endif
+
+/*
+ * Return the counters of the result cache, and what it holds.
+ */
+Datum
+simple_fdw_result_cache(PG_FUNCTION_ARGS)
+{
+#if (PG_VERSION_NUM >= 130000)
+	TupleDesc	tupdesc;
+	Datum		values[8];
+	bool		nulls[8];
+
+	if (cache_hash == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("the simple_fdw result cache is not enabled"),
+			errhint("Set simple_fdw.result_cache_size, and load simple_fdw via shared_preload_libraries.")
+			));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	LWLockAcquire(cache_shared->lock, LW_SHARED);
+	values[0] = Int64GetDatum((int64) pg_atomic_read_u64(&cache_shared->hits));
+	values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&cache_shared->misses));
+	values[2] = Int64GetDatum((int64) cache_shared->stores);
+	values[3] = Int64GetDatum((int64) cache_shared->evictions);
+	values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&cache_shared->rejections));
+	values[5] = Int64GetDatum((int64) cache_shared->invalidations);
+	values[6] = Int32GetDatum((int32) hash_get_num_entries(cache_hash));
+	values[7] = Int64GetDatum((int64) (cache_shared->head - cache_shared->tail));
+	LWLockRelease(cache_shared->lock);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+#else
+	ereport(ERROR,
+		(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		errmsg("the simple_fdw result cache requires PostgreSQL 13 or later")
+		));
+	PG_RETURN_VOID();
+#endif
+}
+
+/*
+ * Remove the cached results of a database file, or all of them if NULL.
+ */
+Datum
+simple_fdw_result_cache_reset(PG_FUNCTION_ARGS)
+{
+#if (PG_VERSION_NUM >= 130000)
+	HASH_SEQ_STATUS hash_seq;
+	SimpleCacheEntry *entry;
+	uint64		dbhash = 0;
+	bool		all = PG_ARGISNULL(0);
+
+	if (cache_hash == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("the simple_fdw result cache is not enabled"),
+			errhint("Set simple_fdw.result_cache_size, and load simple_fdw via shared_preload_libraries.")
+			));
+
+	if (!all)
+	{
+		char	   *database = text_to_cstring(PG_GETARG_TEXT_PP(0));
+
+		dbhash = hash_bytes_extended((const unsigned char *) database,
+									 strlen(database), 0);
+	}
+
+	LWLockAcquire(cache_shared->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, cache_hash);
+	while ((entry = (SimpleCacheEntry *) hash_seq_search(&hash_seq)) != NULL)
+	{
+		if (all || entry->dbhash == dbhash)
+		{
+			hash_search(cache_hash, &entry->key, HASH_REMOVE, NULL);
+			cache_shared->invalidations++;
+		}
+	}
+
+	/* The space of the results removed is reclaimed as the ring goes on */
+	if (all)
+		cache_shared->tail = cache_shared->head;
+
+	LWLockRelease(cache_shared->lock);
+#endif
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,1127 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Connection management: SQLite handles stay open for the whole life of
+ * the backend, and are shared by all the scans on the same server.
+ *
+ * On a database in WAL mode, the scans of a transaction all read the same
+ * snapshot of the database: a SQLite read transaction is opened when the
+ * connection is first used in the transaction, and ends with it.  Writers
+ * of other processes are not blocked meanwhile, and a database locked by
+ * one of them is waited for, up to the busy_timeout of the server.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/connection.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#if (PG_VERSION_NUM >= 110000)
+#include "access/parallel.h"
+#endif
+#include "access/xact.h"
+#include "commands/defrem.h"
+#include "funcapi.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "storage/ipc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/syscache.h"
+
+#include "simple_fdw.h"
+
+/*
+ * Connection cache hash table entry
+ *
+ * The key is the OID of the foreign server: SQLite has no notion of users,
+ * so every user mapping of a server would get the very same handle anyway.
+ */
+typedef Oid ConnCacheKey;
+
+typedef struct ConnCacheEntry
+{
+	ConnCacheKey key;			/* hash key (must be first) */
+	sqlite3    *conn;			/* connection to SQLite, or NULL */
+	bool		xact_used;		/* used in the current transaction? */
+	int			xact_depth;		/* 0 = no SQLite transaction open, 1 = BEGIN
+								 * done, 2 = a savepoint open too, etc. */
+	bool		bulk_load;		/* durability relaxed for a bulk load? */
+	int			saved_synchronous;	/* synchronous setting before it */
+	char		saved_journal_mode[16];	/* journal mode before it, or "" */
+	bool		wal;			/* is the database in WAL mode? */
+	bool		invalidated;	/* true if reconnect is pending */
+	uint32		server_hashvalue;	/* hash value of foreign server OID */
+	dlist_head	stmts;			/* cached statements, most recently used first */
+	int			nstmts;			/* length of the stmts list */
+} ConnCacheEntry;
+
+/*
+ * A prepared statement kept in the cache of a connection
+ */
+typedef struct StmtCacheEntry
+{
+	dlist_node	node;			/* link in the connection's list */
+	char	   *sql;			/* SQL of the statement */
+	sqlite3_stmt *stmt;			/* the prepared statement */
+	bool		in_use;			/* currently used by a scan? */
+	ResourceOwner owner;		/* resource owner of the scan using it */
+} StmtCacheEntry;
+
+/* Default busy_timeout of the servers, in milliseconds */
+#define DEFAULT_BUSY_TIMEOUT	5000
+
+/*
+ * Connection cache (initialized on first use)
+ */
+static HTAB *ConnectionHash = NULL;
+
+/*
+ * Connection and statement cache counters of the backend, for
+ * simple_fdw_statement_cache() and the statistics of the scans.
+ */
+SimpleStatsCounters simple_connection_stats;
+static int64 stmt_cache_evictions = 0;
+
+/* GUC variable */
+int			simple_statement_cache_size = 32;
+
+PG_FUNCTION_INFO_V1(simple_fdw_statement_cache);
+
+static sqlite3 *connect_sqlite_server(ForeignServer *server);
+static char *make_immutable_uri(const char *database);
+static void disconnect_sqlite_server(ConnCacheEntry *entry);
+static ConnCacheEntry *get_cache_entry(Oid serverid);
+static void release_all_statements(ConnCacheEntry *entry);
+static void release_statement(StmtCacheEntry *cached);
+static void finalize_leaked_statements(ConnCacheEntry *entry);
+static int	busy_handler(void *arg, int count);
+static bool is_fatal_error(int rc);
+static void evict_statements(ConnCacheEntry *entry, int maxstmts);
+static void do_sql_command(ConnCacheEntry *entry, const char *sql, int elevel);
+static char *get_pragma_value(ConnCacheEntry *entry, const char *pragma);
+static void end_bulk_load(ConnCacheEntry *entry);
+static void simple_xact_callback(XactEvent event, void *arg);
+static void simple_subxact_callback(SubXactEvent event,
+						SubTransactionId mySubid,
+						SubTransactionId parentSubid,
+						void *arg);
+static void simple_resource_callback(ResourceReleasePhase phase,
+						 bool isCommit, bool isTopLevel, void *arg);
+static void simple_inval_callback(Datum arg, int cacheid, uint32 hashvalue);
+static void simple_exit_callback(int code, Datum arg);
+
+
+/*
+ * Get a SQLite handle for the given foreign server, opening the database
+ * if no handle is cached yet.
+ */
+sqlite3 *
+simpleGetConnection(Oid serverid)
+{
+	bool		found;
+	ConnCacheEntry *entry;
+	ConnCacheKey key;
+
+	/* First time through, initialize connection cache hashtable */
+	if (ConnectionHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(ConnCacheKey);
+		ctl.entrysize = sizeof(ConnCacheEntry);
+		ctl.hcxt = CacheMemoryContext;
+#if (PG_VERSION_NUM >= 90500)
+		ConnectionHash = hash_create("simple_fdw connections", 8,
+									 &ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+#else
+		ctl.hash = oid_hash;
+		ConnectionHash = hash_create("simple_fdw connections", 8,
+									 &ctl,
+									 HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+#endif
+
+		/*
+		 * Register some callback functions that manage connection cleanup.
+		 * This should be done just once in each backend.
+		 */
+		RegisterXactCallback(simple_xact_callback, NULL);
+		RegisterSubXactCallback(simple_subxact_callback, NULL);
+		RegisterResourceReleaseCallback(simple_resource_callback, NULL);
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+									  simple_inval_callback, (Datum) 0);
+		on_proc_exit(simple_exit_callback, (Datum) 0);
+	}
+
+	key = serverid;
+
+	/*
+	 * Find or create cached entry for requested connection.
+	 */
+	entry = hash_search(ConnectionHash, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		/*
+		 * We need only clear "conn" here; remaining fields will be filled
+		 * later when "conn" is set.
+		 */
+		entry->conn = NULL;
+	}
+
+	/*
+	 * If the connection needs to be remade due to invalidation, disconnect
+	 * as soon as we're out of any transaction using it.  A scan of the
+	 * current transaction may still be using the old handle.
+	 */
+	if (entry->conn != NULL && entry->invalidated && !entry->xact_used)
+	{
+		elog(DEBUG3, "simple_fdw: closing connection for server %u to reconnect",
+			 serverid);
+		disconnect_sqlite_server(entry);
+	}
+
+	/*
+	 * If cache entry doesn't have a connection, we have to establish a new
+	 * connection.
+	 */
+	if (entry->conn == NULL)
+	{
+		ForeignServer *server = GetForeignServer(serverid);
+		instr_time	start;
+		instr_time	duration;
+
+		entry->xact_used = false;
+		entry->xact_depth = 0;
+		entry->bulk_load = false;
+		entry->invalidated = false;
+		dlist_init(&entry->stmts);
+		entry->nstmts = 0;
+		entry->server_hashvalue =
+			GetSysCacheHashValue1(FOREIGNSERVEROID,
+								  ObjectIdGetDatum(server->serverid));
+
+		INSTR_TIME_SET_CURRENT(start);
+		entry->conn = connect_sqlite_server(server);
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+
+		simple_connection_stats.conn_misses++;
+		simple_connection_stats.open_time += INSTR_TIME_GET_MILLISEC(duration);
+
+		entry->wal = (pg_strcasecmp(get_pragma_value(entry, "journal_mode"),
+									"wal") == 0);
+
+		elog(DEBUG3, "simple_fdw: new connection for server \"%s\"",
+			 server->servername);
+	}
+	else
+		simple_connection_stats.conn_hits++;
+
+	/*
+	 * Start the read transaction of a WAL database at its first use in the
+	 * transaction.  SQLite takes the snapshot at the first read, and keeps
+	 * it until the transaction ends, with the local one.  In the other
+	 * journal modes, a read transaction would lock out the writers, so
+	 * each statement reads the database as it is.
+	 */
+	if (!entry->xact_used && entry->wal && entry->xact_depth == 0)
+	{
+		do_sql_command(entry, "BEGIN", ERROR);
+		entry->xact_depth = 1;
+	}
+
+	entry->xact_used = true;
+
+	return entry->conn;
+}
+
+/*
+ * Look up the cache entry of a server that got a connection already.
+ */
+static ConnCacheEntry *
+get_cache_entry(Oid serverid)
+{
+	ConnCacheEntry *entry = NULL;
+
+	if (ConnectionHash != NULL)
+		entry = hash_search(ConnectionHash, &serverid, HASH_FIND, NULL);
+
+	if (entry == NULL || entry->conn == NULL)
+		elog(ERROR, "no connection to server %u", serverid);
+
+	return entry;
+}
+
+/*
+ * Make sure a SQLite transaction is open on the connection of a server,
+ * down to the current subtransaction level.
+ *
+ * The changes made to SQLite tables are done in a single SQLite
+ * transaction, committed or rolled back along with the local transaction,
+ * so that a write statement pays for one journal sync instead of one per
+ * row.  Subtransactions are mapped to savepoints.  On a WAL database, the
+ * read transaction opened by simpleGetConnection becomes the write one:
+ * SQLite reports SQLITE_BUSY_SNAPSHOT if another process wrote to the
+ * database since its snapshot was taken.
+ */
+void
+simpleBeginTransaction(Oid serverid)
+{
+	ConnCacheEntry *entry = get_cache_entry(serverid);
+	int			curlevel = GetCurrentTransactionNestLevel();
+
+	if (entry->xact_depth <= 0)
+	{
+		elog(DEBUG3, "simple_fdw: starting SQLite transaction for server %u",
+			 serverid);
+		do_sql_command(entry, "BEGIN", ERROR);
+		entry->xact_depth = 1;
+	}
+
+	while (entry->xact_depth < curlevel)
+	{
+		char		sql[64];
+
+		snprintf(sql, sizeof(sql), "SAVEPOINT s%d", entry->xact_depth + 1);
+		do_sql_command(entry, sql, ERROR);
+		entry->xact_depth++;
+	}
+}
+
+/*
+ * Returns true if a SQLite transaction is open on the cached connection of
+ * a server, be it the one of changes or the read transaction of a WAL
+ * database.
+ */
+bool
+simpleInTransaction(Oid serverid)
+{
+	ConnCacheEntry *entry = NULL;
+
+	if (ConnectionHash != NULL)
+		entry = hash_search(ConnectionHash, &serverid, HASH_FIND, NULL);
+
+	return entry != NULL && entry->conn != NULL && entry->xact_depth > 0;
+}
+
+/*
+ * Relax the durability of SQLite for a bulk load on the connection of a
+ * server, until the end of the transaction: SQLite stops syncing its
+ * files, and keeps its rollback journal in memory.  A crash during the
+ * load may then corrupt the database.
+ *
+ * The journal mode can't be changed inside a SQLite transaction, so this
+ * must be called before simpleBeginTransaction.  A database in WAL mode
+ * keeps it, WAL being fast enough once it isn't synced.
+ */
+void
+simpleBeginBulkLoad(Oid serverid)
+{
+	ConnCacheEntry *entry = get_cache_entry(serverid);
+	char	   *value;
+
+	if (entry->bulk_load)
+		return;
+
+	value = get_pragma_value(entry, "synchronous");
+	entry->saved_synchronous = atoi(value);
+	entry->saved_journal_mode[0] = '\0';
+	entry->bulk_load = true;
+
+	do_sql_command(entry, "PRAGMA synchronous = OFF", ERROR);
+
+	if (entry->xact_depth == 0)
+	{
+		value = get_pragma_value(entry, "journal_mode");
+		if (pg_strcasecmp(value, "wal") != 0 &&
+			pg_strcasecmp(value, "memory") != 0 &&
+			pg_strcasecmp(value, "off") != 0)
+		{
+			strlcpy(entry->saved_journal_mode, value,
+					sizeof(entry->saved_journal_mode));
+			do_sql_command(entry, "PRAGMA journal_mode = MEMORY", ERROR);
+		}
+	}
+}
+
+/*
+ * Restore the settings changed by simpleBeginBulkLoad, once the SQLite
+ * transaction is over.
+ */
+static void
+end_bulk_load(ConnCacheEntry *entry)
+{
+	char		sql[64];
+
+	if (entry->saved_journal_mode[0] != '\0')
+	{
+		snprintf(sql, sizeof(sql), "PRAGMA journal_mode = %s",
+				 entry->saved_journal_mode);
+		do_sql_command(entry, sql, WARNING);
+	}
+
+	snprintf(sql, sizeof(sql), "PRAGMA synchronous = %d",
+			 entry->saved_synchronous);
+	do_sql_command(entry, sql, WARNING);
+
+	entry->bulk_load = false;
+}
+
+/*
+ * Get the current value of a pragma, as a string.
+ */
+static char *
+get_pragma_value(ConnCacheEntry *entry, const char *pragma)
+{
+	sqlite3_stmt *stmt;
+	char		sql[64];
+	char	   *value = NULL;
+
+	snprintf(sql, sizeof(sql), "PRAGMA %s", pragma);
+	if (sqlite3_prepare_v2(entry->conn, sql, -1, &stmt, NULL) != SQLITE_OK)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_ERROR),
+			errmsg("could not execute \"%s\": %s", sql,
+				   sqlite3_errmsg(entry->conn))
+			));
+
+	if (sqlite3_step(stmt) == SQLITE_ROW &&
+		sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+		value = pstrdup((const char *) sqlite3_column_text(stmt, 0));
+	sqlite3_finalize(stmt);
+
+	return value ? value : pstrdup("");
+}
+
+/*
+ * Run a SQL command with no result on a connection.  Errors are reported
+ * at the given level: cleanup after an abort can't throw another error.
+ */
+static void
+do_sql_command(ConnCacheEntry *entry, const char *sql, int elevel)
+{
+	char	   *err = NULL;
+
+	if (sqlite3_exec(entry->conn, sql, NULL, NULL, &err) != SQLITE_OK)
+	{
+		char	   *msg = pstrdup(err ? err : sqlite3_errmsg(entry->conn));
+
+		sqlite3_free(err);
+		ereport(elevel,
+			(errcode(ERRCODE_FDW_ERROR),
+			errmsg("could not execute \"%s\": %s", sql, msg)
+			));
+	}
+}
+
+/*
+ * Get a prepared statement for the given SQL on the connection of a server.
+ *
+ * Each connection keeps up to simple_fdw.statement_cache_size statements,
+ * in least recently used order, so repeated scans don't have to parse and
+ * plan their query again.  A statement is handed to a single user at a
+ * time, which has to give it back with simpleReleaseStatement.
+ */
+sqlite3_stmt *
+simplePrepareStatement(Oid serverid, const char *sql)
+{
+	ConnCacheEntry *entry = get_cache_entry(serverid);
+	StmtCacheEntry *cached;
+	sqlite3_stmt *stmt;
+	dlist_iter	iter;
+	instr_time	start;
+	instr_time	duration;
+	int			rc;
+
+	dlist_foreach(iter, &entry->stmts)
+	{
+		cached = dlist_container(StmtCacheEntry, node, iter.cur);
+
+		if (!cached->in_use && strcmp(cached->sql, sql) == 0)
+		{
+			/* move it to the front of the list */
+			dlist_move_head(&entry->stmts, &cached->node);
+			cached->in_use = true;
+			cached->owner = CurrentResourceOwner;
+			simple_connection_stats.stmt_hits++;
+			return cached->stmt;
+		}
+	}
+
+	simple_connection_stats.stmt_misses++;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+#if (SQLITE_VERSION_NUMBER >= 3020000)
+	rc = sqlite3_prepare_v3(entry->conn, sql, -1, SQLITE_PREPARE_PERSISTENT,
+							&stmt, NULL);
+#else
+	rc = sqlite3_prepare_v2(entry->conn, sql, -1, &stmt, NULL);
+#endif
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	simple_connection_stats.prepare_time += INSTR_TIME_GET_MILLISEC(duration);
+
+	if (rc != SQLITE_OK)
+	{
+		/* A handle that hit a damaged file is reopened after the transaction */
+		if (is_fatal_error(rc))
+			entry->invalidated = true;
+		ereport(ERROR,
+			(errcode(rc == SQLITE_ERROR ? ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION :
+					 simpleSqliteErrcode(rc)),
+			errmsg("SQL error during prepare: %s", sqlite3_errmsg(entry->conn))
+			));
+	}
+
+	cached = (StmtCacheEntry *) MemoryContextAlloc(CacheMemoryContext,
+												   sizeof(StmtCacheEntry));
+	cached->sql = MemoryContextStrdup(CacheMemoryContext, sql);
+	cached->stmt = stmt;
+	cached->in_use = true;
+	cached->owner = CurrentResourceOwner;
+	dlist_push_head(&entry->stmts, &cached->node);
+	entry->nstmts++;
+
+	evict_statements(entry, simple_statement_cache_size);
+
+	return stmt;
+}
+
+/*
+ * Give back a statement obtained with simplePrepareStatement.  It is reset
+ * so that it is ready for the next user.
+ */
+void
+simpleReleaseStatement(Oid serverid, sqlite3_stmt *stmt)
+{
+	ConnCacheEntry *entry = get_cache_entry(serverid);
+	dlist_iter	iter;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+
+	dlist_foreach(iter, &entry->stmts)
+	{
+		StmtCacheEntry *cached = dlist_container(StmtCacheEntry, node, iter.cur);
+
+		if (cached->stmt == stmt)
+		{
+			cached->in_use = false;
+			break;
+		}
+	}
+
+	evict_statements(entry, simple_statement_cache_size);
+}
+
+/*
+ * Finalize the least recently used statements that are not in use, until
+ * at most maxstmts remain.
+ */
+static void
+evict_statements(ConnCacheEntry *entry, int maxstmts)
+{
+	dlist_node *cur;
+
+	if (dlist_is_empty(&entry->stmts))
+		return;
+
+	cur = dlist_tail_node(&entry->stmts);
+	while (cur != NULL && entry->nstmts > maxstmts)
+	{
+		StmtCacheEntry *cached = dlist_container(StmtCacheEntry, node, cur);
+		dlist_node *prev = dlist_has_prev(&entry->stmts, cur) ?
+			dlist_prev_node(&entry->stmts, cur) : NULL;
+
+		if (!cached->in_use)
+		{
+			dlist_delete(&cached->node);
+			entry->nstmts--;
+			sqlite3_finalize(cached->stmt);
+			pfree(cached->sql);
+			pfree(cached);
+			stmt_cache_evictions++;
+		}
+
+		cur = prev;
+	}
+}
+
+/*
+ * Mark all the statements of a connection as free again.  Used at the end
+ * of a transaction, since scans interrupted by an error never give back
+ * their statements.
+ */
+static void
+release_all_statements(ConnCacheEntry *entry)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &entry->stmts)
+	{
+		StmtCacheEntry *cached = dlist_container(StmtCacheEntry, node, iter.cur);
+
+		if (cached->in_use)
+			release_statement(cached);
+	}
+}
+
+static void
+release_statement(StmtCacheEntry *cached)
+{
+	sqlite3_reset(cached->stmt);
+	sqlite3_clear_bindings(cached->stmt);
+	cached->in_use = false;
+	cached->owner = NULL;
+}
+
+/*
+ * Finalize the statements of a connection that are not in its cache: those
+ * prepared for a single use, whose finalization was skipped by an error.
+ * Called at the end of the transaction, once no scan is left.
+ */
+static void
+finalize_leaked_statements(ConnCacheEntry *entry)
+{
+	sqlite3_stmt *stmt = sqlite3_next_stmt(entry->conn, NULL);
+
+	while (stmt != NULL)
+	{
+		sqlite3_stmt *next = sqlite3_next_stmt(entry->conn, stmt);
+		bool		cached = false;
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &entry->stmts)
+		{
+			if (dlist_container(StmtCacheEntry, node, iter.cur)->stmt == stmt)
+			{
+				cached = true;
+				break;
+			}
+		}
+
+		if (!cached)
+			sqlite3_finalize(stmt);
+		stmt = next;
+	}
+}
+
+/*
+ * Open the SQLite database of a foreign server.
+ */
+static sqlite3 *
+connect_sqlite_server(ForeignServer *server)
+{
+	sqlite3    *db;
+	char	   *database = NULL;
+	char	   *filename;
+	int			flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+	bool		readonly = false;
+	bool		immutable = false;
+	int			busy_timeout = DEFAULT_BUSY_TIMEOUT;
+	StringInfoData pragmas;
+	ListCell   *lc;
+
+	/* The cache options become pragmas, run once the database is open */
+	initStringInfo(&pragmas);
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "database") == 0)
+			database = defGetString(def);
+		else if (strcmp(def->defname, "readonly") == 0)
+			readonly = defGetBoolean(def);
+		else if (strcmp(def->defname, "immutable") == 0)
+			immutable = defGetBoolean(def);
+		else if (strcmp(def->defname, "busy_timeout") == 0)
+			busy_timeout = atoi(defGetString(def));
+		else if (strcmp(def->defname, "mmap_size") == 0 ||
+				 strcmp(def->defname, "cache_size") == 0 ||
+				 strcmp(def->defname, "temp_store") == 0)
+			appendStringInfo(&pragmas, "PRAGMA %s = %s;",
+							 def->defname, defGetString(def));
+	}
+
+	if (database == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			errmsg("a database must be specified for server \"%s\"",
+				   server->servername)
+			));
+
+#if (PG_VERSION_NUM >= 110000)
+	/* Parallel workers only ever read */
+	if (IsParallelWorker())
+		readonly = true;
+#endif
+
+	/*
+	 * An immutable database is opened through a URI telling SQLite that
+	 * the file can't change: no locking, no change detection.
+	 */
+	filename = database;
+	if (immutable)
+	{
+		filename = make_immutable_uri(database);
+		flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_URI;
+	}
+	else if (readonly)
+		flags = SQLITE_OPEN_READONLY;
+
+	if (sqlite3_open_v2(filename, &db, flags, NULL) != SQLITE_OK)
+	{
+		char	   *err = pstrdup(sqlite3_errmsg(db));
+
+		sqlite3_close(db);
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+			errmsg("Can't open sqlite database %s: %s", database, err)
+			));
+	}
+
+	/*
+	 * Tell a stale WAL snapshot from the other busy errors, and wait for the
+	 * locks of the other processes instead of failing right away.
+	 */
+	sqlite3_extended_result_codes(db, 1);
+	if (busy_timeout > 0)
+		sqlite3_busy_handler(db, busy_handler, (void *) (intptr_t) busy_timeout);
+
+	if (pragmas.len > 0 &&
+		sqlite3_exec(db, pragmas.data, NULL, NULL, NULL) != SQLITE_OK)
+	{
+		char	   *err = pstrdup(sqlite3_errmsg(db));
+
+		sqlite3_close(db);
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_ESTABLISH_CONNECTION),
+			errmsg("could not configure sqlite database %s: %s", database, err)
+			));
+	}
+	pfree(pragmas.data);
+
+	return db;
+}
+
+/*
+ * Busy handler of the connections: sleep a little longer each time, like
+ * sqlite3_busy_timeout, until the timeout of the server, in milliseconds,
+ * has passed.  Giving up as soon as an interrupt is pending lets a query
+ * waiting for a lock be canceled: the error of SQLite is raised, then the
+ * interrupt is processed.  This may run in the thread of an asynchronous
+ * scan, so nothing here may call into PostgreSQL.
+ */
+static int
+busy_handler(void *arg, int count)
+{
+	static const int delays[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};
+	static const int totals[] = {0, 1, 3, 8, 18, 33, 53, 78, 103, 128, 178, 228};
+	int			timeout = (int) (intptr_t) arg;
+	int			delay;
+	int			prior;
+
+	if (InterruptPending)
+		return 0;
+
+	if (count < (int) lengthof(delays))
+	{
+		delay = delays[count];
+		prior = totals[count];
+	}
+	else
+	{
+		delay = delays[lengthof(delays) - 1];
+		prior = totals[lengthof(totals) - 1] +
+			delay * (count - (int) lengthof(delays));
+	}
+
+	if (prior + delay > timeout)
+	{
+		delay = timeout - prior;
+		if (delay <= 0)
+			return 0;
+	}
+
+	pg_usleep(delay * 1000L);
+	return 1;
+}
+
+/*
+ * SQLSTATE of a SQLite error code.  A database still locked after the
+ * busy timeout gives a lock error, and a WAL snapshot that can't become a
+ * write transaction a serialization failure: both can be retried by the
+ * client.
+ */
+int
+simpleSqliteErrcode(int rc)
+{
+	if (rc == SQLITE_BUSY_SNAPSHOT)
+		return ERRCODE_T_R_SERIALIZATION_FAILURE;
+
+	switch (rc & 0xFF)
+	{
+		case SQLITE_BUSY:
+		case SQLITE_LOCKED:
+			return ERRCODE_LOCK_NOT_AVAILABLE;
+		case SQLITE_CONSTRAINT:
+			return ERRCODE_INTEGRITY_CONSTRAINT_VIOLATION;
+		default:
+			return ERRCODE_FDW_ERROR;
+	}
+}
+
+/*
+ * Errors after which a handle is not worth keeping: the file is damaged,
+ * or was replaced by something else.
+ */
+static bool
+is_fatal_error(int rc)
+{
+	switch (rc & 0xFF)
+	{
+		case SQLITE_CORRUPT:
+		case SQLITE_NOTADB:
+		case SQLITE_IOERR:
+		case SQLITE_CANTOPEN:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Build a "file:" URI opening the given database file as immutable.  The
+ * characters with a meaning in URIs are percent-encoded.
+ */
+static char *
+make_immutable_uri(const char *database)
+{
+	StringInfoData buf;
+	const char *p;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, "file:");
+	for (p = database; *p; p++)
+	{
+		if (*p == '%' || *p == '?' || *p == '#')
+			appendStringInfo(&buf, "%%%02X", (unsigned char) *p);
+		else
+			appendStringInfoChar(&buf, *p);
+	}
+	appendStringInfoString(&buf, "?mode=ro&immutable=1");
+
+	return buf.data;
+}
+
+/*
+ * Close the SQLite handle of a cache entry.  sqlite3_close_v2 defers the
+ * actual close until any remaining statement is finalized.
+ */
+static void
+disconnect_sqlite_server(ConnCacheEntry *entry)
+{
+	if (entry->conn != NULL)
+	{
+		release_all_statements(entry);
+		evict_statements(entry, 0);
+
+		sqlite3_close_v2(entry->conn);
+		entry->conn = NULL;
+	}
+}
+
+/*
+ * At the end of each transaction, the handles are free to be reopened if
+ * their server changed in the meantime.
+ */
+static void
+simple_xact_callback(XactEvent event, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	switch (event)
+	{
+#if (PG_VERSION_NUM >= 90300)
+		case XACT_EVENT_PRE_COMMIT:
+#if (PG_VERSION_NUM >= 90500)
+		case XACT_EVENT_PARALLEL_PRE_COMMIT:
+#endif
+			/*
+			 * Commit the SQLite transactions before the local one: if that
+			 * fails, the local transaction is aborted too.
+			 */
+			if (ConnectionHash == NULL)
+				return;
+			hash_seq_init(&scan, ConnectionHash);
+			while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+			{
+				if (entry->conn != NULL && entry->xact_depth > 0)
+				{
+					release_all_statements(entry);
+					do_sql_command(entry, "COMMIT", ERROR);
+					entry->xact_depth = 0;
+				}
+			}
+			return;
+		case XACT_EVENT_PRE_PREPARE:
+			if (ConnectionHash == NULL)
+				return;
+			hash_seq_init(&scan, ConnectionHash);
+			while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+			{
+				if (entry->conn != NULL && entry->xact_depth > 0)
+				{
+					hash_seq_term(&scan);
+					ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot PREPARE a transaction that has modified SQLite tables")
+						));
+				}
+			}
+			return;
+#endif
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+#if (PG_VERSION_NUM >= 90500)
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PARALLEL_ABORT:
+#endif
+			break;
+		default:
+			return;
+	}
+
+#if (PG_VERSION_NUM >= 140000)
+	/*
+	 * After an error, the background fetchers of the asynchronous scans may
+	 * still be using their statements: stop them first.
+	 */
+	simpleAsyncDestroyAll();
+#endif
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		if (entry->conn == NULL)
+			continue;
+
+		/* The last error of a handle tells whether it can still be used */
+		if (event != XACT_EVENT_COMMIT &&
+			is_fatal_error(sqlite3_extended_errcode(entry->conn)))
+			entry->invalidated = true;
+
+		entry->xact_used = false;
+		release_all_statements(entry);
+		finalize_leaked_statements(entry);
+
+		/* After an error, throw away the changes made to SQLite */
+		if (entry->xact_depth > 0)
+		{
+			do_sql_command(entry, "ROLLBACK", WARNING);
+			entry->xact_depth = 0;
+		}
+
+		if (entry->bulk_load)
+			end_bulk_load(entry);
+
+		if (entry->invalidated)
+			disconnect_sqlite_server(entry);
+	}
+}
+
+/*
+ * At the end of a subtransaction, release or roll back the savepoints
+ * opened by simpleBeginTransaction at its level.
+ */
+static void
+simple_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						SubTransactionId parentSubid, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+	int			curlevel;
+
+	/* Savepoints are released before commit, where it's fine to fail */
+#if (PG_VERSION_NUM >= 90300)
+	if (!(event == SUBXACT_EVENT_PRE_COMMIT_SUB ||
+		  event == SUBXACT_EVENT_ABORT_SUB))
+		return;
+#else
+	if (!(event == SUBXACT_EVENT_COMMIT_SUB ||
+		  event == SUBXACT_EVENT_ABORT_SUB))
+		return;
+#endif
+
+	if (ConnectionHash == NULL)
+		return;
+
+	curlevel = GetCurrentTransactionNestLevel();
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		char		sql[100];
+
+		if (entry->conn == NULL || entry->xact_depth < curlevel)
+			continue;
+
+		if (event != SUBXACT_EVENT_ABORT_SUB)
+		{
+			snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
+			do_sql_command(entry, sql, ERROR);
+		}
+		else
+		{
+			snprintf(sql, sizeof(sql),
+					 "ROLLBACK TO SAVEPOINT s%d; RELEASE SAVEPOINT s%d",
+					 curlevel, curlevel);
+			do_sql_command(entry, sql, WARNING);
+		}
+		entry->xact_depth--;
+	}
+}
+
+/*
+ * When the resources of an aborted subtransaction are released, free the
+ * statements its scans were using: they won't give them back, and the
+ * statements in use can't be used by the following scans, nor evicted.
+ * This is called for each resource owner released, the current one.  At
+ * the top level, the transaction callback has released them all already.
+ */
+static void
+simple_resource_callback(ResourceReleasePhase phase, bool isCommit,
+						 bool isTopLevel, void *arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	if (phase != RESOURCE_RELEASE_BEFORE_LOCKS || isCommit || isTopLevel ||
+		ConnectionHash == NULL)
+		return;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		dlist_iter	iter;
+
+		if (entry->conn == NULL)
+			continue;
+
+		dlist_foreach(iter, &entry->stmts)
+		{
+			StmtCacheEntry *cached = dlist_container(StmtCacheEntry, node, iter.cur);
+
+			if (!cached->in_use || cached->owner != CurrentResourceOwner)
+				continue;
+
+#if (PG_VERSION_NUM >= 140000)
+			/* An asynchronous scan may still be fetching from it */
+			simpleAsyncWaitStatement(cached->stmt);
+#endif
+			release_statement(cached);
+		}
+	}
+}
+
+/*
+ * Connection invalidation callback function
+ *
+ * After a change to a pg_foreign_server catalog entry, mark the
+ * connections depending on that entry as needing to be remade.  We can't
+ * immediately close them, since they may be in use in the current
+ * transaction.
+ *
+ * Although most cache invalidation callbacks blow away all the related
+ * stuff regardless of the given hashvalue, connections are expensive
+ * enough that it's worth trying to avoid that.
+ */
+static void
+simple_inval_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	Assert(cacheid == FOREIGNSERVEROID);
+
+	/* ConnectionHash must exist already, if we're registered */
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+	{
+		/* Ignore invalid entries */
+		if (entry->conn == NULL)
+			continue;
+
+		/* hashvalue == 0 means a cache reset, must clear all state */
+		if (hashvalue == 0 || entry->server_hashvalue == hashvalue)
+			entry->invalidated = true;
+	}
+}
+
+/*
+ * Close all the connections when the backend exits, so that SQLite can
+ * checkpoint and clean up its journal files.
+ */
+static void
+simple_exit_callback(int code, Datum arg)
+{
+	HASH_SEQ_STATUS scan;
+	ConnCacheEntry *entry;
+
+	hash_seq_init(&scan, ConnectionHash);
+	while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+		disconnect_sqlite_server(entry);
+}
+
+/*
+ * Report the statement cache counters of this backend.
+ */
+Datum
+simple_fdw_statement_cache(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[4];
+	bool		nulls[4];
+	int			cached = 0;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	if (ConnectionHash != NULL)
+	{
+		HASH_SEQ_STATUS scan;
+		ConnCacheEntry *entry;
+
+		hash_seq_init(&scan, ConnectionHash);
+		while ((entry = (ConnCacheEntry *) hash_seq_search(&scan)))
+		{
+			if (entry->conn != NULL)
+				cached += entry->nstmts;
+		}
+	}
+
+	MemSet(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(simple_connection_stats.stmt_hits);
+	values[1] = Int64GetDatum(simple_connection_stats.stmt_misses);
+	values[2] = Int64GetDatum(stmt_cache_evictions);
+	values[3] = Int32GetDatum(cached);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
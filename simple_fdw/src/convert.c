@@ -0,0 +1,296 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Conversion between SQLite values and PostgreSQL Datums.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/convert.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "utils/float.h"
+#endif
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/timestamp.h"
+
+#include "simple_fdw.h"
+
+#include <math.h>
+
+/* Set a GUC until the end of the nest level of simpleSetTransmissionModes */
+#if (PG_VERSION_NUM >= 90500)
+#define set_transmission_option(name, value) \
+	(void) set_config_option((name), (value), PGC_USERSET, PGC_S_SESSION, \
+							 GUC_ACTION_SAVE, true, 0, false)
+#else
+#define set_transmission_option(name, value) \
+	(void) set_config_option((name), (value), PGC_USERSET, PGC_S_SESSION, \
+							 GUC_ACTION_SAVE, true, 0)
+#endif
+
+
+/*
+ * Convert a SQLite value into a Datum of type "typid".
+ *
+ * Integer, floating point and blob values are turned into the matching
+ * PostgreSQL types from their binary SQLite representation.  Everything
+ * else goes through the type's input function, with the value in text form,
+ * which also takes care of typmods, domains and out of range values.
+ */
+Datum
+simpleConvertValue(sqlite3_value *value,
+				   Oid typid, int32 typmod,
+				   FmgrInfo *infunc, Oid ioparam,
+				   bool *isnull)
+{
+	int			coltype = sqlite3_value_type(value);
+
+	if (coltype == SQLITE_NULL)
+	{
+		*isnull = true;
+		return (Datum) 0;
+	}
+
+	*isnull = false;
+
+	switch (typid)
+	{
+		case INT2OID:
+			if (coltype == SQLITE_INTEGER)
+			{
+				sqlite3_int64 val = sqlite3_value_int64(value);
+
+				if (val >= PG_INT16_MIN && val <= PG_INT16_MAX)
+					return Int16GetDatum((int16) val);
+			}
+			break;
+		case INT4OID:
+			if (coltype == SQLITE_INTEGER)
+			{
+				sqlite3_int64 val = sqlite3_value_int64(value);
+
+				if (val >= PG_INT32_MIN && val <= PG_INT32_MAX)
+					return Int32GetDatum((int32) val);
+			}
+			break;
+		case INT8OID:
+			if (coltype == SQLITE_INTEGER)
+				return Int64GetDatum((int64) sqlite3_value_int64(value));
+			break;
+		case FLOAT4OID:
+			if (coltype == SQLITE_INTEGER || coltype == SQLITE_FLOAT)
+			{
+				double		val = sqlite3_value_double(value);
+				float4		result = (float4) val;
+
+				/* float4in reports the values too large or too small */
+				if (!(isinf(result) && !isinf(val)) &&
+					!(result == 0.0f && val != 0.0))
+					return Float4GetDatum(result);
+			}
+			break;
+		case FLOAT8OID:
+			if (coltype == SQLITE_INTEGER || coltype == SQLITE_FLOAT)
+				return Float8GetDatum(sqlite3_value_double(value));
+			break;
+		case BOOLOID:
+			if (coltype == SQLITE_INTEGER)
+			{
+				sqlite3_int64 val = sqlite3_value_int64(value);
+
+				if (val == 0 || val == 1)
+					return BoolGetDatum(val != 0);
+			}
+			break;
+		case BYTEAOID:
+			if (coltype == SQLITE_BLOB)
+			{
+				const void *blob = sqlite3_value_blob(value);
+				int			len = sqlite3_value_bytes(value);
+				bytea	   *result = (bytea *) palloc(len + VARHDRSZ);
+
+				SET_VARSIZE(result, len + VARHDRSZ);
+				if (len > 0)
+					memcpy(VARDATA(result), blob, len);
+				return PointerGetDatum(result);
+			}
+			break;
+		case TEXTOID:
+			{
+				const char *str = (const char *) sqlite3_value_text(value);
+				int			len = sqlite3_value_bytes(value);
+
+				/* text can't hold NUL bytes, stop at the first one */
+				if (memchr(str, '\0', len) != NULL)
+					len = strlen(str);
+				return PointerGetDatum(cstring_to_text_with_len(str, len));
+			}
+		default:
+			break;
+	}
+
+	/* Fall back to the text representation of the value */
+	return InputFunctionCall(infunc,
+							 (char *) sqlite3_value_text(value),
+							 ioparam,
+							 typmod);
+}
+
+/*
+ * Convert the value of column "col" of the current row of "stmt" into a
+ * Datum of type "typid".
+ */
+Datum
+simpleConvertColumn(sqlite3_stmt *stmt, int col,
+					Oid typid, int32 typmod,
+					FmgrInfo *infunc, Oid ioparam,
+					bool *isnull)
+{
+	return simpleConvertValue(sqlite3_column_value(stmt, col),
+							  typid, typmod, infunc, ioparam, isnull);
+}
+
+/*
+ * Bind a Datum of type "typid" to the parameter "idx" of a statement.
+ *
+ * Numbers, booleans and bytea are bound with their SQLite storage class;
+ * other values are bound as their text representation, which SQLite
+ * converts according to the affinity of the column they're compared to.
+ * That text mustn't depend on the settings of the session, so that the
+ * values written can be read back, and found by their key, by any session:
+ * it is the one of the ISO date style, and timestamptz values are written
+ * in UTC, in the form SQLite's date functions understand.
+ */
+void
+simpleBindParameter(sqlite3_stmt *stmt, int idx,
+					Oid typid, Datum value, bool isnull)
+{
+	int			rc;
+
+	if (isnull)
+		rc = sqlite3_bind_null(stmt, idx);
+	else
+	{
+		switch (typid)
+		{
+			case INT2OID:
+				rc = sqlite3_bind_int64(stmt, idx, DatumGetInt16(value));
+				break;
+			case INT4OID:
+				rc = sqlite3_bind_int64(stmt, idx, DatumGetInt32(value));
+				break;
+			case INT8OID:
+				rc = sqlite3_bind_int64(stmt, idx, DatumGetInt64(value));
+				break;
+			case FLOAT4OID:
+				rc = sqlite3_bind_double(stmt, idx, DatumGetFloat4(value));
+				break;
+			case FLOAT8OID:
+				rc = sqlite3_bind_double(stmt, idx, DatumGetFloat8(value));
+				break;
+			case BOOLOID:
+				rc = sqlite3_bind_int(stmt, idx, DatumGetBool(value) ? 1 : 0);
+				break;
+			case BYTEAOID:
+				{
+					bytea	   *b = DatumGetByteaPP(value);
+
+					rc = sqlite3_bind_blob(stmt, idx, VARDATA_ANY(b),
+										   VARSIZE_ANY_EXHDR(b),
+										   SQLITE_TRANSIENT);
+				}
+				break;
+			case TEXTOID:
+			case VARCHAROID:
+				{
+					text	   *t = DatumGetTextPP(value);
+
+					rc = sqlite3_bind_text(stmt, idx, VARDATA_ANY(t),
+										   VARSIZE_ANY_EXHDR(t),
+										   SQLITE_TRANSIENT);
+				}
+				break;
+			default:
+				{
+					Oid			typoutput;
+					bool		typIsVarlena;
+					char	   *extval;
+
+					int			nestlevel = simpleSetTransmissionModes();
+
+					if (typid == TIMESTAMPTZOID &&
+						!TIMESTAMP_NOT_FINITE(DatumGetTimestampTz(value)))
+					{
+						/* the UTC time, as a timestamp without time zone */
+						char	   *utc = DatumGetCString(DirectFunctionCall1(timestamp_out,
+																			  value));
+
+						extval = psprintf("%s+00:00", utc);
+						pfree(utc);
+					}
+					else
+					{
+						getTypeOutputInfo(typid, &typoutput, &typIsVarlena);
+						extval = OidOutputFunctionCall(typoutput, value);
+					}
+					simpleResetTransmissionModes(nestlevel);
+					rc = sqlite3_bind_text(stmt, idx, extval, -1,
+										   SQLITE_TRANSIENT);
+					pfree(extval);
+				}
+				break;
+		}
+	}
+
+	if (rc != SQLITE_OK)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("could not bind parameter %d: %s",
+				   idx, sqlite3_errmsg(sqlite3_db_handle(stmt)))
+			));
+}
+
+/*
+ * Force the settings the output functions depend on to values giving the
+ * same text in every session, as postgres_fdw does, until
+ * simpleResetTransmissionModes is called with the returned nest level.
+ */
+int
+simpleSetTransmissionModes(void)
+{
+	int			nestlevel = NewGUCNestLevel();
+
+	if (DateStyle != USE_ISO_DATES)
+		set_transmission_option("datestyle", "ISO");
+	if (IntervalStyle != INTSTYLE_POSTGRES)
+		set_transmission_option("intervalstyle", "postgres");
+	if (extra_float_digits < 3)
+		set_transmission_option("extra_float_digits", "3");
+
+	return nestlevel;
+}
+
+/*
+ * Undo the changes of simpleSetTransmissionModes.
+ */
+void
+simpleResetTransmissionModes(int nestlevel)
+{
+	AtEOXact_GUC(true, nestlevel);
+}
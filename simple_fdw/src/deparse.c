@@ -0,0 +1,1929 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Query deparser: builds the SQL statements sent to SQLite.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/deparse.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#if (PG_VERSION_NUM >= 90300)
+#include "access/htup_details.h"
+#endif
+#if (PG_VERSION_NUM >= 90600)
+#include "access/stratnum.h"
+#else
+#include "access/skey.h"
+#endif
+#include "access/sysattr.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "access/table.h"
+#else
+#include "access/heapam.h"
+#endif
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_attribute.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_namespace.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/restrictinfo.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "optimizer/tlist.h"
+#endif
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+
+#include "simple_fdw.h"
+
+/*
+ * Prefix of the aliases of the tables in a join: the range table index of
+ * each table is added to it.
+ */
+#define REL_ALIAS_PREFIX	"r"
+
+/*
+ * Global context for foreign_expr_walker's search of an expression tree.
+ */
+typedef struct foreign_glob_cxt
+{
+	PlannerInfo *root;			/* global planner state */
+	RelOptInfo *foreignrel;		/* the foreign relation we are planning for */
+} foreign_glob_cxt;
+
+/*
+ * Context for deparseExpr
+ */
+typedef struct deparse_expr_cxt
+{
+	PlannerInfo *root;			/* global planner state */
+	RelOptInfo *foreignrel;		/* the foreign relation we are planning for */
+	StringInfo	buf;			/* output buffer to append to */
+	List	  **params_list;	/* exprs that will become remote Params */
+} deparse_expr_cxt;
+
+/*
+ * Functions to determine whether an expression can be evaluated safely on
+ * the SQLite side.
+ */
+static bool foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt);
+static bool is_shippable_type(Oid typid);
+static bool is_shippable_const(Const *node);
+static bool is_shippable_value(Oid type, Datum value);
+static const char *get_shippable_operator(Oid opno);
+static bool is_text_type(Oid typid);
+static bool is_shippable_like_pattern(const char *pattern);
+static bool is_deterministic_collation(Oid collid);
+static void deparseBinaryCollation(Expr *node, deparse_expr_cxt *context);
+static Var *get_indexable_var(RelOptInfo *baserel, Node *node);
+static bool is_notnull_column(RelOptInfo *baserel, Oid relid, AttrNumber attnum);
+static bool is_rowid_name(const char *colname);
+#if (PG_VERSION_NUM >= 120000)
+static bool is_shippable_aggregate(Aggref *agg);
+#endif
+
+/*
+ * Functions to construct string representation of a node tree.
+ */
+static void deparseExpr(Expr *node, deparse_expr_cxt *context);
+static void deparseVar(Var *node, deparse_expr_cxt *context);
+static void deparseConst(Const *node, deparse_expr_cxt *context);
+static void deparseParam(Expr *node, deparse_expr_cxt *context);
+static void deparseOpExpr(OpExpr *node, deparse_expr_cxt *context);
+static void deparseScalarArrayOpExpr(ScalarArrayOpExpr *node,
+						 deparse_expr_cxt *context);
+static void deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context);
+static void deparseNullTest(NullTest *node, deparse_expr_cxt *context);
+#if (PG_VERSION_NUM >= 120000)
+static void deparseAggref(Aggref *node, deparse_expr_cxt *context);
+static void deparseFromExpr(StringInfo buf, PlannerInfo *root,
+				RelOptInfo *foreignrel, List **params_list);
+#endif
+static void deparseInsertValues(StringInfo buf, int num_params);
+static void deparseRowIdentityCondition(StringInfo buf, Relation rel,
+							List *keyAttrs);
+static void deparseLiteral(StringInfo buf, Oid type, Datum value);
+static void deparseLikePattern(StringInfo buf, const char *pattern);
+static void deparseColumnRef(StringInfo buf, Index varno, AttrNumber varattno,
+				 PlannerInfo *root);
+static void deparseColumnName(StringInfo buf, Oid relid, AttrNumber attnum);
+static void deparseStringLiteral(StringInfo buf, const char *val);
+static const char *quote_sqlite_identifier(const char *ident);
+
+
+/*
+ * Examine each restriction clause in input_conds, and classify them into
+ * two groups, which are returned as two lists:
+ *	- remote_conds contains expressions that can be evaluated by SQLite
+ *	- local_conds contains expressions that can't be evaluated remotely
+ */
+void
+simpleClassifyConditions(PlannerInfo *root,
+						 RelOptInfo *baserel,
+						 List *input_conds,
+						 List **remote_conds,
+						 List **local_conds)
+{
+	ListCell   *lc;
+
+	*remote_conds = NIL;
+	*local_conds = NIL;
+
+	foreach(lc, input_conds)
+	{
+		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+
+		if (simpleIsForeignExpr(root, baserel, ri->clause))
+			*remote_conds = lappend(*remote_conds, ri);
+		else
+			*local_conds = lappend(*local_conds, ri);
+	}
+}
+
+/*
+ * Returns true if given expr is safe to evaluate on SQLite.
+ */
+bool
+simpleIsForeignExpr(PlannerInfo *root,
+					RelOptInfo *baserel,
+					Expr *expr)
+{
+	foreign_glob_cxt glob_cxt;
+
+	glob_cxt.root = root;
+	glob_cxt.foreignrel = baserel;
+
+	return foreign_expr_walker((Node *) expr, &glob_cxt);
+}
+
+/*
+ * Check if expression is safe to execute remotely, and return true if so.
+ *
+ * We only accept plain columns of the foreign relation, constants, and
+ * a small set of built-in operators and constructs whose semantics are the
+ * same in PostgreSQL and SQLite.  Anything else is evaluated locally.
+ */
+static bool
+foreign_expr_walker(Node *node, foreign_glob_cxt *glob_cxt)
+{
+	/* Need do nothing for empty subexpressions */
+	if (node == NULL)
+		return true;
+
+	switch (nodeTag(node))
+	{
+		case T_Var:
+			{
+				Var		   *var = (Var *) node;
+
+				if (var->varlevelsup != 0)
+					return false;
+
+				/*
+				 * Columns of other relations are sent as parameters, bound
+				 * with their value for each outer row.
+				 */
+				if (!bms_is_member(var->varno, glob_cxt->foreignrel->relids))
+					return is_shippable_type(var->vartype);
+
+				/* System columns have no SQLite counterpart */
+				if (var->varattno <= 0)
+					return false;
+
+				return is_shippable_type(var->vartype);
+			}
+		case T_Param:
+			return is_shippable_type(((Param *) node)->paramtype);
+		case T_Const:
+			return is_shippable_const((Const *) node);
+		case T_RelabelType:
+			{
+				RelabelType *r = (RelabelType *) node;
+
+				/* Binary-compatible casts, e.g. varchar to text */
+				return foreign_expr_walker((Node *) r->arg, glob_cxt);
+			}
+		case T_OpExpr:
+			{
+				OpExpr	   *oe = (OpExpr *) node;
+				const char *opname;
+				Oid			ltype;
+
+				opname = get_shippable_operator(oe->opno);
+				if (opname == NULL || list_length(oe->args) != 2)
+					return false;
+
+				ltype = exprType((Node *) linitial(oe->args));
+
+				if (strcmp(opname, "~~") == 0 || strcmp(opname, "!~~") == 0)
+				{
+					Node	   *pattern = (Node *) lsecond(oe->args);
+
+					/*
+					 * LIKE is turned into GLOB, which is case sensitive like
+					 * PostgreSQL's LIKE.  The pattern has to be translated,
+					 * so it must be a constant.
+					 */
+					if (!is_text_type(ltype) || !IsA(pattern, Const) ||
+						((Const *) pattern)->constisnull)
+						return false;
+
+					/* The local LIKE reports the errors of these */
+					if (!is_deterministic_collation(oe->inputcollid) ||
+						!is_shippable_like_pattern(TextDatumGetCString(((Const *) pattern)->constvalue)))
+						return false;
+				}
+				else if (is_text_type(ltype) &&
+						 (strcmp(opname, "=") == 0 || strcmp(opname, "<>") == 0))
+				{
+					/*
+					 * SQLite's BINARY collation tells equal strings apart
+					 * by their bytes, as deterministic collations do.
+					 */
+					if (!is_deterministic_collation(oe->inputcollid))
+						return false;
+				}
+				else if (is_text_type(ltype))
+				{
+					/*
+					 * SQLite compares strings with memcmp(), so only ship
+					 * ordering comparisons if they use the C collation.
+					 */
+					if (!OidIsValid(oe->inputcollid) ||
+						!lc_collate_is_c(oe->inputcollid))
+						return false;
+				}
+
+				return foreign_expr_walker((Node *) oe->args, glob_cxt);
+			}
+		case T_ScalarArrayOpExpr:
+			{
+				ScalarArrayOpExpr *oe = (ScalarArrayOpExpr *) node;
+				const char *opname;
+				Node	   *arg;
+
+				/* Only "x = ANY(...)" and "x <> ALL(...)" map to IN lists */
+				opname = get_shippable_operator(oe->opno);
+				if (opname == NULL || list_length(oe->args) != 2)
+					return false;
+				if (!((oe->useOr && strcmp(opname, "=") == 0) ||
+					  (!oe->useOr && strcmp(opname, "<>") == 0)))
+					return false;
+				if (is_text_type(exprType((Node *) linitial(oe->args))) &&
+					!is_deterministic_collation(oe->inputcollid))
+					return false;
+
+				if (!foreign_expr_walker((Node *) linitial(oe->args), glob_cxt))
+					return false;
+
+				arg = (Node *) lsecond(oe->args);
+				if (IsA(arg, Const))
+				{
+					Const	   *c = (Const *) arg;
+					ArrayType  *arr;
+					int16		typlen;
+					bool		typbyval;
+					char		typalign;
+					Datum	   *elems;
+					bool	   *nulls;
+					int			nelems;
+					int			i;
+
+					if (c->constisnull ||
+						!is_shippable_type(get_element_type(c->consttype)))
+						return false;
+
+					arr = DatumGetArrayTypeP(c->constvalue);
+					get_typlenbyvalalign(ARR_ELEMTYPE(arr),
+										 &typlen, &typbyval, &typalign);
+					deconstruct_array(arr, ARR_ELEMTYPE(arr),
+									  typlen, typbyval, typalign,
+									  &elems, &nulls, &nelems);
+					for (i = 0; i < nelems; i++)
+					{
+						if (!nulls[i] &&
+							!is_shippable_value(ARR_ELEMTYPE(arr), elems[i]))
+							return false;
+					}
+					return true;
+				}
+				else if (IsA(arg, ArrayExpr))
+					return foreign_expr_walker((Node *) ((ArrayExpr *) arg)->elements,
+											   glob_cxt);
+
+				return false;
+			}
+		case T_NullTest:
+			{
+				NullTest   *nt = (NullTest *) node;
+
+				if (nt->argisrow)
+					return false;
+
+				return foreign_expr_walker((Node *) nt->arg, glob_cxt);
+			}
+		case T_BoolExpr:
+			{
+				BoolExpr   *b = (BoolExpr *) node;
+
+				return foreign_expr_walker((Node *) b->args, glob_cxt);
+			}
+#if (PG_VERSION_NUM >= 120000)
+		case T_Aggref:
+			{
+				Aggref	   *agg = (Aggref *) node;
+				ListCell   *lc;
+
+				/* Only found in the target list of a grouped relation */
+				if (!is_shippable_aggregate(agg))
+					return false;
+
+				foreach(lc, agg->args)
+				{
+					TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+					if (!foreign_expr_walker((Node *) tle->expr, glob_cxt))
+						return false;
+				}
+				return true;
+			}
+#endif
+		case T_List:
+			{
+				ListCell   *lc;
+
+				foreach(lc, (List *) node)
+				{
+					if (!foreign_expr_walker((Node *) lfirst(lc), glob_cxt))
+						return false;
+				}
+				return true;
+			}
+		default:
+			/* Anything else is not known to be safe */
+			return false;
+	}
+}
+
+/*
+ * Returns true if the clause can use an index of the SQLite table: it must
+ * compare an indexed column of the foreign table with some other value.
+ * This is only a hint for costing, SQLite makes the final decision.
+ */
+bool
+simpleIsIndexableClause(PlannerInfo *root,
+						RelOptInfo *baserel,
+						Expr *clause)
+{
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	const char *opname;
+	Var		   *var = NULL;
+
+	if (IsA(clause, OpExpr))
+	{
+		OpExpr	   *oe = (OpExpr *) clause;
+
+		if (list_length(oe->args) != 2)
+			return false;
+
+		opname = get_shippable_operator(oe->opno);
+		if (opname == NULL || strcmp(opname, "<>") == 0 ||
+			strcmp(opname, "~~") == 0 || strcmp(opname, "!~~") == 0)
+			return false;
+
+		var = get_indexable_var(baserel, (Node *) linitial(oe->args));
+		if (var == NULL)
+			var = get_indexable_var(baserel, (Node *) lsecond(oe->args));
+	}
+	else if (IsA(clause, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *oe = (ScalarArrayOpExpr *) clause;
+
+		opname = get_shippable_operator(oe->opno);
+		if (opname == NULL || !oe->useOr || strcmp(opname, "=") != 0)
+			return false;
+
+		var = get_indexable_var(baserel, (Node *) linitial(oe->args));
+	}
+
+	return var != NULL &&
+		simpleIsIndexedColumn(baserel, rte->relid, var->varattno);
+}
+
+/*
+ * Returns the Var if the node is a plain column of the foreign table.
+ */
+static Var *
+get_indexable_var(RelOptInfo *baserel, Node *node)
+{
+	if (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	if (node && IsA(node, Var) &&
+		((Var *) node)->varno == baserel->relid &&
+		((Var *) node)->varlevelsup == 0 &&
+		((Var *) node)->varattno > 0)
+		return (Var *) node;
+
+	return NULL;
+}
+
+/*
+ * Returns true if the column is the leading column of an index of the
+ * SQLite table, or its rowid, or if it was declared as a key column.
+ */
+bool
+simpleIsIndexedColumn(RelOptInfo *baserel, Oid relid, AttrNumber attnum)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	char	   *colname = simpleGetColumnName(relid, attnum);
+	ListCell   *lc;
+
+	if (is_rowid_name(colname) || simpleIsKeyColumn(relid, attnum))
+		return true;
+
+	foreach(lc, fpinfo->indexes)
+	{
+		SimpleIndexInfo *index = (SimpleIndexInfo *) lfirst(lc);
+
+		/* SQLite identifiers are case insensitive */
+		if (index->columns != NIL &&
+			pg_strcasecmp(strVal(linitial(index->columns)), colname) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if the rows of the foreign table can be returned by SQLite in
+ * the order of the given pathkeys, by walking one of its indexes forwards
+ * or backwards.
+ *
+ * SQLite sorts numbers the way PostgreSQL does, and text too when both use
+ * a bytewise order: the C collation on our side, and BINARY on SQLite's.
+ * SQLite puts NULLs first in ascending order and last in descending order,
+ * so the NULL ordering of the pathkeys has to match that unless the column
+ * can't hold NULLs.
+ */
+bool
+simplePathkeysUseIndex(PlannerInfo *root, RelOptInfo *baserel, List *pathkeys)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	int			nkeys = list_length(pathkeys);
+	char	  **colnames;
+	bool	   *descending;
+	bool	   *notnull;
+	bool	   *text;
+	ListCell   *lc;
+	int			i;
+
+	if (nkeys == 0)
+		return false;
+
+	colnames = (char **) palloc(sizeof(char *) * nkeys);
+	descending = (bool *) palloc(sizeof(bool) * nkeys);
+	notnull = (bool *) palloc(sizeof(bool) * nkeys);
+	text = (bool *) palloc(sizeof(bool) * nkeys);
+
+	i = 0;
+	foreach(lc, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		EquivalenceClass *ec = pathkey->pk_eclass;
+		Var		   *var;
+		Oid			opclass;
+
+		if (ec->ec_has_volatile)
+			return false;
+
+		var = simpleFindEmVar(ec, baserel);
+		if (var == NULL || !is_shippable_type(var->vartype))
+			return false;
+
+		/* The sort has to use the default btree operators of the type */
+		opclass = GetDefaultOpClass(var->vartype, BTREE_AM_OID);
+		if (!OidIsValid(opclass) ||
+			get_opclass_family(opclass) != pathkey->pk_opfamily)
+			return false;
+
+		text[i] = is_text_type(var->vartype);
+		if (text[i] && !lc_collate_is_c(ec->ec_collation))
+			return false;
+
+		colnames[i] = simpleGetColumnName(rte->relid, var->varattno);
+		descending[i] = (pathkey->pk_strategy == BTGreaterStrategyNumber);
+		notnull[i] = is_notnull_column(baserel, rte->relid, var->varattno);
+		if (!notnull[i] && pathkey->pk_nulls_first == descending[i])
+			return false;
+		i++;
+	}
+
+	foreach(lc, fpinfo->indexes)
+	{
+		SimpleIndexInfo *index = (SimpleIndexInfo *) lfirst(lc);
+		bool		forward = true;
+		bool		backward = true;
+
+		if (list_length(index->columns) < nkeys)
+			continue;
+
+		for (i = 0; i < nkeys && (forward || backward); i++)
+		{
+			/* SQLite identifiers are case insensitive */
+			if (pg_strcasecmp(strVal(list_nth(index->columns, i)),
+							  colnames[i]) != 0 ||
+				(text[i] &&
+				 pg_strcasecmp(strVal(list_nth(index->collations, i)),
+							   "BINARY") != 0))
+				forward = backward = false;
+			else if (list_nth_int(index->descending, i) == descending[i])
+				backward = false;
+			else
+				forward = false;
+		}
+
+		if (forward || backward)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns the Var of the foreign table found in an equivalence class, if
+ * any.
+ */
+Var *
+simpleFindEmVar(EquivalenceClass *ec, RelOptInfo *rel)
+{
+	ListCell   *lc;
+
+	foreach(lc, ec->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+		Var		   *var = get_indexable_var(rel, (Node *) em->em_expr);
+
+		if (var != NULL)
+			return var;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns true if the column can't be NULL: it's declared NOT NULL either
+ * in the foreign table or in the SQLite table, or it's the rowid.
+ */
+static bool
+is_notnull_column(RelOptInfo *baserel, Oid relid, AttrNumber attnum)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	char	   *colname = simpleGetColumnName(relid, attnum);
+	HeapTuple	tp;
+	ListCell   *lc;
+
+	tp = SearchSysCache2(ATTNUM,
+						 ObjectIdGetDatum(relid),
+						 Int16GetDatum(attnum));
+	if (HeapTupleIsValid(tp))
+	{
+		bool		attnotnull = ((Form_pg_attribute) GETSTRUCT(tp))->attnotnull;
+
+		ReleaseSysCache(tp);
+		if (attnotnull)
+			return true;
+	}
+
+	if (is_rowid_name(colname))
+		return true;
+
+	foreach(lc, fpinfo->notnull_columns)
+	{
+		if (pg_strcasecmp(strVal(lfirst(lc)), colname) == 0)
+			return true;
+	}
+
+	foreach(lc, fpinfo->indexes)
+	{
+		SimpleIndexInfo *index = (SimpleIndexInfo *) lfirst(lc);
+
+		if (index->name == NULL &&
+			pg_strcasecmp(strVal(linitial(index->columns)), colname) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Types whose values and comparisons behave the same in SQLite.  Numeric
+ * values are not: SQLite turns their literals into doubles, and keeps the
+ * values of NUMERIC columns that don't fit a double as TEXT, which sorts
+ * above every number.
+ */
+static bool
+is_shippable_type(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case TEXTOID:
+		case VARCHAROID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+#if (PG_VERSION_NUM >= 120000)
+/*
+ * An aggregate is shippable if SQLite has a built-in aggregate giving the
+ * same result for its argument type:
+ *	- count(*) and count(any)
+ *	- sum of smallint and integer, which can't overflow SQLite's 64-bit
+ *	  integer sum, and of double precision
+ *	- avg of double precision; the avg of integers is a numeric in
+ *	  PostgreSQL, but a floating point value in SQLite
+ *	- min and max of integers, floating point values, and text in the C
+ *	  collation, sent with COLLATE BINARY
+ * DISTINCT, ORDER BY and FILTER clauses are not sent.
+ */
+static bool
+is_shippable_aggregate(Aggref *agg)
+{
+	char	   *aggname;
+	Oid			argtype;
+
+	if (agg->aggsplit != AGGSPLIT_SIMPLE || agg->aggkind != AGGKIND_NORMAL ||
+		agg->aggdistinct != NIL || agg->aggorder != NIL ||
+		agg->aggfilter != NULL || agg->aggvariadic)
+		return false;
+
+	if (get_func_namespace(agg->aggfnoid) != PG_CATALOG_NAMESPACE)
+		return false;
+
+	aggname = get_func_name(agg->aggfnoid);
+
+	if (strcmp(aggname, "count") == 0)
+		return agg->aggstar || list_length(agg->args) == 1;
+
+	if (list_length(agg->args) != 1)
+		return false;
+
+	argtype = exprType((Node *) ((TargetEntry *) linitial(agg->args))->expr);
+
+	if (strcmp(aggname, "sum") == 0)
+		return argtype == INT2OID || argtype == INT4OID ||
+			argtype == FLOAT8OID;
+
+	if (strcmp(aggname, "avg") == 0)
+		return argtype == FLOAT8OID;
+
+	if (strcmp(aggname, "min") == 0 || strcmp(aggname, "max") == 0)
+	{
+		switch (argtype)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+				return true;
+			case TEXTOID:
+			case VARCHAROID:
+				return lc_collate_is_c(agg->inputcollid);
+			default:
+				return false;
+		}
+	}
+
+	return false;
+}
+#endif
+
+static bool
+is_text_type(Oid typid)
+{
+	return typid == TEXTOID || typid == VARCHAROID;
+}
+
+/*
+ * A LIKE pattern ending with an unpaired escape character is an error in
+ * PostgreSQL, which the local LIKE has to report.
+ */
+static bool
+is_shippable_like_pattern(const char *pattern)
+{
+	const char *p;
+
+	for (p = pattern; *p; p++)
+	{
+		if (*p == '\\')
+		{
+			if (p[1] == '\0')
+				return false;
+			p++;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Returns true if strings are equal under the collation only when their
+ * bytes are.
+ */
+static bool
+is_deterministic_collation(Oid collid)
+{
+#if (PG_VERSION_NUM >= 120000)
+	return !OidIsValid(collid) || get_collation_isdeterministic(collid);
+#else
+	return true;
+#endif
+}
+
+/*
+ * Returns true if the texts of the expression can be grouped by SQLite:
+ * the GROUP BY sent to SQLite compares them with the BINARY collation.
+ */
+bool
+simpleIsGroupableExpr(Expr *expr)
+{
+	return !is_text_type(exprType((Node *) expr)) ||
+		is_deterministic_collation(exprCollation((Node *) expr));
+}
+
+/*
+ * A constant is shippable if its type is, and if it can be written as a
+ * SQLite literal.
+ */
+static bool
+is_shippable_const(Const *node)
+{
+	if (!is_shippable_type(node->consttype))
+		return false;
+
+	if (node->constisnull)
+		return true;
+
+	return is_shippable_value(node->consttype, node->constvalue);
+}
+
+/*
+ * NaN and infinite values have no SQLite literal equivalent.
+ */
+static bool
+is_shippable_value(Oid type, Datum value)
+{
+	Oid			typoutput;
+	bool		typIsVarlena;
+	char	   *extval;
+	bool		result = true;
+
+	switch (type)
+	{
+		case FLOAT4OID:
+		case FLOAT8OID:
+			getTypeOutputInfo(type, &typoutput, &typIsVarlena);
+			extval = OidOutputFunctionCall(typoutput, value);
+			result = (strspn(extval, "0123456789+-eE.") == strlen(extval));
+			pfree(extval);
+			break;
+		default:
+			break;
+	}
+
+	return result;
+}
+
+/*
+ * Return the name of a built-in operator we know how to ship, or NULL.
+ */
+static const char *
+get_shippable_operator(Oid opno)
+{
+	static const char *const shippable_ops[] =
+	{
+		"=", "<>", "<", "<=", ">", ">=", "~~", "!~~", NULL
+	};
+	HeapTuple	tuple;
+	Form_pg_operator form;
+	const char *result = NULL;
+	int			i;
+
+	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(opno));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for operator %u", opno);
+	form = (Form_pg_operator) GETSTRUCT(tuple);
+
+	if (form->oprnamespace == PG_CATALOG_NAMESPACE &&
+		is_shippable_type(form->oprleft) &&
+		is_shippable_type(form->oprright))
+	{
+		for (i = 0; shippable_ops[i] != NULL; i++)
+		{
+			if (strcmp(NameStr(form->oprname), shippable_ops[i]) == 0)
+			{
+				result = shippable_ops[i];
+				break;
+			}
+		}
+	}
+
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
+/*
+ * Construct a simple SELECT statement that retrieves the desired columns
+ * of the foreign table.
+ *
+ * We only fetch the columns listed in attrs_used; the attribute numbers of
+ * the columns actually fetched, in the order they appear in the SELECT
+ * list, are returned in *retrieved_attrs.
+ */
+void
+simpleDeparseSelectSql(StringInfo buf,
+					   PlannerInfo *root,
+					   RelOptInfo *baserel,
+					   const char *table,
+					   Bitmapset *attrs_used,
+					   List **retrieved_attrs)
+{
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	Relation	rel;
+	TupleDesc	tupdesc;
+	bool		have_wholerow;
+	bool		first = true;
+	int			i;
+
+	/*
+	 * Core code already has some lock on each rel being planned, so we can
+	 * use NoLock here.
+	 */
+#if (PG_VERSION_NUM >= 120000)
+	rel = table_open(rte->relid, NoLock);
+#else
+	rel = heap_open(rte->relid, NoLock);
+#endif
+	tupdesc = RelationGetDescr(rel);
+
+	/* If there's a whole-row reference, we'll need all the columns. */
+	have_wholerow = bms_is_member(0 - FirstLowInvalidHeapAttributeNumber,
+								  attrs_used);
+
+	*retrieved_attrs = NIL;
+
+	appendStringInfoString(buf, "SELECT ");
+	for (i = 1; i <= tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i - 1);
+
+		/* Ignore dropped attributes. */
+		if (attr->attisdropped)
+			continue;
+
+		if (have_wholerow ||
+			bms_is_member(i - FirstLowInvalidHeapAttributeNumber, attrs_used))
+		{
+			if (!first)
+				appendStringInfoString(buf, ", ");
+			first = false;
+
+			deparseColumnRef(buf, baserel->relid, i, root);
+			*retrieved_attrs = lappend_int(*retrieved_attrs, i);
+		}
+	}
+
+	/*
+	 * The ctid of the rows is made of their rowid, which identifies the
+	 * rows to update or delete.
+	 */
+	if (bms_is_member(SelfItemPointerAttributeNumber - FirstLowInvalidHeapAttributeNumber,
+					  attrs_used))
+	{
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		appendStringInfoString(buf, "rowid");
+		*retrieved_attrs = lappend_int(*retrieved_attrs,
+									   SelfItemPointerAttributeNumber);
+	}
+
+	/* Don't generate bad syntax if no undropped columns are needed */
+	if (first)
+		appendStringInfoString(buf, "NULL");
+
+	appendStringInfo(buf, " FROM %s", table);
+
+#if (PG_VERSION_NUM >= 120000)
+	table_close(rel, NoLock);
+#else
+	heap_close(rel, NoLock);
+#endif
+}
+
+/*
+ * Construct a SELECT statement retrieving all the columns of the foreign
+ * table, for ANALYZE.  The caller adds the sampling clauses.
+ */
+void
+simpleDeparseAnalyzeSql(StringInfo buf, Relation rel, const char *table,
+						List **retrieved_attrs)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	bool		first = true;
+	int			i;
+
+	*retrieved_attrs = NIL;
+
+	appendStringInfoString(buf, "SELECT ");
+	for (i = 1; i <= tupdesc->natts; i++)
+	{
+		/* Ignore dropped columns. */
+		if (TupleDescAttr(tupdesc, i - 1)->attisdropped)
+			continue;
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseColumnName(buf, RelationGetRelid(rel), i);
+		*retrieved_attrs = lappend_int(*retrieved_attrs, i);
+	}
+
+	/* Don't generate bad syntax for zero-column relation. */
+	if (first)
+		appendStringInfoString(buf, "NULL");
+
+	appendStringInfo(buf, " FROM %s", table);
+}
+
+/*
+ * Construct a simple INSERT statement of one row, with a parameter for
+ * each column of targetAttrs.  The length of the statement up to the end
+ * of its VALUES row is returned in *values_end_len, for
+ * simpleRebuildInsertSql.
+ */
+void
+simpleDeparseInsertSql(StringInfo buf, Relation rel, const char *table,
+					   List *targetAttrs, bool doNothing,
+					   int *values_end_len)
+{
+	ListCell   *lc;
+	bool		first;
+
+	appendStringInfo(buf, "INSERT INTO %s", table);
+
+	if (targetAttrs)
+	{
+		appendStringInfoString(buf, " (");
+
+		first = true;
+		foreach(lc, targetAttrs)
+		{
+			int			attnum = lfirst_int(lc);
+
+			if (!first)
+				appendStringInfoString(buf, ", ");
+			first = false;
+
+			deparseColumnName(buf, RelationGetRelid(rel), attnum);
+		}
+
+		appendStringInfoString(buf, ") VALUES ");
+		deparseInsertValues(buf, list_length(targetAttrs));
+	}
+	else
+		appendStringInfoString(buf, " DEFAULT VALUES");
+	*values_end_len = buf->len;
+
+	if (doNothing)
+		appendStringInfoString(buf, " ON CONFLICT DO NOTHING");
+}
+
+/*
+ * Rebuild the INSERT statement built by simpleDeparseInsertSql, to insert
+ * num_rows rows of num_params parameters at once.
+ */
+void
+simpleRebuildInsertSql(StringInfo buf, const char *orig_query,
+					   int values_end_len, int num_params, int num_rows)
+{
+	int			i;
+
+	/* Copy up to the end of the first row of VALUES */
+	appendBinaryStringInfo(buf, orig_query, values_end_len);
+
+	for (i = 1; i < num_rows; i++)
+	{
+		appendStringInfoString(buf, ", ");
+		deparseInsertValues(buf, num_params);
+	}
+
+	/* Copy the ON CONFLICT clause, if any */
+	appendStringInfoString(buf, orig_query + values_end_len);
+}
+
+/*
+ * Append a row of num_params parameters to the VALUES clause of an INSERT
+ */
+static void
+deparseInsertValues(StringInfo buf, int num_params)
+{
+	int			i;
+
+	appendStringInfoChar(buf, '(');
+	for (i = 0; i < num_params; i++)
+	{
+		if (i > 0)
+			appendStringInfoString(buf, ", ");
+		appendStringInfoChar(buf, '?');
+	}
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Construct an UPDATE statement of the columns of targetAttrs, for the
+ * row identified by the parameters following them.
+ */
+void
+simpleDeparseUpdateSql(StringInfo buf, Relation rel, const char *table,
+					   List *targetAttrs, List *keyAttrs)
+{
+	ListCell   *lc;
+	bool		first = true;
+
+	appendStringInfo(buf, "UPDATE %s SET ", table);
+
+	foreach(lc, targetAttrs)
+	{
+		int			attnum = lfirst_int(lc);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseColumnName(buf, RelationGetRelid(rel), attnum);
+		appendStringInfoString(buf, " = ?");
+	}
+
+	deparseRowIdentityCondition(buf, rel, keyAttrs);
+}
+
+/*
+ * Construct a DELETE statement for the row identified by the parameters.
+ */
+void
+simpleDeparseDeleteSql(StringInfo buf, Relation rel, const char *table,
+					   List *keyAttrs)
+{
+	appendStringInfo(buf, "DELETE FROM %s", table);
+
+	deparseRowIdentityCondition(buf, rel, keyAttrs);
+}
+
+/*
+ * Append the WHERE clause finding the row to update or delete: by its key
+ * columns when the foreign table has some, or else by its rowid.
+ */
+static void
+deparseRowIdentityCondition(StringInfo buf, Relation rel, List *keyAttrs)
+{
+	ListCell   *lc;
+	bool		first = true;
+
+	if (keyAttrs == NIL)
+	{
+		appendStringInfoString(buf, " WHERE rowid = ?");
+		return;
+	}
+
+	foreach(lc, keyAttrs)
+	{
+		appendStringInfoString(buf, first ? " WHERE " : " AND ");
+		first = false;
+
+		deparseColumnName(buf, RelationGetRelid(rel), lfirst_int(lc));
+		appendStringInfoString(buf, " = ?");
+	}
+}
+
+/*
+ * Deparse WHERE clauses in given list of RestrictInfos or bare expressions
+ * and append them to buf.  All the clauses must be shippable, which the
+ * caller checked with simpleIsForeignExpr.
+ */
+void
+simpleAppendWhereClause(StringInfo buf,
+						PlannerInfo *root,
+						RelOptInfo *baserel,
+						List *exprs,
+						List **params_list)
+{
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	bool		is_first = true;
+
+	context.root = root;
+	context.foreignrel = baserel;
+	context.buf = buf;
+	context.params_list = params_list;
+
+	foreach(lc, exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+
+		if (IsA(expr, RestrictInfo))
+			expr = ((RestrictInfo *) expr)->clause;
+
+		appendStringInfoString(buf, is_first ? " WHERE " : " AND ");
+		appendStringInfoChar(buf, '(');
+		deparseExpr(expr, &context);
+		appendStringInfoChar(buf, ')');
+
+		is_first = false;
+	}
+}
+
+/*
+ * Append an ORDER BY clause for the given pathkeys to buf.
+ *
+ * The pathkeys have been checked by simplePathkeysUseIndex, so SQLite's own
+ * NULL ordering is the one wanted and no NULLS FIRST/LAST is needed; that
+ * syntax isn't known before SQLite 3.30 anyway.
+ */
+void
+simpleAppendOrderByClause(StringInfo buf,
+						  PlannerInfo *root,
+						  RelOptInfo *baserel,
+						  List *pathkeys)
+{
+	ListCell   *lc;
+	const char *delim = " ORDER BY ";
+
+	foreach(lc, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		Var		   *var = simpleFindEmVar(pathkey->pk_eclass, baserel);
+
+		Assert(var != NULL);
+
+		appendStringInfoString(buf, delim);
+		deparseColumnRef(buf, var->varno, var->varattno, root);
+		if (is_text_type(var->vartype))
+			appendStringInfoString(buf, " COLLATE BINARY");
+		if (pathkey->pk_strategy == BTGreaterStrategyNumber)
+			appendStringInfoString(buf, " DESC");
+		else
+			appendStringInfoString(buf, " ASC");
+
+		delim = ", ";
+	}
+}
+
+#if (PG_VERSION_NUM >= 120000)
+/*
+ * Construct a grouped SELECT statement on the SQLite table of baserel:
+ * the expressions of tlist, computed from the rows that match
+ * remote_conds, grouped by the GROUP BY clause of the query.
+ */
+void
+simpleDeparseGroupSql(StringInfo buf,
+					  PlannerInfo *root,
+					  RelOptInfo *baserel,
+					  const char *table,
+					  List *tlist,
+					  List *remote_conds,
+					  List **params_list)
+{
+	Query	   *query = root->parse;
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	bool		first = true;
+
+	context.root = root;
+	context.foreignrel = baserel;
+	context.buf = buf;
+	context.params_list = params_list;
+
+	appendStringInfoString(buf, "SELECT ");
+	foreach(lc, tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseExpr(tle->expr, &context);
+	}
+
+	/* Don't generate bad syntax if the target list is empty */
+	if (first)
+		appendStringInfoString(buf, "NULL");
+
+	appendStringInfo(buf, " FROM %s", table);
+
+	simpleAppendWhereClause(buf, root, baserel, remote_conds, params_list);
+
+	first = true;
+	foreach(lc, query->groupClause)
+	{
+		SortGroupClause *grp = (SortGroupClause *) lfirst(lc);
+		TargetEntry *tle = get_sortgroupref_tle(grp->tleSortGroupRef, tlist);
+
+		appendStringInfoString(buf, first ? " GROUP BY " : ", ");
+		first = false;
+
+		deparseExpr(tle->expr, &context);
+		deparseBinaryCollation(tle->expr, &context);
+	}
+}
+#endif
+
+#if (PG_VERSION_NUM >= 120000)
+/*
+ * Construct a SELECT statement joining SQLite tables: the columns of tlist,
+ * from the join of joinrel, restricted by remote_conds.
+ */
+void
+simpleDeparseJoinSql(StringInfo buf,
+					 PlannerInfo *root,
+					 RelOptInfo *joinrel,
+					 List *tlist,
+					 List *remote_conds,
+					 List **params_list)
+{
+	deparse_expr_cxt context;
+	ListCell   *lc;
+	bool		first = true;
+
+	context.root = root;
+	context.foreignrel = joinrel;
+	context.buf = buf;
+	context.params_list = params_list;
+
+	appendStringInfoString(buf, "SELECT ");
+	foreach(lc, tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseExpr(tle->expr, &context);
+	}
+
+	/* Don't generate bad syntax if no columns are needed */
+	if (first)
+		appendStringInfoString(buf, "NULL");
+
+	appendStringInfoString(buf, " FROM ");
+	deparseFromExpr(buf, root, joinrel, params_list);
+
+	simpleAppendWhereClause(buf, root, joinrel, remote_conds, params_list);
+}
+
+/*
+ * Deparse the FROM item of a relation: a table with its alias, or a join
+ * of two FROM items in parentheses with its ON clause.
+ */
+static void
+deparseFromExpr(StringInfo buf, PlannerInfo *root, RelOptInfo *foreignrel,
+				List **params_list)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) foreignrel->fdw_private;
+
+	if (foreignrel->reloptkind == RELOPT_JOINREL)
+	{
+		deparse_expr_cxt context;
+		ListCell   *lc;
+		bool		first = true;
+
+		appendStringInfoChar(buf, '(');
+		deparseFromExpr(buf, root, fpinfo->outerrel, params_list);
+		appendStringInfoString(buf, fpinfo->jointype == JOIN_LEFT ?
+							   " LEFT JOIN " : " INNER JOIN ");
+		deparseFromExpr(buf, root, fpinfo->innerrel, params_list);
+
+		context.root = root;
+		context.foreignrel = foreignrel;
+		context.buf = buf;
+		context.params_list = params_list;
+
+		appendStringInfoString(buf, " ON ");
+		foreach(lc, fpinfo->joinclauses)
+		{
+			Expr	   *expr = ((RestrictInfo *) lfirst(lc))->clause;
+
+			if (!first)
+				appendStringInfoString(buf, " AND ");
+			first = false;
+
+			appendStringInfoChar(buf, '(');
+			deparseExpr(expr, &context);
+			appendStringInfoChar(buf, ')');
+		}
+
+		/* A join without any clause, like a cross join */
+		if (first)
+			appendStringInfoChar(buf, '1');
+
+		appendStringInfoChar(buf, ')');
+	}
+	else
+		appendStringInfo(buf, "%s %s%d", fpinfo->table,
+						 REL_ALIAS_PREFIX, foreignrel->relid);
+}
+#endif
+
+/*
+ * Append the rowid range condition of a parallel scan to buf, after the
+ * WHERE clause if the query has one.  The bounds are the parameters
+ * first_param and first_param + 1, bound by each participant for each
+ * chunk of rowids it claims.
+ */
+void
+simpleAppendRowidRangeClause(StringInfo buf, bool has_where, int first_param)
+{
+	appendStringInfo(buf, "%s(rowid BETWEEN ?%d AND ?%d)",
+					 has_where ? " AND " : " WHERE ",
+					 first_param, first_param + 1);
+}
+
+/*
+ * Returns true if the LIMIT and OFFSET of the query can be sent to SQLite:
+ * they have to be non-NULL constants.  A negative LIMIT is an error, which
+ * is left to PostgreSQL to raise; SQLite would take it as no limit.
+ */
+bool
+simpleIsLimitPushable(PlannerInfo *root)
+{
+	Node	   *nodes[2];
+	int			i;
+
+	nodes[0] = root->parse->limitCount;
+	nodes[1] = root->parse->limitOffset;
+
+	for (i = 0; i < 2; i++)
+	{
+		Const	   *c = (Const *) nodes[i];
+
+		if (c == NULL)
+			continue;
+		if (!IsA(c, Const) || c->consttype != INT8OID ||
+			c->constisnull || DatumGetInt64(c->constvalue) < 0)
+			return false;
+	}
+
+#if (PG_VERSION_NUM >= 130000)
+	if (root->parse->limitOption == LIMIT_OPTION_WITH_TIES)
+		return false;
+#endif
+
+	return true;
+}
+
+/*
+ * Append the LIMIT/OFFSET clause of the query to buf.  SQLite only knows
+ * OFFSET after a LIMIT, -1 meaning no limit.
+ */
+void
+simpleAppendLimitClause(StringInfo buf, PlannerInfo *root)
+{
+	Const	   *count = (Const *) root->parse->limitCount;
+	Const	   *offset = (Const *) root->parse->limitOffset;
+
+	appendStringInfo(buf, " LIMIT " INT64_FORMAT,
+					 count ? DatumGetInt64(count->constvalue) : (int64) -1);
+	if (offset)
+		appendStringInfo(buf, " OFFSET " INT64_FORMAT,
+						 DatumGetInt64(offset->constvalue));
+}
+
+/*
+ * Deparse given expression into context->buf.
+ */
+static void
+deparseExpr(Expr *node, deparse_expr_cxt *context)
+{
+	if (node == NULL)
+		return;
+
+	switch (nodeTag(node))
+	{
+		case T_Var:
+			deparseVar((Var *) node, context);
+			break;
+		case T_Const:
+			deparseConst((Const *) node, context);
+			break;
+		case T_Param:
+			deparseParam(node, context);
+			break;
+		case T_RelabelType:
+			deparseExpr(((RelabelType *) node)->arg, context);
+			break;
+		case T_OpExpr:
+			deparseOpExpr((OpExpr *) node, context);
+			break;
+		case T_ScalarArrayOpExpr:
+			deparseScalarArrayOpExpr((ScalarArrayOpExpr *) node, context);
+			break;
+		case T_BoolExpr:
+			deparseBoolExpr((BoolExpr *) node, context);
+			break;
+		case T_NullTest:
+			deparseNullTest((NullTest *) node, context);
+			break;
+#if (PG_VERSION_NUM >= 120000)
+		case T_Aggref:
+			deparseAggref((Aggref *) node, context);
+			break;
+#endif
+		default:
+			elog(ERROR, "unsupported expression type for deparse: %d",
+				 (int) nodeTag(node));
+			break;
+	}
+}
+
+/*
+ * Deparse a Var: a column of the foreign table, or the column of an outer
+ * relation, which is sent as a parameter.
+ */
+static void
+deparseVar(Var *node, deparse_expr_cxt *context)
+{
+	if (bms_is_member(node->varno, context->foreignrel->relids))
+	{
+		/* Columns of a join are qualified with the alias of their table */
+		if (context->foreignrel->reloptkind == RELOPT_JOINREL)
+			appendStringInfo(context->buf, "%s%d.",
+							 REL_ALIAS_PREFIX, node->varno);
+		deparseColumnRef(context->buf, node->varno, node->varattno,
+						 context->root);
+	}
+	else
+		deparseParam((Expr *) node, context);
+}
+
+/*
+ * Deparse a value computed locally as a numbered SQLite parameter.  The
+ * expression is added to params_list, whose order gives the parameter
+ * numbers, unless it's already there.
+ */
+static void
+deparseParam(Expr *node, deparse_expr_cxt *context)
+{
+	ListCell   *lc;
+	int			pindex = 0;
+
+	foreach(lc, *context->params_list)
+	{
+		pindex++;
+		if (equal(node, (Node *) lfirst(lc)))
+			break;
+	}
+	if (lc == NULL)
+	{
+		/* not in list, so add it */
+		pindex++;
+		*context->params_list = lappend(*context->params_list, node);
+	}
+
+	appendStringInfo(context->buf, "?%d", pindex);
+}
+
+static void
+deparseConst(Const *node, deparse_expr_cxt *context)
+{
+	if (node->constisnull)
+	{
+		appendStringInfoString(context->buf, "NULL");
+		return;
+	}
+
+	deparseLiteral(context->buf, node->consttype, node->constvalue);
+}
+
+/*
+ * Deparse a binary operator.  LIKE and NOT LIKE are sent as GLOB, since
+ * SQLite's LIKE ignores case for ASCII characters.
+ */
+static void
+deparseOpExpr(OpExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	const char *opname = get_shippable_operator(node->opno);
+	Expr	   *left = (Expr *) linitial(node->args);
+	Expr	   *right = (Expr *) lsecond(node->args);
+
+	appendStringInfoChar(buf, '(');
+	deparseExpr(left, context);
+
+	if (strcmp(opname, "~~") == 0 || strcmp(opname, "!~~") == 0)
+	{
+		/* GLOB compares the bytes whatever the collation */
+		Const	   *pattern = (Const *) right;
+
+		appendStringInfoString(buf, strcmp(opname, "~~") == 0 ?
+							   " GLOB " : " NOT GLOB ");
+		deparseLikePattern(buf, TextDatumGetCString(pattern->constvalue));
+	}
+	else
+	{
+		deparseBinaryCollation(left, context);
+		appendStringInfo(buf, " %s ", opname);
+		deparseExpr(right, context);
+	}
+
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Deparse "x = ANY(...)" as "x IN (...)" and "x <> ALL(...)" as
+ * "x NOT IN (...)".
+ */
+static void
+deparseScalarArrayOpExpr(ScalarArrayOpExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	Expr	   *left = (Expr *) linitial(node->args);
+	Expr	   *right = (Expr *) lsecond(node->args);
+
+	appendStringInfoChar(buf, '(');
+	deparseExpr(left, context);
+	deparseBinaryCollation(left, context);
+	appendStringInfoString(buf, node->useOr ? " IN (" : " NOT IN (");
+
+	if (IsA(right, Const))
+	{
+		Const	   *c = (Const *) right;
+		ArrayType  *arr = DatumGetArrayTypeP(c->constvalue);
+		Oid			elemtype = ARR_ELEMTYPE(arr);
+		int16		typlen;
+		bool		typbyval;
+		char		typalign;
+		Datum	   *elems;
+		bool	   *nulls;
+		int			nelems;
+		int			i;
+
+		get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+		deconstruct_array(arr, elemtype, typlen, typbyval, typalign,
+						  &elems, &nulls, &nelems);
+
+		for (i = 0; i < nelems; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(buf, ", ");
+			if (nulls[i])
+				appendStringInfoString(buf, "NULL");
+			else
+				deparseLiteral(buf, elemtype, elems[i]);
+		}
+	}
+	else
+	{
+		ArrayExpr  *a = (ArrayExpr *) right;
+		ListCell   *lc;
+		bool		first = true;
+
+		foreach(lc, a->elements)
+		{
+			if (!first)
+				appendStringInfoString(buf, ", ");
+			deparseExpr((Expr *) lfirst(lc), context);
+			first = false;
+		}
+	}
+
+	appendStringInfoString(buf, "))");
+}
+
+static void
+deparseBoolExpr(BoolExpr *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	const char *op = NULL;
+	ListCell   *lc;
+	bool		first = true;
+
+	switch (node->boolop)
+	{
+		case AND_EXPR:
+			op = "AND";
+			break;
+		case OR_EXPR:
+			op = "OR";
+			break;
+		case NOT_EXPR:
+			appendStringInfoString(buf, "(NOT ");
+			deparseExpr(linitial(node->args), context);
+			appendStringInfoChar(buf, ')');
+			return;
+	}
+
+	appendStringInfoChar(buf, '(');
+	foreach(lc, node->args)
+	{
+		if (!first)
+			appendStringInfo(buf, " %s ", op);
+		deparseExpr((Expr *) lfirst(lc), context);
+		first = false;
+	}
+	appendStringInfoChar(buf, ')');
+}
+
+static void
+deparseNullTest(NullTest *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+
+	appendStringInfoChar(buf, '(');
+	deparseExpr(node->arg, context);
+	if (node->nulltesttype == IS_NULL)
+		appendStringInfoString(buf, " IS NULL)");
+	else
+		appendStringInfoString(buf, " IS NOT NULL)");
+}
+
+#if (PG_VERSION_NUM >= 120000)
+/*
+ * Deparse an aggregate call.  is_shippable_aggregate only accepts
+ * aggregates which have a SQLite built-in of the same name.
+ */
+static void
+deparseAggref(Aggref *node, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+	bool		first = true;
+
+	appendStringInfo(buf, "%s(", get_func_name(node->aggfnoid));
+
+	if (node->aggstar)
+		appendStringInfoChar(buf, '*');
+
+	foreach(lc, node->args)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		deparseExpr(tle->expr, context);
+		deparseBinaryCollation(tle->expr, context);
+	}
+
+	appendStringInfoChar(buf, ')');
+}
+#endif
+
+/*
+ * Follow a text expression with COLLATE BINARY, so that SQLite compares
+ * its values by their bytes rather than with the collating sequence its
+ * column may have been declared with, e.g. NOCASE.  The C collation of
+ * PostgreSQL, and its deterministic collations for equality, agree with
+ * that.
+ */
+static void
+deparseBinaryCollation(Expr *node, deparse_expr_cxt *context)
+{
+	if (is_text_type(exprType((Node *) node)))
+		appendStringInfoString(context->buf, " COLLATE BINARY");
+}
+
+/*
+ * Write a non-null value of one of the shippable types as a SQLite literal.
+ */
+static void
+deparseLiteral(StringInfo buf, Oid type, Datum value)
+{
+	Oid			typoutput;
+	bool		typIsVarlena;
+	char	   *extval;
+	int			nestlevel;
+
+	/* floats are written with all their digits */
+	nestlevel = simpleSetTransmissionModes();
+	getTypeOutputInfo(type, &typoutput, &typIsVarlena);
+	extval = OidOutputFunctionCall(typoutput, value);
+	simpleResetTransmissionModes(nestlevel);
+
+	switch (type)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+			appendStringInfoString(buf, extval);
+			break;
+		default:
+			deparseStringLiteral(buf, extval);
+			break;
+	}
+
+	pfree(extval);
+}
+
+/*
+ * Translate a LIKE pattern, using the default backslash escape, into a
+ * GLOB pattern literal.
+ */
+static void
+deparseLikePattern(StringInfo buf, const char *pattern)
+{
+	StringInfoData glob;
+	const char *p;
+
+	initStringInfo(&glob);
+
+	for (p = pattern; *p; p++)
+	{
+		switch (*p)
+		{
+			case '%':
+				appendStringInfoChar(&glob, '*');
+				break;
+			case '_':
+				appendStringInfoChar(&glob, '?');
+				break;
+			case '\\':
+				/* escaped character, taken literally */
+				Assert(p[1] != '\0');
+				p++;
+				/* FALLTHROUGH */
+			default:
+				if (*p == '*' || *p == '?' || *p == '[')
+					appendStringInfo(&glob, "[%c]", *p);
+				else
+					appendStringInfoChar(&glob, *p);
+				break;
+		}
+	}
+
+	deparseStringLiteral(buf, glob.data);
+	pfree(glob.data);
+}
+
+/*
+ * Construct the name of the column identified by varno/varattno.
+ */
+static void
+deparseColumnRef(StringInfo buf, Index varno, AttrNumber varattno,
+				 PlannerInfo *root)
+{
+	RangeTblEntry *rte = planner_rt_fetch(varno, root);
+
+	deparseColumnName(buf, rte->relid, varattno);
+}
+
+/*
+ * Append the SQLite name of a column of the given foreign table.
+ */
+static void
+deparseColumnName(StringInfo buf, Oid relid, AttrNumber attnum)
+{
+	appendStringInfoString(buf,
+						   quote_sqlite_identifier(simpleGetColumnName(relid, attnum)));
+}
+
+/*
+ * Get the SQLite name of a column of the given foreign table: its
+ * column_name option, or else its own name.
+ */
+char *
+simpleGetColumnName(Oid relid, AttrNumber attnum)
+{
+	ListCell   *lc;
+
+	foreach(lc, GetForeignColumnOptions(relid, attnum))
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "column_name") == 0)
+			return defGetString(def);
+	}
+
+#if (PG_VERSION_NUM >= 110000)
+	return get_attname(relid, attnum, false);
+#else
+	return get_relid_attribute_name(relid, attnum);
+#endif
+}
+
+/*
+ * Append a SQL string literal representing "val" to buf.
+ */
+static void
+deparseStringLiteral(StringInfo buf, const char *val)
+{
+	const char *valptr;
+
+	appendStringInfoChar(buf, '\'');
+	for (valptr = val; *valptr; valptr++)
+	{
+		char		ch = *valptr;
+
+		if (ch == '\'')
+			appendStringInfoChar(buf, ch);
+		appendStringInfoChar(buf, ch);
+	}
+	appendStringInfoChar(buf, '\'');
+}
+
+/*
+ * Returns true if the column was declared as a key column of the SQLite
+ * table, with the key option.
+ */
+bool
+simpleIsKeyColumn(Oid relid, AttrNumber attnum)
+{
+	ListCell   *lc;
+
+	foreach(lc, GetForeignColumnOptions(relid, attnum))
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "key") == 0)
+			return defGetBoolean(def);
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if the SQLite name of a column is one of the names of the
+ * rowid.
+ */
+static bool
+is_rowid_name(const char *colname)
+{
+	return pg_strcasecmp(colname, "rowid") == 0 ||
+		pg_strcasecmp(colname, "_rowid_") == 0 ||
+		pg_strcasecmp(colname, "oid") == 0;
+}
+
+/*
+ * Quote an identifier for SQLite, for the callers outside this file.
+ */
+const char *
+simpleQuoteIdentifier(const char *ident)
+{
+	return quote_sqlite_identifier(ident);
+}
+
+/*
+ * Quote an identifier the SQLite way, doubling embedded double quotes.
+ */
+static const char *
+quote_sqlite_identifier(const char *ident)
+{
+	StringInfoData buf;
+	const char *p;
+
+	initStringInfo(&buf);
+	appendStringInfoChar(&buf, '"');
+	for (p = ident; *p; p++)
+	{
+		if (*p == '"')
+			appendStringInfoChar(&buf, '"');
+		appendStringInfoChar(&buf, *p);
+	}
+	appendStringInfoChar(&buf, '"');
+
+	return buf.data;
+}
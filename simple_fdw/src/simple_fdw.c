@@ -16,24 +16,101 @@
 
 #include "postgres.h"
 
+#if (PG_VERSION_NUM >= 90300)
+#include "access/hash.h"
+#include "access/htup_details.h"
+#endif
+#if (PG_VERSION_NUM >= 110000)
+#include "access/parallel.h"
+#endif
 #include "access/reloptions.h"
+#if (PG_VERSION_NUM >= 90600)
+#include "access/stratnum.h"
+#else
+#include "access/skey.h"
+#endif
+#include "access/sysattr.h"
+#include "access/transam.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "access/table.h"
+#endif
+#if (PG_VERSION_NUM >= 140000)
+#include "executor/execAsync.h"
+#endif
+#include "executor/executor.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#if (PG_VERSION_NUM >= 140000)
+#include "optimizer/appendinfo.h"
+#endif
+#include "optimizer/cost.h"
+#if (PG_VERSION_NUM >= 160000)
+#include "optimizer/inherit.h"
+#endif
 #include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "optimizer/tlist.h"
+#endif
+#if (PG_VERSION_NUM >= 120000)
+#include "optimizer/optimizer.h"
+#else
+#include "optimizer/var.h"
+#endif
 
 #include "funcapi.h"
+#include "catalog/pg_attribute.h"
+#include "catalog/pg_cast.h"
 #include "catalog/pg_foreign_server.h"
 #include "catalog/pg_foreign_table.h"
+#include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "commands/explain.h"
+#include "rewrite/rewriteManip.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
+#if (PG_VERSION_NUM >= 90500)
+#include "utils/ruleutils.h"
+#endif
+#include "utils/syscache.h"
+#if (PG_VERSION_NUM >= 140000)
+#include "storage/latch.h"
+#endif
+#if (PG_VERSION_NUM >= 110000)
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
+#endif
 
-#include <sqlite3.h>
+#include "simple_fdw.h"
+
+#include <math.h>
+#include <sys/stat.h>
 
 PG_MODULE_MAGIC;
 
+/* Default CPU cost to start up a foreign query. */
+#define DEFAULT_FDW_STARTUP_COST	10.0
+
+/* Default CPU cost to process 1 row (above and beyond cpu_tuple_cost). */
+#define DEFAULT_FDW_TUPLE_COST		0.01
+
+/* Default number of rows fetched from SQLite at a time. */
+#define DEFAULT_FETCH_SIZE			100
+
+/* Default number of rows inserted by a single INSERT statement */
+#define DEFAULT_BATCH_SIZE			1
+
+/* Number of rows assumed when SQLite can't count them. */
+#define DEFAULT_ROW_COUNT			1000.0
+
 /*
  * SQL functions
  */
@@ -43,6 +120,15 @@ extern Datum simple_fdw_validator(PG_FUNCTION_ARGS);
 PG_FUNCTION_INFO_V1(simple_fdw_handler);
 PG_FUNCTION_INFO_V1(simple_fdw_validator);
 
+void		_PG_init(void);
+
+/* Execution states of scans and modifications, defined below */
+typedef struct simpleFdwExecutionState SimpleFdwExecutionState;
+#if (PG_VERSION_NUM >= 140000)
+typedef struct SimpleFdwModifyState SimpleFdwModifyState;
+#endif
+typedef struct SimpleBatchQual SimpleBatchQual;
+
 /*
  * Callback functions
  */
@@ -64,18 +150,202 @@ static ForeignScan *simpleGetForeignPlan(PlannerInfo *root,
 #else
 static FdwPlan *simplePlanForeignScan(Oid foreigntableid, PlannerInfo *root, RelOptInfo *baserel);
 #endif
+#if (PG_VERSION_NUM >= 120000)
+static void simpleGetForeignJoinPaths(PlannerInfo *root,
+						  RelOptInfo *joinrel,
+						  RelOptInfo *outerrel,
+						  RelOptInfo *innerrel,
+						  JoinType jointype,
+						  JoinPathExtraData *extra);
+static void simpleGetForeignUpperPaths(PlannerInfo *root,
+						   UpperRelationKind stage,
+						   RelOptInfo *input_rel,
+						   RelOptInfo *output_rel,
+						   void *extra);
+#endif
+static bool simpleModifiesServer(PlannerInfo *root, Oid serverid);
 
 /* Executor reading functions */
 static void simpleBeginForeignScan(ForeignScanState *node, int eflags);
 static TupleTableSlot *simpleIterateForeignScan(ForeignScanState *node);
 static void simpleReScanForeignScan(ForeignScanState *node);
 static void simpleEndForeignScan(ForeignScanState *node);
+static void simpleExplainForeignScan(ForeignScanState *node,
+						 ExplainState *es);
+static void simpleReportScanStats(ForeignScanState *node);
+static void simpleFetchBatch(ForeignScanState *node);
+static void simpleExecuteQuery(ForeignScanState *node);
+static void simpleEvalParams(ForeignScanState *node);
+static char *simpleGetResultCacheDatabase(Oid serverid);
+static void simpleGrowBatch(SimpleFdwExecutionState *festate);
+static inline void simpleDecodeValue(SimpleFdwExecutionState *festate,
+				  int x, int pos, sqlite3_value *value);
+static bool simpleMakeBatchQual(Expr *expr, Index varno,
+					SimpleBatchQual *qual);
+static Var *simpleGetBatchVar(Node *node, Index varno);
+static bool simpleIsBatchType(Oid typid);
+static bool simpleIsWideningCast(Oid source, Oid target, Oid funcid);
+static void simpleFilterBatch(SimpleFdwExecutionState *festate);
+static void simpleEvalBatchQual(SimpleFdwExecutionState *festate,
+					SimpleBatchQual *qual);
+#if (PG_VERSION_NUM >= 110000)
+static bool simpleClaimChunk(SimpleFdwExecutionState *festate);
+#endif
+
+/* Parallel scan functions */
+#if (PG_VERSION_NUM >= 110000)
+static bool simpleIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
+								RangeTblEntry *rte);
+static Size simpleEstimateDSMForeignScan(ForeignScanState *node,
+							 ParallelContext *pcxt);
+static void simpleInitializeDSMForeignScan(ForeignScanState *node,
+							   ParallelContext *pcxt,
+							   void *coordinate);
+static void simpleReInitializeDSMForeignScan(ForeignScanState *node,
+								 ParallelContext *pcxt,
+								 void *coordinate);
+static void simpleInitializeWorkerForeignScan(ForeignScanState *node,
+								  shm_toc *toc,
+								  void *coordinate);
+static void simpleAddPartialPath(PlannerInfo *root, RelOptInfo *baserel);
+static bool simpleHasRowid(sqlite3 *db, const char *table);
+#endif
+
+/* Executor writing functions */
+#if (PG_VERSION_NUM >= 140000)
+static void simpleAddForeignUpdateTargets(PlannerInfo *root,
+							  Index rtindex,
+							  RangeTblEntry *target_rte,
+							  Relation target_relation);
+static List *simplePlanForeignModify(PlannerInfo *root,
+						ModifyTable *plan,
+						Index resultRelation,
+						int subplan_index);
+static void simpleBeginForeignModify(ModifyTableState *mtstate,
+						 ResultRelInfo *rinfo,
+						 List *fdw_private,
+						 int subplan_index,
+						 int eflags);
+static TupleTableSlot *simpleExecForeignInsert(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot);
+static TupleTableSlot **simpleExecForeignBatchInsert(EState *estate,
+							 ResultRelInfo *rinfo,
+							 TupleTableSlot **slots,
+							 TupleTableSlot **planSlots,
+							 int *numSlots);
+static int simpleGetForeignModifyBatchSize(ResultRelInfo *rinfo);
+static TupleTableSlot *simpleExecForeignUpdate(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot);
+static TupleTableSlot *simpleExecForeignDelete(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot);
+static void simpleEndForeignModify(EState *estate,
+					   ResultRelInfo *rinfo);
+static void simpleBeginForeignInsert(ModifyTableState *mtstate,
+						 ResultRelInfo *rinfo);
+static void simpleEndForeignInsert(EState *estate,
+					   ResultRelInfo *rinfo);
+static int	simpleIsForeignRelUpdatable(Relation rel);
+#endif
+
+/* Asynchronous execution functions */
+#if (PG_VERSION_NUM >= 140000)
+static bool simpleIsForeignPathAsyncCapable(ForeignPath *path);
+static void simpleForeignAsyncRequest(AsyncRequest *areq);
+static void simpleForeignAsyncConfigureWait(AsyncRequest *areq);
+static void simpleForeignAsyncNotify(AsyncRequest *areq);
+static void simpleProduceTupleAsync(AsyncRequest *areq);
+static bool simpleTakeAsyncBatch(ForeignScanState *node);
+#endif
+
+/* Import functions */
+#if (PG_VERSION_NUM >= 90500)
+static List *simpleImportForeignSchema(ImportForeignSchemaStmt *stmt,
+						  Oid serverOid);
+static const char *simpleImportType(const char *decltype);
+#endif
+
+/* Analyze functions */
+#if (PG_VERSION_NUM >= 90200)
+static bool simpleAnalyzeForeignTable(Relation relation,
+						  AcquireSampleRowsFunc *func,
+						  BlockNumber *totalpages);
+static int simpleAcquireSampleRowsFunc(Relation relation, int elevel,
+							HeapTuple *rows, int targrows,
+							double *totalrows,
+							double *totaldeadrows);
+#endif
 
 /*
  * Helper functions
  */
 static bool simpleIsValidOption(const char *option, Oid context);
 static void simpleGetOptions(Oid foreigntableid, char **database, char **table);
+static bool simpleIsQuery(const char *table);
+static void simpleRowidToItemPointer(int64 rowid, ItemPointer tid);
+#if (PG_VERSION_NUM >= 140000)
+static int64 simpleItemPointerGetRowid(ItemPointer tid);
+static int	simpleGetBatchSize(Relation rel);
+static SimpleFdwModifyState *simpleCreateModifyState(EState *estate,
+						Relation rel,
+						CmdType operation,
+						List *fdw_private);
+static List *simpleGetInsertAttrs(Relation rel);
+static TupleTableSlot **simpleExecuteModify(ResultRelInfo *rinfo,
+					CmdType operation,
+					TupleTableSlot **slots,
+					TupleTableSlot **planSlots,
+					int *numSlots);
+#endif
+static double simpleEstimateQuery(sqlite3 *db, const char *database,
+					const char *query, Cost *startup_cost,
+					Cost *run_cost);
+static double simpleGetRowCount(sqlite3 *db, const char *database,
+				  const char *table);
+static List *simpleGetIndexes(sqlite3 *db, const char *table,
+				 List **notnull_columns);
+static List *simpleGetUsefulPathkeys(PlannerInfo *root, RelOptInfo *rel);
+static void simpleEstimatePathCost(PlannerInfo *root, RelOptInfo *baserel,
+					   List *remote_conds, List *local_conds,
+					   double rows,
+					   Cost *startup_cost, Cost *total_cost);
+#if (PG_VERSION_NUM >= 90500)
+static void simpleAddParamPaths(PlannerInfo *root, RelOptInfo *baserel);
+static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
+						  EquivalenceClass *ec, EquivalenceMember *em,
+						  void *arg);
+#endif
+static Path *simpleCreateForeignScanPath(PlannerInfo *root, RelOptInfo *rel,
+							double rows, Cost startup_cost, Cost total_cost,
+							List *pathkeys, Relids required_outer,
+							List *fdw_private);
+#if (PG_VERSION_NUM >= 120000)
+static bool simpleJoinIsPushable(PlannerInfo *root, RelOptInfo *joinrel,
+					 JoinType jointype, RelOptInfo *outerrel,
+					 RelOptInfo *innerrel, JoinPathExtraData *extra,
+					 SimpleFdwPlanState *fpinfo);
+static void simpleEstimateJoinCost(PlannerInfo *root,
+					   SimpleFdwPlanState *fpinfo);
+static ForeignScan *simpleGetForeignJoinPlan(PlannerInfo *root,
+						 RelOptInfo *joinrel,
+						 List *tlist);
+static void simpleAddGroupingPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					   RelOptInfo *grouped_rel, GroupPathExtraData *extra);
+static bool simpleGroupingIsPushable(PlannerInfo *root, RelOptInfo *input_rel,
+						 RelOptInfo *grouped_rel, List **tlist);
+static ForeignScan *simpleGetForeignGroupPlan(PlannerInfo *root,
+						  RelOptInfo *grouped_rel,
+						  List *tlist);
+static void simpleAddOrderedPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					  RelOptInfo *ordered_rel);
+static void simpleAddFinalPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					RelOptInfo *final_rel, FinalPathExtraData *extra);
+#endif
 
 /* 
  * structures used by the FDW 
@@ -99,32 +369,344 @@ static struct simpleFdwOption valid_options[] =
 	/* Connection options */
 	{ "database",  ForeignServerRelationId },
 
+	/* Cost options */
+	{ "fdw_startup_cost", ForeignServerRelationId },
+	{ "fdw_tuple_cost",   ForeignServerRelationId },
+
+	/* Fetch options, the table's overrides the server's */
+	{ "fetch_size",       ForeignServerRelationId },
+	{ "fetch_size",       ForeignTableRelationId },
+
+	/* Write options, the table's overrides the server's */
+	{ "batch_size",       ForeignServerRelationId },
+	{ "batch_size",       ForeignTableRelationId },
+
+	/* Relax SQLite's durability during COPY FROM */
+	{ "fast_bulk_load",   ForeignServerRelationId },
+
+	/* Open mode and cache options, applied once per connection */
+	{ "readonly",         ForeignServerRelationId },
+	{ "immutable",        ForeignServerRelationId },
+	{ "mmap_size",        ForeignServerRelationId },
+	{ "cache_size",       ForeignServerRelationId },
+	{ "temp_store",       ForeignServerRelationId },
+	{ "result_cache",     ForeignServerRelationId },
+	{ "busy_timeout",     ForeignServerRelationId },
+
+	/* Asynchronous execution options, the table's overrides the server's */
+	{ "async_capable",    ForeignServerRelationId },
+	{ "async_capable",    ForeignTableRelationId },
+
 	/* Table options */
 	{ "table",     ForeignTableRelationId },
+	{ "query",     ForeignTableRelationId },
+
+	/* Column options */
+	{ "column_name",      AttributeRelationId },
+	{ "key",              AttributeRelationId },
 
 	/* Sentinel */
 	{ NULL,			InvalidOid }
 };
 
+#if (PG_VERSION_NUM >= 110000)
 /*
- * This is what will be set and stashed away in fdw_private and fetched
- * for subsequent routines.
+ * Shared state of a parallel scan, in dynamic shared memory: the rowids
+ * of the table are split into chunks, which the participants claim one
+ * after the other.
  */
-typedef struct
+typedef struct SimpleParallelScanState
+{
+	slock_t		mutex;			/* protects the fields below */
+	int64		min_rowid;		/* first rowid of the table */
+	int64		max_rowid;		/* last rowid of the table */
+	int64		next_rowid;		/* start of the next chunk to claim */
+	int64		chunk_size;		/* number of rowids in a chunk */
+	bool		exhausted;		/* have all the chunks been claimed? */
+} SimpleParallelScanState;
+
+/* Smallest number of rowids claimed at a time by a participant */
+#define SIMPLE_PARALLEL_MIN_CHUNK	1024
+#endif
+
+/*
+ * A local qual checked over whole batches of rows, before any tuple is
+ * formed from them: the comparison of an integer or floating point column,
+ * possibly cast to a wider type, with a constant.  The comparison passes
+ * if its result, as given by the SIMPLE_CMP_* bits, is in cmpmask.
+ */
+#define SIMPLE_CMP_LT	0x01
+#define SIMPLE_CMP_EQ	0x02
+#define SIMPLE_CMP_GT	0x04
+
+struct SimpleBatchQual
 {
-	char	   *foo;
-	int			bar;
-}	SimpleFdwPlanState;
+	AttrNumber	attnum;			/* column compared */
+	Oid			coltype;		/* type of the column */
+	Oid			cmptype;		/* compared as INT8OID, FLOAT4OID or FLOAT8OID */
+	int			cmpmask;		/* comparison results passing the qual */
+	int64		ival;			/* the constant, compared as an integer */
+	double		fval;			/* the constant, compared as a float */
+	int			column;			/* index of the column in the result */
+};
 
 /*
  * FDW-specific information for ForeignScanState.fdw_state.
  */
-typedef struct simpleFdwExecutionState
+struct simpleFdwExecutionState
 {
+	Oid            serverid;
 	sqlite3       *conn;
 	sqlite3_stmt  *result;
 	char          *query;
-} SimpleFdwExecutionState;
+	List          *retrieved_attrs;	/* attr numbers of the result columns */
+
+	/* Conversion metadata, computed once per scan */
+	AttInMetadata *attinmeta;	/* input functions, typmods of the attributes */
+	int            ncolumns;	/* number of columns in the result */
+	int           *colmap;		/* attribute index of each result column,
+								 * or -1 for the rowid */
+	Oid           *coltypes;	/* type of each result column */
+
+	/*
+	 * Prefetch buffer: up to fetch_size rows are fetched from SQLite at a
+	 * time, and kept column by column, the value of row r of result
+	 * column x being at batch_values[x * fetch_size + r].  The scan of a
+	 * table being updated or deleted from fetches all its rows at once,
+	 * growing the buffer as needed, as SQLite doesn't define what a query
+	 * returns once its table is modified.
+	 */
+	int            fetch_size;	/* number of rows to fetch at a time */
+	bool           fetch_all;	/* fetch all the rows in one batch? */
+	Datum         *batch_values;
+	bool          *batch_nulls;
+	int            batch_rows;	/* number of rows in the batch */
+	int            next_row;	/* index of the next row to return, among
+								 * the batch_nsel selected ones */
+	bool           eof_reached;	/* has SQLite returned all the rows? */
+
+	/*
+	 * Batch filter: the batch quals are checked over all the rows of a
+	 * batch once it is fetched, and only the rows passing them are
+	 * returned, batch_sel holding their indexes.  Without batch quals,
+	 * batch_sel is NULL and all the rows are returned.
+	 */
+	SimpleBatchQual *batch_quals;
+	int            nbatch_quals;
+	int           *batch_sel;
+	int            batch_nsel;	/* number of rows of the batch to return */
+	bool          *batch_keep;	/* does each row pass the quals so far? */
+	int64         *batch_ints;	/* column being checked, as integers */
+	double        *batch_floats;	/* column being checked, as floats */
+	int64          rows_filtered;	/* rows removed by the batch quals */
+
+	/* Short-lived context holding the data of the current batch */
+	MemoryContext  temp_cxt;
+
+#if (PG_VERSION_NUM >= 140000)
+	/*
+	 * Asynchronous scan: the batches are fetched in the background, by a
+	 * fetcher thread.  NULL for a synchronous scan, or if the thread could
+	 * not be started, in which case the rows are fetched synchronously.
+	 */
+	SimpleAsyncFetcher *fetcher;
+#endif
+
+#if (PG_VERSION_NUM >= 110000)
+	/*
+	 * Parallel scan: the query has a rowid range condition, whose bounds
+	 * are set for each chunk claimed from the shared state.  Without
+	 * shared state, as when the plan runs without workers, the range
+	 * covers the whole table.
+	 */
+	bool           parallel;	/* is this a parallel-aware scan? */
+	SimpleParallelScanState *pscan;	/* shared state, or NULL */
+	bool           chunk_bound;	/* has a rowid range been bound? */
+	bool           whole_range_done;	/* used when pscan is NULL */
+#endif
+
+	/* Query parameters */
+	int            numParams;	/* number of parameters passed to query */
+	List          *param_exprs;	/* executable expressions for param values */
+	Oid           *param_types;	/* types of the parameters */
+	Datum         *param_values;	/* their current values, in temp_cxt */
+	bool          *param_nulls;
+	bool           params_evaluated;	/* have the values been evaluated? */
+	bool           params_bound;	/* have the current values been bound? */
+
+	/* Result cache state, see cache.c; NULL if the result is not cached */
+	SimpleCacheScan *cache;
+
+	/* Metrics shown by EXPLAIN ANALYZE, and added to the statistics */
+	bool           track_timing;	/* measure the time spent fetching? */
+	int64          rows_fetched;	/* rows returned by SQLite */
+	instr_time     step_time;	/* time spent in sqlite3_step */
+	instr_time     convert_time;	/* time spent converting the values */
+
+	/* Statistics of the scan, see stats.c */
+	bool           track_stats;	/* report them at the end of the scan? */
+	SimpleStatsCounters stats;
+};
+
+#if (PG_VERSION_NUM >= 140000)
+/*
+ * Execution state of a foreign insert/update/delete operation.
+ */
+struct SimpleFdwModifyState
+{
+	Oid            serverid;
+	sqlite3       *conn;
+	Relation       rel;			/* relcache entry for the foreign table */
+
+	/* The query and its parameters, as built by simplePlanForeignModify */
+	char          *query;		/* statement for a single row */
+	List          *target_attrs;	/* list of target attribute numbers */
+	int            values_end;	/* length up to the end of VALUES */
+	int            p_nums;		/* number of parameters of a row */
+	AttrNumber     ctidAttno;	/* attnum of the ctid junk column */
+	List          *key_attrs;	/* key attribute numbers, NIL for the rowid */
+	AttrNumber    *keyAttnos;	/* attnums of the key junk columns */
+
+	/* Batched inserts */
+	int            batch_size;	/* maximum number of rows inserted at once */
+
+	/* The statement in use, from the connection's cache */
+	sqlite3_stmt  *stmt;
+	int            stmt_rows;	/* number of rows inserted by stmt */
+
+	/* Working memory context, reset after each row or batch */
+	MemoryContext  temp_cxt;
+};
+#endif
+
+#if (PG_VERSION_NUM >= 140000)
+#define IS_ASYNC_SCAN(festate)	((festate)->fetcher != NULL)
+#else
+#define IS_ASYNC_SCAN(festate)	false
+#endif
+
+/*
+ * Backend-local cache of the row counts computed with COUNT(*), so that
+ * we only have to do it once per table as long as the file doesn't change.
+ * In WAL mode, the changes go to the -wal file until a checkpoint, so its
+ * modification time and size count too.  Table names can be long quoted
+ * identifiers, so the key holds a hash of the name, and the entry the full
+ * name: an entry whose name differs is replaced.
+ */
+typedef struct simpleRowCountKey
+{
+	char		database[MAXPGPATH];
+	uint32		table_hash;		/* hash of the table name */
+} SimpleRowCountKey;
+
+typedef struct simpleRowCountEntry
+{
+	SimpleRowCountKey key;		/* hash key (must be first) */
+	char	   *table;			/* table name, in CacheMemoryContext */
+	time_t		mtime;			/* modification time of the file */
+	off_t		size;			/* size of the file */
+	time_t		wal_mtime;		/* same for the -wal file, 0 if none */
+	off_t		wal_size;
+	double		rows;
+} SimpleRowCountEntry;
+
+static HTAB *RowCountHash = NULL;
+
+/*
+ * Callback argument for ec_member_matches_foreign
+ */
+typedef struct
+{
+	Expr	   *current;		/* current expr, or NULL if not yet found */
+	List	   *already_used;	/* expressions already dealt with */
+	Oid			relid;			/* OID of the foreign table */
+} ec_member_foreign_arg;
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	DefineCustomIntVariable("simple_fdw.statement_cache_size",
+							"Maximum number of prepared statements kept for each SQLite connection.",
+							NULL,
+							&simple_statement_cache_size,
+							32,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("simple_fdw.stats_max",
+							"Maximum number of foreign tables whose statistics are kept.",
+							NULL,
+							&simple_stats_max,
+							1000,
+							100,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("simple_fdw.track_timing",
+							 "Collects the time spent fetching and converting rows in the statistics.",
+							 NULL,
+							 &simple_stats_track_timing,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("simple_fdw.result_cache_size",
+							"Size of the shared cache of the results of queries on immutable databases.",
+							"0 disables the cache.",
+							&simple_result_cache_size,
+							0,
+							0,
+							MAX_KILOBYTES,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("simple_fdw.result_cache_entries",
+							"Maximum number of results kept in the result cache.",
+							NULL,
+							&simple_result_cache_entries,
+							1000,
+							10,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("simple_fdw.result_cache_max_entry",
+							"Largest result stored in the result cache.",
+							"0 stops storing results.",
+							&simple_result_cache_max_entry,
+							1024,
+							0,
+							MAX_KILOBYTES,
+							PGC_SUSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	simpleStatsInit();
+	simpleCacheInit();
+}
 
 Datum
 simple_fdw_handler(PG_FUNCTION_ARGS)
@@ -140,11 +722,49 @@ simple_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->GetForeignPlan = simpleGetForeignPlan;
 #else
 	fdwroutine->PlanForeignScan = simplePlanForeignScan;
+#endif
+#if (PG_VERSION_NUM >= 120000)
+	fdwroutine->GetForeignJoinPaths = simpleGetForeignJoinPaths;
+	fdwroutine->GetForeignUpperPaths = simpleGetForeignUpperPaths;
 #endif
 	fdwroutine->BeginForeignScan = simpleBeginForeignScan;
 	fdwroutine->IterateForeignScan = simpleIterateForeignScan;
 	fdwroutine->ReScanForeignScan = simpleReScanForeignScan;
 	fdwroutine->EndForeignScan = simpleEndForeignScan;
+	fdwroutine->ExplainForeignScan = simpleExplainForeignScan;
+#if (PG_VERSION_NUM >= 90200)
+	fdwroutine->AnalyzeForeignTable = simpleAnalyzeForeignTable;
+#endif
+#if (PG_VERSION_NUM >= 90500)
+	fdwroutine->ImportForeignSchema = simpleImportForeignSchema;
+#endif
+#if (PG_VERSION_NUM >= 110000)
+	fdwroutine->IsForeignScanParallelSafe = simpleIsForeignScanParallelSafe;
+	fdwroutine->EstimateDSMForeignScan = simpleEstimateDSMForeignScan;
+	fdwroutine->InitializeDSMForeignScan = simpleInitializeDSMForeignScan;
+	fdwroutine->ReInitializeDSMForeignScan = simpleReInitializeDSMForeignScan;
+	fdwroutine->InitializeWorkerForeignScan = simpleInitializeWorkerForeignScan;
+#endif
+#if (PG_VERSION_NUM >= 140000)
+	fdwroutine->AddForeignUpdateTargets = simpleAddForeignUpdateTargets;
+	fdwroutine->PlanForeignModify = simplePlanForeignModify;
+	fdwroutine->BeginForeignModify = simpleBeginForeignModify;
+	fdwroutine->ExecForeignInsert = simpleExecForeignInsert;
+	fdwroutine->ExecForeignBatchInsert = simpleExecForeignBatchInsert;
+	fdwroutine->GetForeignModifyBatchSize = simpleGetForeignModifyBatchSize;
+	fdwroutine->ExecForeignUpdate = simpleExecForeignUpdate;
+	fdwroutine->ExecForeignDelete = simpleExecForeignDelete;
+	fdwroutine->EndForeignModify = simpleEndForeignModify;
+	fdwroutine->BeginForeignInsert = simpleBeginForeignInsert;
+	fdwroutine->EndForeignInsert = simpleEndForeignInsert;
+	fdwroutine->IsForeignRelUpdatable = simpleIsForeignRelUpdatable;
+#endif
+#if (PG_VERSION_NUM >= 140000)
+	fdwroutine->IsForeignPathAsyncCapable = simpleIsForeignPathAsyncCapable;
+	fdwroutine->ForeignAsyncRequest = simpleForeignAsyncRequest;
+	fdwroutine->ForeignAsyncConfigureWait = simpleForeignAsyncConfigureWait;
+	fdwroutine->ForeignAsyncNotify = simpleForeignAsyncNotify;
+#endif
 
 	PG_RETURN_POINTER(fdwroutine);
 }
@@ -157,6 +777,9 @@ simple_fdw_validator(PG_FUNCTION_ARGS)
 	ListCell  *cell;
 	char      *simple_database = NULL;
 	char      *simple_table = NULL;
+	char      *simple_query = NULL;
+	bool       immutable = false;
+	bool       result_cache = false;
 
 	elog(DEBUG1,"entering function %s",__func__);
 
@@ -212,8 +835,131 @@ simple_fdw_validator(PG_FUNCTION_ARGS)
 
 			simple_table = defGetString(def);
 		}
+		else if (strcmp(def->defname, "query") == 0)
+		{
+			if (simple_query)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("redundant options: query (%s)", defGetString(def))
+					));
+
+			simple_query = defGetString(def);
+		}
+		else if (strcmp(def->defname, "fdw_startup_cost") == 0 ||
+				 strcmp(def->defname, "fdw_tuple_cost") == 0)
+		{
+			char	   *value = defGetString(def);
+			char	   *endptr;
+			double		val;
+
+			val = strtod(value, &endptr);
+			if (endptr == value || *endptr != '\0' || val < 0)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("%s requires a non-negative numeric value",
+						   def->defname)
+					));
+		}
+		else if (strcmp(def->defname, "fetch_size") == 0 ||
+				 strcmp(def->defname, "batch_size") == 0)
+		{
+			char	   *value = defGetString(def);
+			char	   *endptr;
+			long		val;
+
+			errno = 0;
+			val = strtol(value, &endptr, 10);
+			if (endptr == value || *endptr != '\0' || errno != 0 ||
+				val <= 0 || val > INT_MAX)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("%s requires a positive integer value",
+						   def->defname)
+					));
+		}
+		else if (strcmp(def->defname, "async_capable") == 0 ||
+				 strcmp(def->defname, "fast_bulk_load") == 0 ||
+				 strcmp(def->defname, "readonly") == 0 ||
+				 strcmp(def->defname, "immutable") == 0 ||
+				 strcmp(def->defname, "result_cache") == 0 ||
+				 strcmp(def->defname, "key") == 0)
+		{
+			/* this accepts only valid boolean values */
+			bool		val = defGetBoolean(def);
+
+			if (strcmp(def->defname, "immutable") == 0)
+				immutable = val;
+			else if (strcmp(def->defname, "result_cache") == 0)
+				result_cache = val;
+		}
+		else if (strcmp(def->defname, "mmap_size") == 0 ||
+				 strcmp(def->defname, "cache_size") == 0)
+		{
+			/* These are sent as is in a PRAGMA, they must be integers */
+			char	   *value = defGetString(def);
+			char	   *endptr;
+			long long	val;
+
+			errno = 0;
+			val = strtoll(value, &endptr, 10);
+			if (endptr == value || *endptr != '\0' || errno != 0 ||
+				(val < 0 && strcmp(def->defname, "mmap_size") == 0))
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("%s requires an integer value",
+						   def->defname)
+					));
+		}
+		else if (strcmp(def->defname, "busy_timeout") == 0)
+		{
+			char	   *value = defGetString(def);
+			char	   *endptr;
+			long		val;
+
+			errno = 0;
+			val = strtol(value, &endptr, 10);
+			if (endptr == value || *endptr != '\0' || errno != 0 ||
+				val < 0 || val > INT_MAX)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("busy_timeout requires a non-negative integer value")
+					));
+		}
+		else if (strcmp(def->defname, "column_name") == 0)
+		{
+			if (*defGetString(def) == '\0')
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("column_name requires a non-empty value")
+					));
+		}
+		else if (strcmp(def->defname, "temp_store") == 0)
+		{
+			char	   *value = defGetString(def);
+
+			if (pg_strcasecmp(value, "default") != 0 &&
+				pg_strcasecmp(value, "file") != 0 &&
+				pg_strcasecmp(value, "memory") != 0)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("temp_store must be one of default, file or memory")
+					));
+		}
 	}
 
+	if (simple_table && simple_query)
+		ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			errmsg("conflicting options: table and query can't be used together")
+			));
+
+	/* Results can only be cached when the database can't change */
+	if (result_cache && !immutable)
+		ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			errmsg("result_cache requires the immutable option")
+			));
+
 	PG_RETURN_VOID();
 }
 
@@ -235,218 +981,4503 @@ simpleIsValidOption(const char *option, Oid context)
 }
 
 /*
- * Fetch the options for a simple_fdw foreign table.
+ * Estimate the number of rows returned by a query, and the cost of running
+ * it, from its EXPLAIN QUERY PLAN.
+ *
+ * SQLite doesn't give row estimates, so this is a rough one: each loop of
+ * the plan that scans a table reads all its rows, each one that searches an
+ * index reads a few rows for each row of the outer loops, or a single one
+ * for a rowid or primary key lookup.  A temporary B-tree, for a sort, a
+ * GROUP BY or a DISTINCT, has to be built before the first row is returned.
  */
-static void
-simpleGetOptions(Oid foreigntableid, char **database, char **table)
+static double
+simpleEstimateQuery(sqlite3 *db, const char *database, const char *query,
+					Cost *startup_cost, Cost *run_cost)
 {
-	ForeignTable   *f_table;
-	ForeignServer  *f_server;
-	List           *options;
-	ListCell       *lc;
+	sqlite3_stmt *stmt;
+	char	   *explain = psprintf("EXPLAIN QUERY PLAN SELECT * FROM %s", query);
+	double		rows = 1;
+	double		rows_read = 0;
+	bool		sort = false;
 
-	/*
-	 * Extract options from FDW objects.
-	 */
-	f_table = GetForeignTable(foreigntableid);
-	f_server = GetForeignServer(f_table->serverid);
+	if (sqlite3_prepare_v2(db, explain, -1, &stmt, NULL) != SQLITE_OK)
+	{
+		char	   *err = pstrdup(sqlite3_errmsg(db));
 
-	options = NIL;
-	options = list_concat(options, f_table->options);
-	options = list_concat(options, f_server->options);
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("SQL error during prepare: %s", err),
+			errcontext("SQL query: %s", query)
+			));
+	}
 
-	/* Loop through the options */
-	foreach(lc, options)
+	/* The detail is the fourth column, whatever the SQLite version */
+	while (sqlite3_step(stmt) == SQLITE_ROW)
 	{
-		DefElem *def = (DefElem *) lfirst(lc);
+		const char *detail = (const char *) sqlite3_column_text(stmt, 3);
+		bool		search;
+		char	   *name;
+		char	   *end;
 
-		if (strcmp(def->defname, "database") == 0)
-			*database = defGetString(def);
+		if (detail == NULL)
+			continue;
 
-		if (strcmp(def->defname, "table") == 0)
-			*table = defGetString(def);
-	}
+		if (strncmp(detail, "USE TEMP B-TREE", 15) == 0)
+		{
+			sort = true;
+			continue;
+		}
 
-	/* Check we have the options we need to proceed */
-	if (!*database && !*table)
-		ereport(ERROR,
-			(errcode(ERRCODE_SYNTAX_ERROR),
-			errmsg("a database and a table must be specified")
-			));
-}
+		if (strncmp(detail, "SCAN ", 5) == 0)
+			search = false;
+		else if (strncmp(detail, "SEARCH ", 7) == 0)
+			search = true;
+		else
+			continue;
 
-static void
-simpleGetForeignRelSize(PlannerInfo *root,
-						   RelOptInfo *baserel,
-						   Oid foreigntableid)
-{
-	SimpleFdwPlanState *fdw_private;
+		/* Older versions say "SCAN TABLE t", newer ones "SCAN t" */
+		name = pstrdup(detail + (search ? 7 : 5));
+		if (strncmp(name, "TABLE ", 6) == 0)
+			name += 6;
+		end = strchr(name, ' ');
+		if (end)
+			*end = '\0';
 
-	elog(DEBUG1,"entering function %s",__func__);
+		/* Subqueries, CTEs and constant rows are made of the other loops */
+		if (strcmp(name, "SUBQUERY") == 0 || strcmp(name, "CONSTANT") == 0)
+			continue;
 
-	baserel->rows = 0;
+		if (!search)
+			rows *= Max(simpleGetRowCount(db, database, name), 1);
+		else if (strstr(detail, "PRIMARY KEY") == NULL)
+			rows *= 10;
+		rows_read += rows;
+	}
+	sqlite3_finalize(stmt);
+	pfree(explain);
 
-	fdw_private = palloc0(sizeof(SimpleFdwPlanState));
-	baserel->fdw_private = (void *) fdw_private;
+	rows = clamp_row_est(rows);
+
+	*startup_cost = 0;
+	*run_cost = cpu_operator_cost * rows_read;
+	if (sort)
+	{
+		*startup_cost = *run_cost +
+			2.0 * cpu_operator_cost * rows * log2(Max(rows, 2));
+		*run_cost = 0;
+	}
+
+	return rows;
 }
 
-static void
-simpleGetForeignPaths(PlannerInfo *root,
-						 RelOptInfo *baserel,
-						 Oid foreigntableid)
+/*
+ * Get the number of rows of a SQLite table.
+ *
+ * We use the row count stored by SQLite's ANALYZE in sqlite_stat1 when it
+ * is there, since it is cheap to read.  Otherwise we fall back to a
+ * COUNT(*), whose result is cached until the database file, or its -wal
+ * file, changes.  If SQLite can't count the rows, e.g. because a writer
+ * keeps the database busy, nothing is cached and a default is returned.
+ * The rows of a query are estimated from its plan instead.
+ */
+static double
+simpleGetRowCount(sqlite3 *db, const char *database, const char *table)
 {
-	Cost		startup_cost,
-				total_cost;
+	sqlite3_stmt       *stmt;
+	SimpleRowCountKey   key;
+	SimpleRowCountEntry *entry;
+	struct stat         st;
+	struct stat         wal_st;
+	bool                found;
+	double              rows = -1;
+	char               *query;
+	char               *wal;
 
-	elog(DEBUG1,"entering function %s",__func__);
+	if (simpleIsQuery(table))
+	{
+		Cost		startup_cost;
+		Cost		run_cost;
 
-	startup_cost = 0;
-	total_cost = startup_cost + baserel->rows;
+		return simpleEstimateQuery(db, database, table,
+								   &startup_cost, &run_cost);
+	}
 
-	add_path(baserel, (Path *)
-			 create_foreignscan_path(root, baserel,
-									 baserel->rows,
-									 startup_cost,
-									 total_cost,
-									 NIL,		/* no pathkeys */
-									 NULL,		/* no outer rel either */
-									 NIL));		/* no fdw_private data */
-}
+	/* Try the statistics gathered by SQLite's own ANALYZE first */
+	if (sqlite3_prepare_v2(db,
+						   "SELECT stat FROM sqlite_stat1 WHERE tbl = ?1 "
+						   "ORDER BY idx IS NOT NULL LIMIT 1",
+						   -1, &stmt, NULL) == SQLITE_OK)
+	{
+		sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const char *statval = (const char *) sqlite3_column_text(stmt, 0);
 
-static ForeignScan *
-simpleGetForeignPlan(PlannerInfo *root,
-						RelOptInfo *baserel,
-						Oid foreigntableid,
-						ForeignPath *best_path,
-						List *tlist,
-						List *scan_clauses)
-{
-	Index		scan_relid = baserel->relid;
+			/* the first number of the stat column is the row count */
+			if (statval)
+				rows = strtod(statval, NULL);
+		}
+		sqlite3_finalize(stmt);
+	}
 
-	elog(DEBUG1,"entering function %s",__func__);
+	if (rows >= 0)
+		return rows;
 
-	scan_clauses = extract_actual_clauses(scan_clauses, false);
+	/* Otherwise, look for a cached COUNT(*) */
+	if (RowCountHash == NULL)
+	{
+		HASHCTL		ctl;
 
-	return make_foreignscan(tlist,
-							scan_clauses,
-							scan_relid,
-							NIL,
-							NIL);
-}
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(SimpleRowCountKey);
+		ctl.entrysize = sizeof(SimpleRowCountEntry);
+		ctl.hcxt = CacheMemoryContext;
+#if (PG_VERSION_NUM >= 90500)
+		RowCountHash = hash_create("simple_fdw row counts", 64, &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+#else
+		ctl.hash = tag_hash;
+		RowCountHash = hash_create("simple_fdw row counts", 64, &ctl,
+								   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+#endif
+	}
 
-static void
-simpleBeginForeignScan(ForeignScanState *node,
-						  int eflags)
+	MemSet(&key, 0, sizeof(key));
+	strlcpy(key.database, database, sizeof(key.database));
+	key.table_hash = DatumGetUInt32(hash_any((const unsigned char *) table,
+											 strlen(table)));
+
+	if (stat(database, &st) != 0)
+		MemSet(&st, 0, sizeof(st));
+	wal = psprintf("%s-wal", database);
+	if (stat(wal, &wal_st) != 0)
+		MemSet(&wal_st, 0, sizeof(wal_st));
+	pfree(wal);
+
+	entry = (SimpleRowCountEntry *) hash_search(RowCountHash, &key, HASH_ENTER, &found);
+	if (!found)
+		entry->table = NULL;
+	else if (strcmp(entry->table, table) == 0 &&
+			 entry->mtime == st.st_mtime && entry->size == st.st_size &&
+			 entry->wal_mtime == wal_st.st_mtime &&
+			 entry->wal_size == wal_st.st_size)
+		return entry->rows;
+
+	query = psprintf("SELECT count(*) FROM %s", table);
+	if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			rows = (double) sqlite3_column_int64(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+	pfree(query);
+
+	if (rows < 0)
+	{
+		if (entry->table)
+			pfree(entry->table);
+		hash_search(RowCountHash, &key, HASH_REMOVE, NULL);
+		return DEFAULT_ROW_COUNT;
+	}
+
+	if (entry->table == NULL || strcmp(entry->table, table) != 0)
+	{
+		if (entry->table)
+			pfree(entry->table);
+		entry->table = MemoryContextStrdup(CacheMemoryContext, table);
+	}
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	entry->wal_mtime = wal_st.st_mtime;
+	entry->wal_size = wal_st.st_size;
+	entry->rows = rows;
+
+	return rows;
+}
+
+/*
+ * Get the indexes of a SQLite table, with PRAGMA index_list and
+ * PRAGMA index_xinfo.  Partial indexes are ignored, and so are the columns
+ * of an index that come after an expression.  An INTEGER PRIMARY KEY
+ * column is reported as an index too, since it's the rowid.
+ *
+ * The names of the columns declared NOT NULL are returned in
+ * *notnull_columns.
+ */
+static List *
+simpleGetIndexes(sqlite3 *db, const char *table, List **notnull_columns)
+{
+	List	   *indexes = NIL;
+	sqlite3_stmt *stmt;
+	sqlite3_stmt *colstmt;
+	char	   *query;
+	char	   *pkcol = NULL;
+	int			npkcols = 0;
+
+	*notnull_columns = NIL;
+
+	query = psprintf("PRAGMA table_info(%s)", table);
+	if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const char *type = (const char *) sqlite3_column_text(stmt, 2);
+
+			if (sqlite3_column_int(stmt, 3) != 0)
+				*notnull_columns = lappend(*notnull_columns,
+										   makeString(pstrdup((const char *) sqlite3_column_text(stmt, 1))));
+
+			if (sqlite3_column_int(stmt, 5) == 0)
+				continue;
+
+			npkcols++;
+			if (type && pg_strcasecmp(type, "INTEGER") == 0)
+				pkcol = pstrdup((const char *) sqlite3_column_text(stmt, 1));
+		}
+		sqlite3_finalize(stmt);
+	}
+	pfree(query);
+
+	if (npkcols == 1 && pkcol != NULL)
+	{
+		SimpleIndexInfo *index = palloc0(sizeof(SimpleIndexInfo));
+
+		index->name = NULL;
+		index->unique = true;
+		index->columns = list_make1(makeString(pkcol));
+		index->descending = list_make1_int(false);
+		index->collations = list_make1(makeString("BINARY"));
+		indexes = lappend(indexes, index);
+	}
+
+	query = psprintf("PRAGMA index_list(%s)", table);
+	if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			SimpleIndexInfo *index;
+			char	   *colquery;
+
+			/* the "partial" column only exists since SQLite 3.8.9 */
+			if (sqlite3_column_count(stmt) > 4 &&
+				sqlite3_column_int(stmt, 4) != 0)
+				continue;
+
+			index = palloc0(sizeof(SimpleIndexInfo));
+			index->name = pstrdup((const char *) sqlite3_column_text(stmt, 1));
+			index->unique = sqlite3_column_int(stmt, 2) != 0;
+
+			/* columns: seqno, cid, name, desc, coll, key */
+			colquery = psprintf("PRAGMA index_xinfo(\"%s\")", index->name);
+			if (sqlite3_prepare_v2(db, colquery, -1, &colstmt, NULL) == SQLITE_OK)
+			{
+				while (sqlite3_step(colstmt) == SQLITE_ROW)
+				{
+					const char *colname = (const char *) sqlite3_column_text(colstmt, 2);
+					const char *coll = (const char *) sqlite3_column_text(colstmt, 4);
+
+					/* the auxiliary columns come after the key columns */
+					if (sqlite3_column_int(colstmt, 5) == 0)
+						break;
+
+					/* an expression, the following columns can't be used */
+					if (colname == NULL)
+						break;
+
+					index->columns = lappend(index->columns,
+											 makeString(pstrdup(colname)));
+					index->descending = lappend_int(index->descending,
+													sqlite3_column_int(colstmt, 3) != 0);
+					index->collations = lappend(index->collations,
+												makeString(pstrdup(coll ? coll : "BINARY")));
+				}
+				sqlite3_finalize(colstmt);
+			}
+			pfree(colquery);
+
+			if (index->columns != NIL)
+				indexes = lappend(indexes, index);
+		}
+		sqlite3_finalize(stmt);
+	}
+	pfree(query);
+
+	return indexes;
+}
+
+/*
+ * Estimate the cost of a scan returning "rows" rows from SQLite, given the
+ * clauses (RestrictInfos) SQLite and PostgreSQL have to check.
+ *
+ * If one of the remote clauses can use an index, SQLite only has to seek in
+ * the index and read the matching rows; otherwise it goes through the whole
+ * table.  Then every row it returns has to be converted and checked
+ * against the local quals.
+ */
+static void
+simpleEstimatePathCost(PlannerInfo *root, RelOptInfo *baserel,
+					   List *remote_conds, List *local_conds,
+					   double rows,
+					   Cost *startup_cost, Cost *total_cost)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	QualCost	local_cost;
+	bool		use_index = false;
+	Cost		run_cost;
+	ListCell   *lc;
+
+	foreach(lc, remote_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (simpleIsIndexableClause(root, baserel, rinfo->clause))
+		{
+			use_index = true;
+			break;
+		}
+	}
+
+	cost_qual_eval(&local_cost, local_conds, root);
+
+	*startup_cost = fpinfo->fdw_startup_cost + local_cost.startup +
+		fpinfo->query_startup_cost;
+	if (use_index)
+		run_cost = cpu_operator_cost * (log2(Max(fpinfo->tuples, 2)) + rows);
+	else
+		run_cost = cpu_operator_cost * fpinfo->tuples;
+	run_cost += fpinfo->query_run_cost;
+	run_cost += (fpinfo->fdw_tuple_cost + cpu_tuple_cost + local_cost.per_tuple) * rows;
+	*total_cost = *startup_cost + run_cost;
+}
+
+/*
+ * Create a ForeignPath for a base relation, hiding the differences between
+ * the versions of create_foreignscan_path.
+ */
+static Path *
+simpleCreateForeignScanPath(PlannerInfo *root, RelOptInfo *rel,
+							double rows, Cost startup_cost, Cost total_cost,
+							List *pathkeys, Relids required_outer,
+							List *fdw_private)
+{
+#if (PG_VERSION_NUM >= 90600)
+	return (Path *) create_foreignscan_path(root, rel,
+											NULL,	/* default pathtarget */
+											rows,
+											startup_cost,
+											total_cost,
+											pathkeys,
+											required_outer,
+											NULL,	/* no extra plan */
+											fdw_private);
+#elif (PG_VERSION_NUM >= 90500)
+	return (Path *) create_foreignscan_path(root, rel,
+											rows,
+											startup_cost,
+											total_cost,
+											pathkeys,
+											required_outer,
+											NULL,	/* no extra plan */
+											fdw_private);
+#else
+	return (Path *) create_foreignscan_path(root, rel,
+											rows,
+											startup_cost,
+											total_cost,
+											pathkeys,
+											required_outer,
+											fdw_private);
+#endif
+}
+
+/*
+ * Fetch the options for a simple_fdw foreign table.  The query option is
+ * returned as a parenthesized subquery in *table, which can be used
+ * wherever the queries we send have a table name in their FROM clause.
+ */
+static void
+simpleGetOptions(Oid foreigntableid, char **database, char **table)
+{
+	ForeignTable   *f_table;
+	ForeignServer  *f_server;
+	List           *options;
+	ListCell       *lc;
+
+	/*
+	 * Extract options from FDW objects.
+	 */
+	f_table = GetForeignTable(foreigntableid);
+	f_server = GetForeignServer(f_table->serverid);
+
+	options = NIL;
+	options = list_concat(options, f_table->options);
+	options = list_concat(options, f_server->options);
+
+	/* Loop through the options */
+	foreach(lc, options)
+	{
+		DefElem *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "database") == 0)
+			*database = defGetString(def);
+
+		if (strcmp(def->defname, "table") == 0)
+			*table = defGetString(def);
+
+		if (strcmp(def->defname, "query") == 0)
+			*table = psprintf("(%s)", defGetString(def));
+	}
+
+	/* Check we have the options we need to proceed */
+	if (!*database || !*table)
+		ereport(ERROR,
+			(errcode(ERRCODE_SYNTAX_ERROR),
+			errmsg("a database and a table or a query must be specified")
+			));
+}
+
+/*
+ * Returns true if the table returned by simpleGetOptions is a query.
+ */
+static bool
+simpleIsQuery(const char *table)
+{
+	return table[0] == '(';
+}
+
+static void
+simpleGetForeignRelSize(PlannerInfo *root,
+						   RelOptInfo *baserel,
+						   Oid foreigntableid)
+{
+	SimpleFdwPlanState *fdw_private;
+	ForeignServer *server;
+	Selectivity remote_sel;
+	double		tuples;
+	sqlite3    *db;
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	fdw_private = palloc0(sizeof(SimpleFdwPlanState));
+	baserel->fdw_private = (void *) fdw_private;
+
+	/* Fetch options  */
+	simpleGetOptions(foreigntableid, &fdw_private->database, &fdw_private->table);
+
+	fdw_private->fdw_startup_cost = DEFAULT_FDW_STARTUP_COST;
+	fdw_private->fdw_tuple_cost = DEFAULT_FDW_TUPLE_COST;
+	fdw_private->fetch_size = DEFAULT_FETCH_SIZE;
+
+	server = GetForeignServer(GetForeignTable(foreigntableid)->serverid);
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "fdw_startup_cost") == 0)
+			fdw_private->fdw_startup_cost = strtod(defGetString(def), NULL);
+		else if (strcmp(def->defname, "fdw_tuple_cost") == 0)
+			fdw_private->fdw_tuple_cost = strtod(defGetString(def), NULL);
+		else if (strcmp(def->defname, "fetch_size") == 0)
+			fdw_private->fetch_size = atoi(defGetString(def));
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fdw_private->async_capable = defGetBoolean(def);
+	}
+	foreach(lc, GetForeignTable(foreigntableid)->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "fetch_size") == 0)
+			fdw_private->fetch_size = atoi(defGetString(def));
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fdw_private->async_capable = defGetBoolean(def);
+	}
+
+	/*
+	 * Identify which baserestrictinfo clauses can be sent to SQLite and
+	 * which can't.
+	 */
+	simpleClassifyConditions(root, baserel, baserel->baserestrictinfo,
+							 &fdw_private->remote_conds, &fdw_private->local_conds);
+
+	/*
+	 * Identify which attributes will need to be retrieved from SQLite:
+	 * those used in the target list, and those needed by the clauses
+	 * evaluated locally.
+	 */
+	fdw_private->attrs_used = NULL;
+#if (PG_VERSION_NUM >= 90600)
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid,
+				   &fdw_private->attrs_used);
+#else
+	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid,
+				   &fdw_private->attrs_used);
+#endif
+	foreach(lc, fdw_private->local_conds)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		pull_varattnos((Node *) rinfo->clause, baserel->relid,
+					   &fdw_private->attrs_used);
+	}
+
+	/*
+	 * Get the table size from SQLite, and let the planner compute the
+	 * number of rows and their width from it and from the selectivity of
+	 * all the restriction clauses.
+	 */
+	db = simpleGetConnection(server->serverid);
+	if (simpleIsQuery(fdw_private->table))
+		tuples = simpleEstimateQuery(db, fdw_private->database,
+									 fdw_private->table,
+									 &fdw_private->query_startup_cost,
+									 &fdw_private->query_run_cost);
+	else
+		tuples = simpleGetRowCount(db, fdw_private->database,
+								   fdw_private->table);
+	fdw_private->tuples = tuples;
+	baserel->tuples = tuples;
+	set_baserel_size_estimates(root, baserel);
+
+	/* The indexes tell which clauses SQLite can answer without a full scan */
+	fdw_private->indexes = simpleGetIndexes(db, fdw_private->table,
+											&fdw_private->notnull_columns);
+
+	/* Number of rows SQLite returns after applying the pushed-down quals */
+	remote_sel = clauselist_selectivity(root, fdw_private->remote_conds,
+										baserel->relid, JOIN_INNER, NULL);
+	fdw_private->rows = clamp_row_est(tuples * remote_sel);
+
+	simpleEstimatePathCost(root, baserel,
+						   fdw_private->remote_conds, fdw_private->local_conds,
+						   fdw_private->rows,
+						   &fdw_private->startup_cost, &fdw_private->total_cost);
+}
+
+static void
+simpleGetForeignPaths(PlannerInfo *root,
+						 RelOptInfo *baserel,
+						 Oid foreigntableid)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	add_path(baserel,
+			 simpleCreateForeignScanPath(root, baserel,
+										 baserel->rows,
+										 fpinfo->startup_cost,
+										 fpinfo->total_cost,
+										 NIL,		/* no pathkeys */
+										 NULL,		/* no outer rel either */
+										 NIL));		/* no fdw_private data */
+
+	/*
+	 * Add sorted paths for the orderings an index of the SQLite table
+	 * gives for free: SQLite then walks the index instead of the table, and
+	 * the ORDER BY is sent along with the query.
+	 */
+	foreach(lc, simpleGetUsefulPathkeys(root, baserel))
+	{
+		List	   *pathkeys = (List *) lfirst(lc);
+
+		add_path(baserel,
+				 simpleCreateForeignScanPath(root, baserel,
+											 baserel->rows,
+											 fpinfo->startup_cost,
+											 fpinfo->total_cost +
+											 cpu_operator_cost * fpinfo->rows,
+											 pathkeys,
+											 NULL,		/* no outer rel either */
+											 NIL));		/* no fdw_private data */
+	}
+
+#if (PG_VERSION_NUM >= 90500)
+	/* Then the paths using the join clauses as index lookups in SQLite */
+	simpleAddParamPaths(root, baserel);
+#endif
+
+#if (PG_VERSION_NUM >= 110000)
+	/* And a parallel scan, splitting the table by rowid ranges */
+	if (baserel->consider_parallel)
+		simpleAddPartialPath(root, baserel);
+#endif
+}
+
+#if (PG_VERSION_NUM >= 110000)
+/*
+ * Add a partial path for a parallel scan of the foreign table.  Each
+ * participant reads chunks of rowids, which only works for real tables:
+ * views, WITHOUT ROWID tables and queries are not scanned in parallel.
+ */
+static void
+simpleAddPartialPath(PlannerInfo *root, RelOptInfo *baserel)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	struct stat st;
+	double		pages;
+	int			parallel_workers;
+	double		parallel_divisor;
+	Path	   *path;
+
+	/* The number of workers depends on the size of the database file */
+	if (stat(fpinfo->database, &st) != 0)
+		return;
+	pages = (double) st.st_size / BLCKSZ;
+
+	parallel_workers = compute_parallel_worker(baserel, pages, -1,
+											   max_parallel_workers_per_gather);
+	if (parallel_workers <= 0)
+		return;
+
+	if (simpleIsQuery(fpinfo->table) ||
+		!simpleHasRowid(simpleGetConnection(baserel->serverid), fpinfo->table))
+		return;
+
+	/* Same as the division of a parallel sequential scan */
+	parallel_divisor = parallel_workers;
+	if (parallel_leader_participation)
+	{
+		double		leader_contribution = 1.0 - (0.3 * parallel_workers);
+
+		if (leader_contribution > 0)
+			parallel_divisor += leader_contribution;
+	}
+
+	path = simpleCreateForeignScanPath(root, baserel,
+									   clamp_row_est(baserel->rows / parallel_divisor),
+									   fpinfo->startup_cost,
+									   fpinfo->startup_cost +
+									   (fpinfo->total_cost - fpinfo->startup_cost) /
+									   parallel_divisor,
+									   NIL,		/* no pathkeys */
+									   NULL,	/* no outer rel either */
+									   NIL);	/* no fdw_private data */
+	path->parallel_aware = true;
+	path->parallel_safe = true;
+	path->parallel_workers = parallel_workers;
+
+	add_partial_path(baserel, path);
+}
+
+/*
+ * Returns true if the SQLite table has a rowid.
+ */
+static bool
+simpleHasRowid(sqlite3 *db, const char *table)
+{
+	sqlite3_stmt *stmt;
+	char	   *query = psprintf("SELECT rowid FROM %s", table);
+	bool		result;
+
+	result = (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK);
+	sqlite3_finalize(stmt);
+	pfree(query);
+
+	return result;
+}
+#endif
+
+/*
+ * Find the orderings of the foreign table that can be useful to the query:
+ * the one of the query's ORDER BY, and the ones that make merge joins
+ * possible.  Only those an index of the SQLite table can give are kept.
+ */
+static List *
+simpleGetUsefulPathkeys(PlannerInfo *root, RelOptInfo *rel)
+{
+	List	   *useful_pathkeys_list = NIL;
+
+	if (root->query_pathkeys != NIL &&
+		simplePathkeysUseIndex(root, rel, root->query_pathkeys))
+		useful_pathkeys_list = lappend(useful_pathkeys_list,
+									   root->query_pathkeys);
+
+#if (PG_VERSION_NUM >= 90600)
+	if (rel->has_eclass_joins)
+	{
+		ListCell   *lc;
+
+		foreach(lc, root->eq_classes)
+		{
+			EquivalenceClass *cur_ec = (EquivalenceClass *) lfirst(lc);
+			List	   *pathkeys;
+
+			/* If redundant with what we did above, skip it. */
+			if (root->query_pathkeys != NIL &&
+				cur_ec == ((PathKey *) linitial(root->query_pathkeys))->pk_eclass)
+				continue;
+
+			/* If no pushable expression for this rel, skip it. */
+			if (simpleFindEmVar(cur_ec, rel) == NULL)
+				continue;
+
+			/* If this EC is useless for merge joins, skip it. */
+			if (!eclass_useful_for_merging(root, cur_ec, rel))
+				continue;
+
+			pathkeys = list_make1(make_canonical_pathkey(root, cur_ec,
+														 linitial_oid(cur_ec->ec_opfamilies),
+														 BTLessStrategyNumber,
+														 false));
+			if (simplePathkeysUseIndex(root, rel, pathkeys))
+				useful_pathkeys_list = lappend(useful_pathkeys_list, pathkeys);
+		}
+	}
+#endif
+
+	return useful_pathkeys_list;
+}
+
+#if (PG_VERSION_NUM >= 90500)
+/*
+ * Add parameterized paths, for the join clauses that compare an indexed
+ * SQLite column with columns of other relations.  With such a path, the
+ * foreign table can be the inner side of a nested loop, SQLite doing one
+ * indexed lookup for each outer row, with the outer values bound as
+ * parameters of the query.
+ */
+static void
+simpleAddParamPaths(PlannerInfo *root, RelOptInfo *baserel)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	List	   *ppi_list = NIL;
+	ListCell   *lc;
+
+	/* Scan the extra join clauses */
+	foreach(lc, baserel->joininfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		Relids		required_outer;
+		ParamPathInfo *param_info;
+
+		/* Check if clause can be moved to this rel */
+		if (!join_clause_is_movable_to(rinfo, baserel))
+			continue;
+
+		/* See if it is safe to send to SQLite, and useful */
+		if (!simpleIsForeignExpr(root, baserel, rinfo->clause) ||
+			!simpleIsIndexableClause(root, baserel, rinfo->clause))
+			continue;
+
+		/* Calculate required outer rels for the resulting path */
+		required_outer = bms_union(rinfo->clause_relids,
+								   baserel->lateral_relids);
+		required_outer = bms_del_member(required_outer, baserel->relid);
+		if (bms_is_empty(required_outer))
+			continue;
+
+		param_info = get_baserel_parampathinfo(root, baserel, required_outer);
+		Assert(param_info != NULL);
+
+		ppi_list = list_append_unique_ptr(ppi_list, param_info);
+	}
+
+	/*
+	 * Now check whether there are any equivalence class join clauses on an
+	 * indexed column.  We repeatedly look for an indexed column that
+	 * belongs to an EC, and generate the join clauses equating it to other
+	 * members of the EC.
+	 */
+	if (baserel->has_eclass_joins)
+	{
+		ec_member_foreign_arg arg;
+
+		arg.already_used = NIL;
+		arg.relid = rte->relid;
+		for (;;)
+		{
+			List	   *clauses;
+
+			/* Make clauses, skipping any that join to lateral_referencers */
+			arg.current = NULL;
+			clauses = generate_implied_equalities_for_column(root,
+															 baserel,
+															 ec_member_matches_foreign,
+															 (void *) &arg,
+															 baserel->lateral_referencers);
+
+			/* Done if there are no more expressions in the foreign rel */
+			if (arg.current == NULL)
+			{
+				Assert(clauses == NIL);
+				break;
+			}
+
+			foreach(lc, clauses)
+			{
+				RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+				Relids		required_outer;
+				ParamPathInfo *param_info;
+
+				if (!join_clause_is_movable_to(rinfo, baserel))
+					continue;
+
+				if (!simpleIsForeignExpr(root, baserel, rinfo->clause))
+					continue;
+
+				required_outer = bms_union(rinfo->clause_relids,
+										   baserel->lateral_relids);
+				required_outer = bms_del_member(required_outer, baserel->relid);
+				if (bms_is_empty(required_outer))
+					continue;
+
+				param_info = get_baserel_parampathinfo(root, baserel,
+													   required_outer);
+				Assert(param_info != NULL);
+
+				ppi_list = list_append_unique_ptr(ppi_list, param_info);
+			}
+
+			/* Try again, now ignoring the expression we found this time */
+			arg.already_used = lappend(arg.already_used, arg.current);
+		}
+	}
+
+	/* Now build a path for each useful outer relation */
+	foreach(lc, ppi_list)
+	{
+		ParamPathInfo *param_info = (ParamPathInfo *) lfirst(lc);
+		List	   *remote_conds = list_copy(fpinfo->remote_conds);
+		List	   *local_conds = list_copy(fpinfo->local_conds);
+		double		rows;
+		Cost		startup_cost;
+		Cost		total_cost;
+		ListCell   *lc2;
+
+		foreach(lc2, param_info->ppi_clauses)
+		{
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc2);
+
+			if (simpleIsForeignExpr(root, baserel, rinfo->clause))
+				remote_conds = lappend(remote_conds, rinfo);
+			else
+				local_conds = lappend(local_conds, rinfo);
+		}
+
+		/* Rows SQLite returns for each outer row */
+		rows = clamp_row_est(fpinfo->tuples *
+							 clauselist_selectivity(root, remote_conds,
+													baserel->relid,
+													JOIN_INNER, NULL));
+
+		simpleEstimatePathCost(root, baserel, remote_conds, local_conds,
+							   rows, &startup_cost, &total_cost);
+
+		add_path(baserel,
+				 simpleCreateForeignScanPath(root, baserel,
+											 param_info->ppi_rows,
+											 startup_cost,
+											 total_cost,
+											 NIL,		/* no pathkeys */
+											 param_info->ppi_req_outer,
+											 NIL));		/* no fdw_private data */
+	}
+}
+
+/*
+ * Detect whether we want to process an EquivalenceClass member: we only
+ * want the indexed columns of the foreign table.
+ *
+ * This is a callback for use by generate_implied_equalities_for_column.
+ */
+static bool
+ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
+						  EquivalenceClass *ec, EquivalenceMember *em,
+						  void *arg)
+{
+	ec_member_foreign_arg *state = (ec_member_foreign_arg *) arg;
+	Expr	   *expr = em->em_expr;
+
+	/*
+	 * If we've identified what we're processing in the current scan, we
+	 * only want to match that expression.
+	 */
+	if (state->current != NULL)
+		return equal(expr, state->current);
+
+	/*
+	 * Otherwise, ignore anything we've already processed.
+	 */
+	if (list_member(state->already_used, expr))
+		return false;
+
+	/* Only indexed columns are worth a parameterized path */
+	if (!IsA(expr, Var) || ((Var *) expr)->varattno <= 0 ||
+		!simpleIsIndexedColumn(rel, state->relid, ((Var *) expr)->varattno))
+		return false;
+
+	/* This is the new target to process. */
+	state->current = expr;
+	return true;
+}
+#endif
+
+#if (PG_VERSION_NUM >= 120000)
+/*
+ * Add a path for a join of foreign tables of the same server, which are in
+ * the same SQLite database: the join is done by SQLite, in one query.
+ */
+static void
+simpleGetForeignJoinPaths(PlannerInfo *root,
+						  RelOptInfo *joinrel,
+						  RelOptInfo *outerrel,
+						  RelOptInfo *innerrel,
+						  JoinType jointype,
+						  JoinPathExtraData *extra)
+{
+	SimpleFdwPlanState *fpinfo;
+	Path	   *joinpath;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/*
+	 * Skip if this join combination has been considered already.  Only the
+	 * first pair of inputs that can be pushed down is used.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * Rows locked or modified need an EvalPlanQual recheck, which needs a
+	 * local plan of the join; only plain queries are sent.
+	 */
+	if (root->parse->commandType != CMD_SELECT || root->rowMarks)
+		return;
+
+	fpinfo = (SimpleFdwPlanState *) palloc0(sizeof(SimpleFdwPlanState));
+	if (!simpleJoinIsPushable(root, joinrel, jointype, outerrel, innerrel,
+							  extra, fpinfo))
+		return;
+
+	simpleEstimateJoinCost(root, fpinfo);
+	joinrel->fdw_private = fpinfo;
+
+	joinpath = (Path *) create_foreign_join_path(root,
+												 joinrel,
+												 NULL,	/* default pathtarget */
+												 fpinfo->rows,
+												 fpinfo->startup_cost,
+												 fpinfo->total_cost,
+												 NIL,	/* no pathkeys */
+												 joinrel->lateral_relids,
+												 NULL,	/* no extra plan */
+												 NIL);	/* no fdw_private */
+	add_path(joinrel, joinpath);
+}
+
+/*
+ * Check whether the join of outerrel and innerrel can be done by SQLite,
+ * and if so fill in fpinfo for the join relation.
+ *
+ * Both sides have to be sent entirely, without local conditions, and only
+ * inner and left joins are sent.  The clauses of the join are split between
+ * its ON clause, its WHERE clause and the ones checked locally, which is
+ * only possible for inner joins.
+ */
+static bool
+simpleJoinIsPushable(PlannerInfo *root, RelOptInfo *joinrel,
+					 JoinType jointype, RelOptInfo *outerrel,
+					 RelOptInfo *innerrel, JoinPathExtraData *extra,
+					 SimpleFdwPlanState *fpinfo)
+{
+	SimpleFdwPlanState *fpinfo_o = (SimpleFdwPlanState *) outerrel->fdw_private;
+	SimpleFdwPlanState *fpinfo_i = (SimpleFdwPlanState *) innerrel->fdw_private;
+	List	   *vars;
+	ListCell   *lc;
+
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT)
+		return false;
+
+	/* Both sides must be foreign scans or joins we can push down */
+	if (fpinfo_o == NULL || fpinfo_i == NULL ||
+		(outerrel->reloptkind != RELOPT_BASEREL &&
+		 outerrel->reloptkind != RELOPT_JOINREL) ||
+		(innerrel->reloptkind != RELOPT_BASEREL &&
+		 innerrel->reloptkind != RELOPT_JOINREL))
+		return false;
+
+	if (fpinfo_o->local_conds != NIL || fpinfo_i->local_conds != NIL)
+		return false;
+
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		bool		is_remote = simpleIsForeignExpr(root, joinrel, rinfo->clause);
+
+		if (IS_OUTER_JOIN(jointype) &&
+			!RINFO_IS_PUSHED_DOWN(rinfo, joinrel->relids))
+		{
+			/* The join clauses of an outer join can't be checked locally */
+			if (!is_remote)
+				return false;
+			fpinfo->joinclauses = lappend(fpinfo->joinclauses, rinfo);
+		}
+		else if (is_remote)
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+	}
+
+	/*
+	 * The scan tuples are made of the columns of the join.  Whole-row
+	 * references, system columns and placeholders have no counterpart in
+	 * the SQLite query.
+	 */
+	vars = pull_var_clause((Node *) joinrel->reltarget->exprs,
+						   PVC_INCLUDE_PLACEHOLDERS);
+	vars = list_concat(vars,
+					   pull_var_clause((Node *) extract_actual_clauses(fpinfo->local_conds, false),
+									   PVC_INCLUDE_PLACEHOLDERS));
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var) || var->varattno <= 0)
+			return false;
+	}
+
+	/*
+	 * The conditions of the sides come along.  Those of the inner side of
+	 * a left join go in its ON clause, so that they don't remove the outer
+	 * rows.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_o->remote_conds));
+		fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_i->remote_conds));
+	}
+	else
+	{
+		fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+										  list_copy(fpinfo_i->remote_conds));
+		fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										   list_copy(fpinfo_o->remote_conds));
+	}
+
+	/*
+	 * For an inner join, the conditions can go in the ON clause as well as
+	 * in the WHERE clause; use the ON clause.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		fpinfo->joinclauses = fpinfo->remote_conds;
+		fpinfo->remote_conds = NIL;
+	}
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+	fpinfo->fdw_startup_cost = fpinfo_o->fdw_startup_cost;
+	fpinfo->fdw_tuple_cost = fpinfo_o->fdw_tuple_cost;
+	fpinfo->fetch_size = Max(fpinfo_o->fetch_size, fpinfo_i->fetch_size);
+	fpinfo->rows = joinrel->rows;
+
+	return true;
+}
+
+/*
+ * Estimate the cost of a join done by SQLite.
+ *
+ * SQLite joins with nested loops, looking up the inner rows of each outer
+ * row.  When a clause compares an indexed column of the inner table, each
+ * lookup is an index seek.  Otherwise SQLite builds an automatic index on
+ * the inner rows first, which costs a sort of them.  The sides cost what
+ * their own scans cost SQLite, without transferring their rows; the row
+ * counts come from the same statistics as the scans.
+ */
+static void
+simpleEstimateJoinCost(PlannerInfo *root, SimpleFdwPlanState *fpinfo)
+{
+	SimpleFdwPlanState *fpinfo_o = (SimpleFdwPlanState *) fpinfo->outerrel->fdw_private;
+	SimpleFdwPlanState *fpinfo_i = (SimpleFdwPlanState *) fpinfo->innerrel->fdw_private;
+	Cost		transfer_cost = fpinfo->fdw_tuple_cost + cpu_tuple_cost;
+	Cost		outer_cost;
+	Cost		inner_cost;
+	Cost		run_cost;
+	bool		use_index = false;
+	QualCost	remote_cost;
+	QualCost	local_cost;
+	ListCell   *lc;
+
+	outer_cost = fpinfo_o->total_cost - fpinfo_o->startup_cost -
+		transfer_cost * fpinfo_o->rows;
+	inner_cost = fpinfo_i->total_cost - fpinfo_i->startup_cost -
+		transfer_cost * fpinfo_i->rows;
+
+	if (fpinfo->innerrel->reloptkind == RELOPT_BASEREL)
+	{
+		foreach(lc, fpinfo->joinclauses)
+		{
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+			if (simpleIsIndexableClause(root, fpinfo->innerrel, rinfo->clause))
+			{
+				use_index = true;
+				break;
+			}
+		}
+	}
+
+	if (use_index)
+		run_cost = outer_cost + cpu_operator_cost * fpinfo_o->rows *
+			log2(Max(fpinfo_i->tuples, 2));
+	else
+		run_cost = outer_cost + inner_cost +
+			cpu_operator_cost * (fpinfo_i->rows + fpinfo_o->rows) *
+			log2(Max(fpinfo_i->rows, 2));
+
+	cost_qual_eval(&remote_cost, fpinfo->joinclauses, root);
+	cost_qual_eval(&local_cost, fpinfo->local_conds, root);
+	run_cost += remote_cost.per_tuple * Max(fpinfo_o->rows, fpinfo->rows);
+
+	fpinfo->startup_cost = fpinfo->fdw_startup_cost + remote_cost.startup +
+		local_cost.startup;
+	fpinfo->total_cost = fpinfo->startup_cost + run_cost +
+		(transfer_cost + local_cost.per_tuple) * fpinfo->rows;
+}
+
+/*
+ * Create a ForeignScan plan for a join relation.  As for grouped relations,
+ * the scan tuples are described by fdw_scan_tlist: the columns of the join,
+ * and those needed by the local conditions.
+ */
+static ForeignScan *
+simpleGetForeignJoinPlan(PlannerInfo *root, RelOptInfo *joinrel,
+						 List *tlist)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) joinrel->fdw_private;
+	List	   *local_exprs;
+	List	   *fdw_scan_tlist;
+	List	   *retrieved_attrs = NIL;
+	List	   *params_list = NIL;
+	List	   *fdw_private;
+	StringInfoData sql;
+	int			fetch_size;
+	int			i;
+
+	local_exprs = extract_actual_clauses(fpinfo->local_conds, false);
+
+	fdw_scan_tlist = add_to_flat_tlist(NIL,
+									   pull_var_clause((Node *) joinrel->reltarget->exprs,
+													   PVC_RECURSE_PLACEHOLDERS));
+	fdw_scan_tlist = add_to_flat_tlist(fdw_scan_tlist,
+									   pull_var_clause((Node *) local_exprs,
+													   PVC_RECURSE_PLACEHOLDERS));
+
+	initStringInfo(&sql);
+	simpleDeparseJoinSql(&sql, root, joinrel, fdw_scan_tlist,
+						 fpinfo->remote_conds, &params_list);
+
+	elog(DEBUG1, "simple_fdw: remote query is: %s", sql.data);
+
+	/* The result columns fill the scan tuple in order */
+	for (i = 1; i <= list_length(fdw_scan_tlist); i++)
+		retrieved_attrs = lappend_int(retrieved_attrs, i);
+
+	/* Read completely before the first change, as for a base relation */
+	if (simpleModifiesServer(root, joinrel->serverid))
+		fetch_size = 0;
+	else
+		fetch_size = fpinfo->fetch_size;
+
+	fdw_private = list_make4(makeString(sql.data), retrieved_attrs,
+							 makeInteger(fetch_size), NIL);
+
+	return make_foreignscan(tlist,
+							local_exprs,
+							0,		/* no base relation */
+							params_list,
+							fdw_private,
+							fdw_scan_tlist,
+							NIL,	/* no recheck quals */
+							NULL);
+}
+
+/*
+ * Add paths for the post-scan/join processing steps that SQLite can do.
+ *
+ * This is the aggregation of a single foreign table, and the LIMIT/OFFSET
+ * clause of a query on a single foreign table, along with its ORDER BY.
+ */
+static void
+simpleGetForeignUpperPaths(PlannerInfo *root,
+						   UpperRelationKind stage,
+						   RelOptInfo *input_rel,
+						   RelOptInfo *output_rel,
+						   void *extra)
+{
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/*
+	 * If input rel is not safe to push down, or if we already did this
+	 * output rel, then there's nothing to do.
+	 */
+	if (input_rel->fdw_private == NULL || output_rel->fdw_private != NULL)
+		return;
+
+	switch (stage)
+	{
+		case UPPERREL_GROUP_AGG:
+			simpleAddGroupingPaths(root, input_rel, output_rel,
+								   (GroupPathExtraData *) extra);
+			break;
+		case UPPERREL_ORDERED:
+			simpleAddOrderedPaths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_FINAL:
+			simpleAddFinalPaths(root, input_rel, output_rel,
+								(FinalPathExtraData *) extra);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Add a path computing the aggregates and the GROUP BY of the query in
+ * SQLite, so that only the groups are fetched.
+ */
+static void
+simpleAddGroupingPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					   RelOptInfo *grouped_rel, GroupPathExtraData *extra)
+{
+	Query	   *parse = root->parse;
+	SimpleFdwPlanState *ifpinfo = (SimpleFdwPlanState *) input_rel->fdw_private;
+	SimpleFdwPlanState *fpinfo;
+	List	   *tlist;
+	double		input_rows = ifpinfo->rows;
+	double		num_groups = 1;
+	Cost		startup_cost;
+	Cost		total_cost;
+	Path	   *grouppath;
+
+	/* Nothing to be done, if there is no grouping or aggregation required. */
+	if (!parse->groupClause && !parse->groupingSets && !parse->hasAggs &&
+		!root->hasHavingQual)
+		return;
+
+	/* Partial aggregation is not supported */
+	if (extra->patype != PARTITIONWISE_AGGREGATE_NONE &&
+		extra->patype != PARTITIONWISE_AGGREGATE_FULL)
+		return;
+
+	if (!simpleGroupingIsPushable(root, input_rel, grouped_rel, &tlist))
+		return;
+
+	if (parse->groupClause)
+	{
+		List	   *group_exprs = get_sortgrouplist_exprs(parse->groupClause,
+														  tlist);
+
+#if (PG_VERSION_NUM >= 140000)
+		num_groups = estimate_num_groups(root, group_exprs, input_rows,
+										 NULL, NULL);
+#else
+		num_groups = estimate_num_groups(root, group_exprs, input_rows,
+										 NULL);
+#endif
+	}
+
+	/*
+	 * SQLite still reads the same rows, and computes the target list for
+	 * each of them, but only the groups are transferred.
+	 */
+	startup_cost = ifpinfo->total_cost -
+		(ifpinfo->fdw_tuple_cost + cpu_tuple_cost) * input_rows +
+		cpu_operator_cost * list_length(tlist) * input_rows;
+	total_cost = startup_cost +
+		(ifpinfo->fdw_tuple_cost + cpu_tuple_cost) * num_groups;
+
+	fpinfo = (SimpleFdwPlanState *) palloc0(sizeof(SimpleFdwPlanState));
+	fpinfo->stage = UPPERREL_GROUP_AGG;
+	fpinfo->outerrel = input_rel;
+	fpinfo->grouped_tlist = tlist;
+	grouped_rel->fdw_private = fpinfo;
+
+	grouppath = (Path *) create_foreign_upper_path(root,
+												   grouped_rel,
+												   grouped_rel->reltarget,
+												   num_groups,
+												   startup_cost,
+												   total_cost,
+												   NIL,		/* no pathkeys */
+												   NULL,	/* no extra plan */
+												   NIL);	/* no fdw_private */
+	add_path(grouped_rel, grouppath);
+}
+
+/*
+ * Check whether the grouping of the query can be done by SQLite, and if so
+ * build in *tlist the target list of the grouped query: the grouping
+ * expressions, and the aggregates and other expressions computed from
+ * them.  Expressions that SQLite can't compute are computed locally from
+ * the aggregates and columns they use, which are then added to *tlist.
+ */
+static bool
+simpleGroupingIsPushable(PlannerInfo *root, RelOptInfo *input_rel,
+						 RelOptInfo *grouped_rel, List **tlist)
+{
+	Query	   *parse = root->parse;
+	SimpleFdwPlanState *ifpinfo = (SimpleFdwPlanState *) input_rel->fdw_private;
+	PathTarget *grouping_target = grouped_rel->reltarget;
+	ListCell   *lc;
+	int			i;
+
+	/*
+	 * Only the aggregation of a single foreign table is sent, with all its
+	 * conditions, so that SQLite aggregates the same rows.
+	 */
+	if (input_rel->reloptkind != RELOPT_BASEREL ||
+		ifpinfo->local_conds != NIL ||
+		root->hasPseudoConstantQuals)
+		return false;
+
+	/* Grouping sets and HAVING are done locally */
+	if (parse->groupingSets || root->hasHavingQual)
+		return false;
+
+	*tlist = NIL;
+
+	i = 0;
+	foreach(lc, grouping_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		Index		sgref = get_pathtarget_sortgroupref(grouping_target, i);
+
+		i++;
+
+		if (sgref && get_sortgroupref_clause_noerr(sgref, parse->groupClause))
+		{
+			TargetEntry *tle;
+
+			/* A grouping expression has to be computed by SQLite */
+			if (!simpleIsForeignExpr(root, input_rel, expr) ||
+				!simpleIsGroupableExpr(expr))
+				return false;
+
+			/*
+			 * Keep duplicate entries, which may have different sortgrouprefs.
+			 */
+			tle = makeTargetEntry(expr, list_length(*tlist) + 1, NULL, false);
+			tle->ressortgroupref = sgref;
+			*tlist = lappend(*tlist, tle);
+		}
+		else if (simpleIsForeignExpr(root, input_rel, expr))
+			*tlist = add_to_flat_tlist(*tlist, list_make1(expr));
+		else
+		{
+			List	   *aggvars;
+			ListCell   *l;
+
+			aggvars = pull_var_clause((Node *) expr, PVC_INCLUDE_AGGREGATES);
+			foreach(l, aggvars)
+			{
+				if (!simpleIsForeignExpr(root, input_rel, (Expr *) lfirst(l)))
+					return false;
+			}
+			*tlist = add_to_flat_tlist(*tlist, aggvars);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * The sorted paths of a foreign table already handle the ORDER BY of the
+ * query, so there's nothing to add here.  We only remember that the
+ * ordered relation is the foreign table sorted remotely, so that
+ * simpleAddFinalPaths can send the ORDER BY along with a LIMIT.
+ */
+static void
+simpleAddOrderedPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					  RelOptInfo *ordered_rel)
+{
+	SimpleFdwPlanState *fpinfo;
+
+	if (input_rel->reloptkind != RELOPT_BASEREL ||
+		root->parse->hasTargetSRFs ||
+		root->sort_pathkeys == NIL ||
+		!simplePathkeysUseIndex(root, input_rel, root->sort_pathkeys))
+		return;
+
+	fpinfo = (SimpleFdwPlanState *) palloc0(sizeof(SimpleFdwPlanState));
+	fpinfo->stage = UPPERREL_ORDERED;
+	fpinfo->outerrel = input_rel;
+	ordered_rel->fdw_private = fpinfo;
+}
+
+/*
+ * Add a path sending the LIMIT/OFFSET clause of the query to SQLite, with
+ * the ORDER BY if the query has one.  The path belongs to the foreign
+ * table itself, so that the plan remains a simple scan of it.
+ */
+static void
+simpleAddFinalPaths(PlannerInfo *root, RelOptInfo *input_rel,
+					RelOptInfo *final_rel, FinalPathExtraData *extra)
+{
+	Query	   *parse = root->parse;
+	SimpleFdwPlanState *ifpinfo = (SimpleFdwPlanState *) input_rel->fdw_private;
+	SimpleFdwPlanState *fpinfo;
+	bool		has_final_sort = false;
+	List	   *pathkeys = NIL;
+	double		rows;
+	double		skipped;
+	Cost		startup_cost;
+	Cost		total_cost;
+	List	   *fdw_private;
+	Path	   *final_path;
+
+	/*
+	 * LIMIT with FOR UPDATE/SHARE or set-returning functions in the target
+	 * list is done locally.
+	 */
+	if (!extra->limit_needed || parse->rowMarks || parse->hasTargetSRFs)
+		return;
+
+	/* Look through the ordered relation for the foreign table */
+	if (input_rel->reloptkind == RELOPT_UPPER_REL &&
+		ifpinfo->stage == UPPERREL_ORDERED)
+	{
+		input_rel = ifpinfo->outerrel;
+		ifpinfo = (SimpleFdwPlanState *) input_rel->fdw_private;
+		has_final_sort = true;
+		pathkeys = root->sort_pathkeys;
+	}
+
+	if (input_rel->reloptkind != RELOPT_BASEREL)
+		return;
+
+	/*
+	 * The rows have to be filtered entirely by SQLite, so that the LIMIT
+	 * counts the same rows.
+	 */
+	if (ifpinfo->local_conds != NIL)
+		return;
+
+	if (!simpleIsLimitPushable(root))
+		return;
+
+	/* Same cost as the (sorted) scan, cut down to the rows read */
+	rows = ifpinfo->rows;
+	startup_cost = ifpinfo->startup_cost;
+	total_cost = ifpinfo->total_cost;
+	if (has_final_sort)
+		total_cost += cpu_operator_cost * ifpinfo->rows;
+	adjust_limit_rows_costs(&rows, &startup_cost, &total_cost,
+							extra->offset_est, extra->count_est);
+
+	/*
+	 * Unlike a local Limit over the scan, SQLite skips the OFFSET rows
+	 * without returning them, and no Limit node runs on the rows it
+	 * returns.  Without this, the path would cost the same as the local
+	 * Limit, and lose to it.
+	 */
+	skipped = Min((double) Max(extra->offset_est, 0), ifpinfo->rows);
+	total_cost -= (ifpinfo->fdw_tuple_cost + cpu_tuple_cost) * skipped +
+		cpu_tuple_cost * rows;
+
+	fpinfo = (SimpleFdwPlanState *) palloc0(sizeof(SimpleFdwPlanState));
+	fpinfo->stage = UPPERREL_FINAL;
+	fpinfo->outerrel = input_rel;
+	final_rel->fdw_private = fpinfo;
+
+	/*
+	 * The order of the items must match enum FdwPathPrivateIndex.
+	 */
+	fdw_private = list_make2(makeInteger(has_final_sort),
+							 makeInteger(true));
+
+	final_path = (Path *) create_foreign_upper_path(root,
+													input_rel,
+													root->upper_targets[UPPERREL_FINAL],
+													rows,
+													startup_cost,
+													total_cost,
+													pathkeys,
+													NULL,	/* no extra plan */
+													fdw_private);
+	add_path(final_rel, final_path);
+}
+
+/*
+ * Create a ForeignScan plan for a grouped relation.  There's no base
+ * relation to scan: the scan tuples are described by the target list of
+ * the grouped query, as fdw_scan_tlist.
+ */
+static ForeignScan *
+simpleGetForeignGroupPlan(PlannerInfo *root, RelOptInfo *grouped_rel,
+						  List *tlist)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) grouped_rel->fdw_private;
+	RelOptInfo *baserel = fpinfo->outerrel;
+	SimpleFdwPlanState *ifpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	List	   *fdw_scan_tlist = fpinfo->grouped_tlist;
+	List	   *remote_exprs;
+	List	   *retrieved_attrs = NIL;
+	List	   *params_list = NIL;
+	List	   *fdw_private;
+	StringInfoData sql;
+	int			fetch_size;
+	int			i;
+
+	/* All the conditions of the base relation are sent to SQLite */
+	remote_exprs = extract_actual_clauses(ifpinfo->remote_conds, false);
+
+	initStringInfo(&sql);
+	simpleDeparseGroupSql(&sql, root, baserel, ifpinfo->table,
+						  fdw_scan_tlist, remote_exprs, &params_list);
+
+	elog(DEBUG1, "simple_fdw: remote query is: %s", sql.data);
+
+	/* The result columns fill the scan tuple in order */
+	for (i = 1; i <= list_length(fdw_scan_tlist); i++)
+		retrieved_attrs = lappend_int(retrieved_attrs, i);
+
+	/* Read completely before the first change, as for a base relation */
+	if (simpleModifiesServer(root, grouped_rel->serverid))
+		fetch_size = 0;
+	else
+		fetch_size = ifpinfo->fetch_size;
+
+	fdw_private = list_make4(makeString(sql.data), retrieved_attrs,
+							 makeInteger(fetch_size), NIL);
+
+	return make_foreignscan(tlist,
+							NIL,	/* no local quals */
+							0,		/* no base relation */
+							params_list,
+							fdw_private,
+							fdw_scan_tlist,
+							NIL,	/* no recheck quals */
+							NULL);
+}
+#endif
+
+static ForeignScan *
+simpleGetForeignPlan(PlannerInfo *root,
+						RelOptInfo *baserel,
+						Oid foreigntableid,
+						ForeignPath *best_path,
+						List *tlist,
+						List *scan_clauses)
+{
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) baserel->fdw_private;
+	Index		scan_relid = baserel->relid;
+	List	   *fdw_private;
+	List	   *remote_exprs = NIL;
+	List	   *local_exprs = NIL;
+	List	   *plan_exprs = NIL;
+	List	   *batch_exprs = NIL;
+	List	   *batch_quals = NIL;
+	List	   *retrieved_attrs;
+	List	   *params_list = NIL;
+	Bitmapset  *attrs_used;
+	StringInfoData sql;
+	bool		has_limit = false;
+	int			fetch_size;
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+#if (PG_VERSION_NUM >= 120000)
+	/* Joins and grouped relations are built from their own target list */
+	if (baserel->reloptkind == RELOPT_JOINREL)
+		return simpleGetForeignJoinPlan(root, baserel, tlist);
+	if (baserel->reloptkind == RELOPT_UPPER_REL)
+		return simpleGetForeignGroupPlan(root, baserel, tlist);
+#endif
+
+	/* Get the data of the path, if created by simpleGetForeignUpperPaths */
+	if (best_path->fdw_private != NIL)
+		has_limit = intVal(list_nth(best_path->fdw_private,
+									FdwPathPrivateHasLimit));
+
+	/*
+	 * Separate the scan_clauses into those that can be executed remotely
+	 * and those that can't.  baserestrictinfo clauses that were previously
+	 * determined to be safe or unsafe by simpleClassifyConditions are
+	 * shown in fpinfo->remote_conds and fpinfo->local_conds.  Anything
+	 * else in the scan_clauses list will be a join clause, which we have
+	 * to check for remote-safety.
+	 */
+	foreach(lc, scan_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		Assert(IsA(rinfo, RestrictInfo));
+
+		/* Ignore any pseudoconstants, they're dealt with elsewhere */
+		if (rinfo->pseudoconstant)
+			continue;
+
+		if (list_member_ptr(fpinfo->remote_conds, rinfo))
+			remote_exprs = lappend(remote_exprs, rinfo->clause);
+		else if (list_member_ptr(fpinfo->local_conds, rinfo))
+			local_exprs = lappend(local_exprs, rinfo->clause);
+		else if (simpleIsForeignExpr(root, baserel, rinfo->clause))
+			remote_exprs = lappend(remote_exprs, rinfo->clause);
+		else
+			local_exprs = lappend(local_exprs, rinfo->clause);
+	}
+
+	/*
+	 * Join clauses kept as local quals need their columns fetched too, on
+	 * top of those already collected by simpleGetForeignRelSize.
+	 */
+	attrs_used = bms_copy(fpinfo->attrs_used);
+	pull_varattnos((Node *) local_exprs, baserel->relid, &attrs_used);
+
+#if (PG_VERSION_NUM >= 90500)
+	/*
+	 * The local comparisons of numeric columns with constants, left out
+	 * because SQLite has no literal for the constant, like NaN, or because
+	 * the column is cast, are checked over whole batches of rows before
+	 * any tuple is formed from them.  The other local clauses are checked
+	 * for each row, as plan quals.
+	 */
+	foreach(lc, local_exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		SimpleBatchQual qual;
+
+		if (simpleMakeBatchQual(expr, baserel->relid, &qual))
+			batch_exprs = lappend(batch_exprs, expr);
+		else
+			plan_exprs = lappend(plan_exprs, expr);
+	}
+
+	/*
+	 * setrefs.c doesn't adjust the Vars of fdw_private, so the batch quals
+	 * kept there get the varno of a single table range table, which is
+	 * what EXPLAIN shows them against.
+	 */
+	batch_quals = (List *) copyObject(batch_exprs);
+	ChangeVarNodes((Node *) batch_quals, baserel->relid, 1, 0);
+#else
+	plan_exprs = local_exprs;
+#endif
+
+	/* Build the query sent to SQLite */
+	initStringInfo(&sql);
+	simpleDeparseSelectSql(&sql, root, baserel, fpinfo->table,
+						   attrs_used, &retrieved_attrs);
+	simpleAppendWhereClause(&sql, root, baserel, remote_exprs, &params_list);
+#if (PG_VERSION_NUM >= 110000)
+	if (best_path->path.parallel_aware)
+		simpleAppendRowidRangeClause(&sql, remote_exprs != NIL,
+									 list_length(params_list) + 1);
+#endif
+	if (best_path->path.pathkeys != NIL)
+		simpleAppendOrderByClause(&sql, root, baserel, best_path->path.pathkeys);
+	if (has_limit)
+		simpleAppendLimitClause(&sql, root);
+
+	elog(DEBUG1, "simple_fdw: remote query is: %s", sql.data);
+
+	/*
+	 * The tables of a server the statement changes are read completely
+	 * before the first change, which a fetch size of 0 asks for: SQLite
+	 * would otherwise go on reading a table while rows get added to it,
+	 * or to another one of its database, through the same connection.
+	 */
+	if (simpleModifiesServer(root, baserel->serverid))
+		fetch_size = 0;
+	else
+		fetch_size = fpinfo->fetch_size;
+
+	/*
+	 * The remote query is passed to the executor through fdw_private; the
+	 * order of the items must match enum FdwScanPrivateIndex.
+	 */
+	fdw_private = list_make4(makeString(sql.data), retrieved_attrs,
+							 makeInteger(fetch_size), batch_quals);
+
+	/*
+	 * Only the clauses that can't be sent to SQLite, nor checked over
+	 * batches, remain as plan quals and are checked locally for each row.
+	 * The batch quals are rechecked with the remote clauses when a row is
+	 * rechecked by EvalPlanQual.  The values of the query parameters are
+	 * computed from fdw_exprs by the executor.
+	 */
+#if (PG_VERSION_NUM >= 90500)
+	return make_foreignscan(tlist,
+							plan_exprs,
+							scan_relid,
+							params_list,
+							fdw_private,
+							NIL,
+							list_concat(list_copy(remote_exprs), batch_exprs),
+							NULL);
+#else
+	return make_foreignscan(tlist,
+							plan_exprs,
+							scan_relid,
+							params_list,
+							fdw_private);
+#endif
+}
+
+static void
+simpleBeginForeignScan(ForeignScanState *node,
+						  int eflags)
+{
+	ForeignScan              *fsplan = (ForeignScan *) node->ss.ps.plan;
+	sqlite3                  *db;
+	Oid                       serverid;
+	SimpleFdwExecutionState  *festate;
+	char                     *svr_database = NULL;
+	char                     *svr_table = NULL;
+	char                     *query;
+	TupleDesc                 tupdesc;
+	SimpleStatsCounters       conn_before = simple_connection_stats;
+	List                     *batch_exprs;
+	ListCell                 *lc;
+	int                       x;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+#if (PG_VERSION_NUM >= 90500)
+	/*
+	 * A scan without a base relation, like a pushed down aggregate, gets
+	 * its server from the plan, and its tuple descriptor from
+	 * fdw_scan_tlist.
+	 */
+	if (fsplan->scan.scanrelid == 0)
+	{
+		serverid = fsplan->fs_server;
+		tupdesc = node->ss.ss_ScanTupleSlot->tts_tupleDescriptor;
+	}
+	else
+#endif
+	{
+		/* Fetch options  */
+		simpleGetOptions(RelationGetRelid(node->ss.ss_currentRelation), &svr_database, &svr_table);
+
+		serverid = GetForeignTable(RelationGetRelid(node->ss.ss_currentRelation))->serverid;
+		tupdesc = RelationGetDescr(node->ss.ss_currentRelation);
+	}
+
+	/* Connect to the server, or reuse the cached connection */
+	db = simpleGetConnection(serverid);
+
+	/* Get the query built by simpleGetForeignPlan */
+	query = pstrdup(strVal(list_nth(fsplan->fdw_private,
+									FdwScanPrivateSelectSql)));
+
+	/* Stash away the state info we have already */
+	festate = (SimpleFdwExecutionState *) palloc(sizeof(SimpleFdwExecutionState));
+	node->fdw_state = (void *) festate;
+	festate->serverid = serverid;
+	festate->conn = db;
+	festate->result = NULL;
+	festate->query = query;
+	festate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private,
+												 FdwScanPrivateRetrievedAttrs);
+
+	/*
+	 * Look up the input functions of the attributes, and map each result
+	 * column to the attribute it fills, once and for all.
+	 */
+	festate->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+	festate->ncolumns = list_length(festate->retrieved_attrs);
+	festate->colmap = (int *) palloc(sizeof(int) * festate->ncolumns);
+	festate->coltypes = (Oid *) palloc(sizeof(Oid) * festate->ncolumns);
+
+	x = 0;
+	foreach(lc, festate->retrieved_attrs)
+	{
+		int			attnum = lfirst_int(lc);
+
+		if (attnum == SelfItemPointerAttributeNumber)
+		{
+			/* The rowid, which goes into the ctid of the tuple */
+			festate->colmap[x] = -1;
+			festate->coltypes[x] = INT8OID;
+		}
+		else
+		{
+			festate->colmap[x] = attnum - 1;
+			festate->coltypes[x] = TupleDescAttr(tupdesc, attnum - 1)->atttypid;
+		}
+		x++;
+	}
+
+	/* Allocate the prefetch buffer */
+	festate->fetch_size = intVal(list_nth(fsplan->fdw_private,
+										  FdwScanPrivateFetchSize));
+	festate->fetch_all = (festate->fetch_size == 0);
+	if (festate->fetch_all)
+		festate->fetch_size = DEFAULT_FETCH_SIZE;
+	festate->batch_values = (Datum *) palloc(sizeof(Datum) *
+											 Max(festate->ncolumns, 1) *
+											 festate->fetch_size);
+	festate->batch_nulls = (bool *) palloc(sizeof(bool) *
+										   Max(festate->ncolumns, 1) *
+										   festate->fetch_size);
+	festate->batch_rows = 0;
+	festate->next_row = 0;
+	festate->eof_reached = false;
+
+	/*
+	 * Get the batch quals ready, finding the result column each of them
+	 * checks, and allocate what the batch filter needs.
+	 */
+	batch_exprs = (List *) list_nth(fsplan->fdw_private,
+									FdwScanPrivateBatchQuals);
+	festate->batch_quals = (SimpleBatchQual *)
+		palloc(sizeof(SimpleBatchQual) * Max(list_length(batch_exprs), 1));
+	festate->nbatch_quals = 0;
+	foreach(lc, batch_exprs)
+	{
+		SimpleBatchQual *qual = &festate->batch_quals[festate->nbatch_quals++];
+
+		if (!simpleMakeBatchQual((Expr *) lfirst(lc), 0, qual))
+			elog(ERROR, "unexpected batch qual");
+
+		for (x = 0; x < festate->ncolumns; x++)
+			if (festate->colmap[x] == qual->attnum - 1)
+				break;
+		if (x == festate->ncolumns)
+			elog(ERROR, "column %d of batch qual is not retrieved",
+				 qual->attnum);
+		qual->column = x;
+	}
+	festate->batch_sel = NULL;
+	festate->batch_nsel = 0;
+	festate->rows_filtered = 0;
+	if (festate->nbatch_quals > 0)
+	{
+		festate->batch_sel = (int *) palloc(sizeof(int) * festate->fetch_size);
+		festate->batch_keep = (bool *) palloc(sizeof(bool) * festate->fetch_size);
+		festate->batch_ints = (int64 *) palloc(sizeof(int64) * festate->fetch_size);
+		festate->batch_floats = (double *) palloc(sizeof(double) * festate->fetch_size);
+	}
+
+#if (PG_VERSION_NUM >= 110000)
+	/* The shared state, if any, is set up later by the DSM callbacks */
+	festate->parallel = fsplan->scan.plan.parallel_aware;
+	festate->pscan = NULL;
+	festate->chunk_bound = false;
+	festate->whole_range_done = false;
+#endif
+
+#if (PG_VERSION_NUM >= 140000)
+	/*
+	 * An asynchronous scan gets its fetcher right away, as the first batch
+	 * is requested as soon as the Append above starts.
+	 */
+	festate->fetcher = NULL;
+	if (node->ss.ps.async_capable && !festate->fetch_all &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		festate->fetcher = simpleAsyncCreate(festate->ncolumns,
+											 festate->fetch_size);
+#endif
+
+	/*
+	 * Prepare for the evaluation of the parameters of the query: outer
+	 * values of a parameterized scan, or Params of the query.
+	 */
+	festate->numParams = list_length(fsplan->fdw_exprs);
+	festate->params_evaluated = false;
+	festate->params_bound = false;
+	festate->param_types = (Oid *) palloc(sizeof(Oid) * Max(festate->numParams, 1));
+	festate->param_values = (Datum *) palloc(sizeof(Datum) * Max(festate->numParams, 1));
+	festate->param_nulls = (bool *) palloc(sizeof(bool) * Max(festate->numParams, 1));
+	x = 0;
+	foreach(lc, fsplan->fdw_exprs)
+		festate->param_types[x++] = exprType((Node *) lfirst(lc));
+#if (PG_VERSION_NUM >= 100000)
+	festate->param_exprs = ExecInitExprList(fsplan->fdw_exprs, (PlanState *) node);
+#else
+	festate->param_exprs = (List *) ExecInitExpr((Expr *) fsplan->fdw_exprs, (PlanState *) node);
+#endif
+
+	/*
+	 * Look the result up in the shared cache, for a server with the
+	 * result_cache option.  Scans whose rows are not all read by the
+	 * backend in batches, as parallel or asynchronous ones, are not
+	 * cached.
+	 */
+	festate->cache = NULL;
+	if (!festate->fetch_all && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		char	   *database = simpleGetResultCacheDatabase(festate->serverid);
+		bool		cacheable = (database != NULL);
+
+#if (PG_VERSION_NUM >= 110000)
+		if (festate->parallel)
+			cacheable = false;
+#endif
+#if (PG_VERSION_NUM >= 140000)
+		if (node->ss.ps.async_capable)
+			cacheable = false;
+#endif
+		if (cacheable)
+		{
+			int32	   *typmods = (int32 *) palloc(sizeof(int32) *
+												   Max(festate->ncolumns, 1));
+
+			for (x = 0; x < festate->ncolumns; x++)
+				typmods[x] = (festate->colmap[x] < 0) ? -1 :
+					festate->attinmeta->atttypmods[festate->colmap[x]];
+			festate->cache = simpleCacheBegin(database, festate->query,
+											  festate->ncolumns,
+											  festate->coltypes, typmods);
+		}
+	}
+
+	/*
+	 * Time the fetches when running EXPLAIN ANALYZE with timing, or for the
+	 * statistics when simple_fdw.track_timing is on.
+	 */
+	festate->track_stats = (simpleStatsEnabled() &&
+							!(eflags & EXEC_FLAG_EXPLAIN_ONLY));
+	festate->track_timing = ((node->ss.ps.instrument != NULL &&
+							  node->ss.ps.instrument->need_timer) ||
+							 (festate->track_stats && simple_stats_track_timing));
+	festate->rows_fetched = 0;
+	INSTR_TIME_SET_ZERO(festate->step_time);
+	INSTR_TIME_SET_ZERO(festate->convert_time);
+	memset(&festate->stats, 0, sizeof(SimpleStatsCounters));
+	simpleStatsAccumConnection(&festate->stats, &conn_before);
+
+	/*
+	 * The Datums of each batch are built in their own context, reset before
+	 * fetching the next batch, so a scan uses the same amount of memory
+	 * however many rows it returns.
+	 */
+#if (PG_VERSION_NUM >= 90600)
+	festate->temp_cxt = AllocSetContextCreate(node->ss.ps.state->es_query_cxt,
+											  "simple_fdw tuple data",
+											  ALLOCSET_DEFAULT_SIZES);
+#else
+	festate->temp_cxt = AllocSetContextCreate(node->ss.ps.state->es_query_cxt,
+											  "simple_fdw tuple data",
+											  ALLOCSET_DEFAULT_MINSIZE,
+											  ALLOCSET_DEFAULT_INITSIZE,
+											  ALLOCSET_DEFAULT_MAXSIZE);
+#endif
+}
+
+static TupleTableSlot *
+simpleIterateForeignScan(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	ExecClearTuple(slot);
+
+	/*
+	 * Fetch the next batch once all the rows of this one are returned, or
+	 * if none of its rows passed the batch quals.  An asynchronous scan
+	 * returns an empty slot instead, the batch being fetched in the
+	 * background by simpleProduceTupleAsync.
+	 */
+	while (festate->next_row >= festate->batch_nsel && !festate->eof_reached &&
+		   !IS_ASYNC_SCAN(festate))
+		simpleFetchBatch(node);
+
+	/* get the next row of the batch, if any, and fill in the slot */
+	if (festate->next_row < festate->batch_nsel)
+	{
+		int			row;
+		int			x;
+
+		row = festate->batch_sel ? festate->batch_sel[festate->next_row] :
+			festate->next_row;
+		festate->next_row++;
+
+		/*
+		 * Fill the slot as a virtual tuple, pointing to the values of the
+		 * batch.  Only the retrieved columns are in the result, the others
+		 * are left NULL.
+		 */
+		memset(slot->tts_isnull, true,
+			   sizeof(bool) * slot->tts_tupleDescriptor->natts);
+
+		for (x = 0; x < festate->ncolumns; x++)
+		{
+			int			i = festate->colmap[x];
+			int			pos = x * festate->fetch_size + row;
+
+			if (i < 0)
+			{
+				simpleRowidToItemPointer(DatumGetInt64(festate->batch_values[pos]),
+										 &slot->tts_tid);
+				continue;
+			}
+
+			slot->tts_values[i] = festate->batch_values[pos];
+			slot->tts_isnull[i] = festate->batch_nulls[pos];
+		}
+
+		ExecStoreVirtualTuple(slot);
+	}
+
+	/* then return the slot */
+	return slot;
+}
+
+/*
+ * Fetch the next batch of rows from SQLite into the prefetch buffer.
+ * Stepping through many rows in a row, and converting them column after
+ * column, keeps the SQLite cursor and the conversion code hot.
+ */
+static void
+simpleFetchBatch(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	MemoryContext oldcontext;
+	int			x;
+
+	/* The previous batch is not needed anymore */
+	MemoryContextReset(festate->temp_cxt);
+	festate->batch_rows = 0;
+	festate->batch_nsel = 0;
+	festate->next_row = 0;
+
+	/*
+	 * Once the parameters are known, look the result up in the cache, and
+	 * read its rows from there if it's found.  SQLite is left alone then.
+	 */
+	if (festate->cache != NULL)
+	{
+		simpleEvalParams(node);
+		if (simpleCacheLookup(festate->cache, festate->numParams,
+							  festate->param_types, festate->param_values,
+							  festate->param_nulls))
+		{
+			oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+			festate->batch_rows = simpleCacheRead(festate->cache,
+												  festate->batch_values,
+												  festate->batch_nulls,
+												  festate->fetch_size,
+												  festate->fetch_size);
+			MemoryContextSwitchTo(oldcontext);
+			if (festate->batch_rows < festate->fetch_size)
+				festate->eof_reached = true;
+			simpleFilterBatch(festate);
+			return;
+		}
+	}
+
+	simpleExecuteQuery(node);
+
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+
+	while ((festate->batch_rows < festate->fetch_size || festate->fetch_all) &&
+		   !festate->eof_reached)
+	{
+		int			row = festate->batch_rows;
+		instr_time	start;
+		instr_time	end;
+		int			rc;
+
+		/* Make room for the next rows, if all of them are wanted */
+		if (row == festate->fetch_size)
+			simpleGrowBatch(festate);
+
+		if (festate->track_timing)
+			INSTR_TIME_SET_CURRENT(start);
+		rc = sqlite3_step(festate->result);
+		if (festate->track_timing)
+		{
+			INSTR_TIME_SET_CURRENT(end);
+			INSTR_TIME_ACCUM_DIFF(festate->step_time, end, start);
+			start = end;
+		}
+
+		if (rc != SQLITE_ROW)
+		{
+			/* A busy database must not pass for the end of the rows */
+			if (rc != SQLITE_DONE)
+				ereport(ERROR,
+					(errcode(simpleSqliteErrcode(rc)),
+					errmsg("SQL error during fetch: %s",
+						   sqlite3_errmsg(festate->conn))
+					));
+#if (PG_VERSION_NUM >= 110000)
+			/* Go on with the next chunk of a parallel scan */
+			if (festate->parallel && simpleClaimChunk(festate))
+				continue;
+#endif
+			festate->eof_reached = true;
+			break;
+		}
+
+		for (x = 0; x < festate->ncolumns; x++)
+		{
+			sqlite3_value *value = sqlite3_column_value(festate->result, x);
+
+			if (festate->track_stats)
+				festate->stats.bytes += sqlite3_value_bytes(value);
+
+			simpleDecodeValue(festate, x, x * festate->fetch_size + row, value);
+		}
+
+		if (festate->track_timing)
+		{
+			INSTR_TIME_SET_CURRENT(end);
+			INSTR_TIME_ACCUM_DIFF(festate->convert_time, end, start);
+		}
+
+		festate->batch_rows++;
+		festate->rows_fetched++;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Keep the rows for the cache, before the batch quals drop some */
+	if (festate->cache != NULL)
+	{
+		simpleCacheRecord(festate->cache, festate->batch_values,
+						  festate->batch_nulls, festate->fetch_size,
+						  festate->batch_rows);
+		if (festate->eof_reached)
+			simpleCacheStore(festate->cache);
+	}
+
+	simpleFilterBatch(festate);
+}
+
+/*
+ * Double the size of the prefetch buffer, moving the columns to their new
+ * place, the last one first.
+ */
+static void
+simpleGrowBatch(SimpleFdwExecutionState *festate)
+{
+	Size		old_size = festate->fetch_size;
+	Size		new_size = old_size * 2;
+	int			x;
+
+	if (new_size > INT_MAX)
+		ereport(ERROR,
+			(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+			errmsg("too many rows to fetch from SQLite")
+			));
+
+	festate->batch_values = (Datum *)
+		repalloc_huge(festate->batch_values,
+					  sizeof(Datum) * Max(festate->ncolumns, 1) * new_size);
+	festate->batch_nulls = (bool *)
+		repalloc_huge(festate->batch_nulls,
+					  sizeof(bool) * Max(festate->ncolumns, 1) * new_size);
+
+	for (x = festate->ncolumns - 1; x > 0; x--)
+	{
+		memmove(&festate->batch_values[x * new_size],
+				&festate->batch_values[x * old_size],
+				sizeof(Datum) * old_size);
+		memmove(&festate->batch_nulls[x * new_size],
+				&festate->batch_nulls[x * old_size],
+				sizeof(bool) * old_size);
+	}
+
+	if (festate->nbatch_quals > 0)
+	{
+		festate->batch_sel = (int *)
+			repalloc_huge(festate->batch_sel, sizeof(int) * new_size);
+		festate->batch_keep = (bool *)
+			repalloc_huge(festate->batch_keep, sizeof(bool) * new_size);
+		festate->batch_ints = (int64 *)
+			repalloc_huge(festate->batch_ints, sizeof(int64) * new_size);
+		festate->batch_floats = (double *)
+			repalloc_huge(festate->batch_floats, sizeof(double) * new_size);
+	}
+
+	festate->fetch_size = (int) new_size;
+}
+
+/*
+ * Store a SQLite value into the prefetch buffer, at position "pos", as a
+ * Datum of the type of result column x.  The integers and floating point
+ * values of analytical tables are stored right away when SQLite has them
+ * in the storage class of their column, without going through the generic
+ * conversion of simpleConvertValue.
+ */
+static inline void
+simpleDecodeValue(SimpleFdwExecutionState *festate, int x, int pos,
+				  sqlite3_value *value)
+{
+	AttInMetadata *attinmeta = festate->attinmeta;
+	int			i = festate->colmap[x];
+	int			vtype;
+
+	/* The rowid, which goes into the ctid of the tuple */
+	if (i < 0)
+	{
+		festate->batch_values[pos] = Int64GetDatum(sqlite3_value_int64(value));
+		festate->batch_nulls[pos] = false;
+		return;
+	}
+
+	vtype = sqlite3_value_type(value);
+	switch (festate->coltypes[x])
+	{
+		case INT4OID:
+			if (vtype == SQLITE_INTEGER)
+			{
+				sqlite3_int64 val = sqlite3_value_int64(value);
+
+				if (val >= PG_INT32_MIN && val <= PG_INT32_MAX)
+				{
+					festate->batch_values[pos] = Int32GetDatum((int32) val);
+					festate->batch_nulls[pos] = false;
+					return;
+				}
+			}
+			break;
+		case INT8OID:
+			if (vtype == SQLITE_INTEGER)
+			{
+				festate->batch_values[pos] =
+					Int64GetDatum((int64) sqlite3_value_int64(value));
+				festate->batch_nulls[pos] = false;
+				return;
+			}
+			break;
+		case FLOAT8OID:
+			if (vtype == SQLITE_FLOAT || vtype == SQLITE_INTEGER)
+			{
+				festate->batch_values[pos] =
+					Float8GetDatum(sqlite3_value_double(value));
+				festate->batch_nulls[pos] = false;
+				return;
+			}
+			break;
+		default:
+			break;
+	}
+
+	festate->batch_values[pos] =
+		simpleConvertValue(value,
+						   festate->coltypes[x],
+						   attinmeta->atttypmods[i],
+						   &attinmeta->attinfuncs[i],
+						   attinmeta->attioparams[i],
+						   &festate->batch_nulls[pos]);
+}
+
+/*
+ * Check whether a local clause can be checked over whole batches of rows,
+ * filling in "qual" if so: it must compare a column of relation "varno",
+ * or of any relation if 0, with a constant, using one of the built-in
+ * comparison operators of integers and floating point values.
+ */
+static bool
+simpleMakeBatchQual(Expr *expr, Index varno, SimpleBatchQual *qual)
+{
+	static const struct
+	{
+		const char *opname;
+		int			cmpmask;
+	}			batch_ops[] =
+	{
+		{"<", SIMPLE_CMP_LT},
+		{"<=", SIMPLE_CMP_LT | SIMPLE_CMP_EQ},
+		{"=", SIMPLE_CMP_EQ},
+		{">=", SIMPLE_CMP_GT | SIMPLE_CMP_EQ},
+		{">", SIMPLE_CMP_GT},
+		{"<>", SIMPLE_CMP_LT | SIMPLE_CMP_GT},
+		{NULL, 0}
+	};
+	OpExpr	   *oe = (OpExpr *) expr;
+	Node	   *arg;
+	Const	   *con;
+	Var		   *var;
+	Oid			argtype;
+	char	   *opname;
+	bool		commuted;
+	int			i;
+
+	if (!IsA(expr, OpExpr) || list_length(oe->args) != 2 ||
+		oe->opno >= FirstNormalObjectId)
+		return false;
+
+	/* One side is the column, the other one the constant */
+	commuted = IsA(linitial(oe->args), Const);
+	arg = (Node *) (commuted ? lsecond(oe->args) : linitial(oe->args));
+	con = (Const *) (commuted ? linitial(oe->args) : lsecond(oe->args));
+	if (!IsA(con, Const) || con->constisnull ||
+		!simpleIsBatchType(con->consttype))
+		return false;
+
+	var = simpleGetBatchVar(arg, varno);
+	if (var == NULL)
+		return false;
+	argtype = exprType(arg);
+
+	opname = get_opname(oe->opno);
+	for (i = 0; batch_ops[i].opname != NULL; i++)
+		if (strcmp(opname, batch_ops[i].opname) == 0)
+			break;
+	if (batch_ops[i].opname == NULL)
+		return false;
+
+	qual->attnum = var->varattno;
+	qual->coltype = var->vartype;
+	qual->cmpmask = batch_ops[i].cmpmask;
+	qual->column = -1;
+
+	/* "const < col" is "col > const" */
+	if (commuted)
+		qual->cmpmask = (qual->cmpmask & SIMPLE_CMP_EQ) |
+			((qual->cmpmask & SIMPLE_CMP_LT) ? SIMPLE_CMP_GT : 0) |
+			((qual->cmpmask & SIMPLE_CMP_GT) ? SIMPLE_CMP_LT : 0);
+
+	/*
+	 * Integers are compared as 64-bit integers, whatever their width, and
+	 * floating point values as doubles.  An integer cast to real is
+	 * rounded to a real first, like the cast does.
+	 */
+	qual->ival = 0;
+	qual->fval = 0;
+	if (argtype != FLOAT4OID && argtype != FLOAT8OID &&
+		con->consttype != FLOAT4OID && con->consttype != FLOAT8OID)
+	{
+		qual->cmptype = INT8OID;
+		if (con->consttype == INT2OID)
+			qual->ival = DatumGetInt16(con->constvalue);
+		else if (con->consttype == INT4OID)
+			qual->ival = DatumGetInt32(con->constvalue);
+		else
+			qual->ival = DatumGetInt64(con->constvalue);
+	}
+	else if ((argtype == FLOAT4OID || argtype == FLOAT8OID) &&
+			 (con->consttype == FLOAT4OID || con->consttype == FLOAT8OID))
+	{
+		if (argtype == FLOAT4OID && var->vartype != FLOAT4OID)
+			qual->cmptype = FLOAT4OID;
+		else
+			qual->cmptype = FLOAT8OID;
+		if (con->consttype == FLOAT4OID)
+			qual->fval = DatumGetFloat4(con->constvalue);
+		else
+			qual->fval = DatumGetFloat8(con->constvalue);
+	}
+	else
+		return false;
+
+	return true;
+}
+
+/*
+ * Returns the Var if the node is an integer or floating point column of
+ * relation "varno", or any relation if 0, possibly under a widening cast.
+ */
+static Var *
+simpleGetBatchVar(Node *node, Index varno)
+{
+	Var		   *var;
+
+	if (IsA(node, FuncExpr))
+	{
+		FuncExpr   *fe = (FuncExpr *) node;
+
+		if (list_length(fe->args) != 1 ||
+			!simpleIsWideningCast(exprType((Node *) linitial(fe->args)),
+								  fe->funcresulttype, fe->funcid))
+			return NULL;
+		node = (Node *) linitial(fe->args);
+	}
+
+	if (!IsA(node, Var))
+		return NULL;
+
+	var = (Var *) node;
+	if ((varno != 0 && var->varno != varno) || var->varlevelsup != 0 ||
+		var->varattno <= 0 || !simpleIsBatchType(var->vartype))
+		return NULL;
+
+	return var;
+}
+
+static bool
+simpleIsBatchType(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Returns true if "funcid" is the built-in cast from "source" to "target",
+ * and that cast can't fail: from an integer to a wider integer or to a
+ * floating point type, and from real to double precision.
+ */
+static bool
+simpleIsWideningCast(Oid source, Oid target, Oid funcid)
+{
+	HeapTuple	tuple;
+	bool		result;
+
+	switch (source)
+	{
+		case INT2OID:
+			result = (target == INT4OID || target == INT8OID ||
+					  target == FLOAT4OID || target == FLOAT8OID);
+			break;
+		case INT4OID:
+			result = (target == INT8OID ||
+					  target == FLOAT4OID || target == FLOAT8OID);
+			break;
+		case INT8OID:
+			result = (target == FLOAT4OID || target == FLOAT8OID);
+			break;
+		case FLOAT4OID:
+			result = (target == FLOAT8OID);
+			break;
+		default:
+			result = false;
+			break;
+	}
+	if (!result)
+		return false;
+
+	tuple = SearchSysCache2(CASTSOURCETARGET,
+							ObjectIdGetDatum(source),
+							ObjectIdGetDatum(target));
+	if (!HeapTupleIsValid(tuple))
+		return false;
+	result = (((Form_pg_cast) GETSTRUCT(tuple))->castfunc == funcid);
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
+/*
+ * Select the rows of the batch passing all the batch quals, whose indexes
+ * go into batch_sel.
+ */
+static void
+simpleFilterBatch(SimpleFdwExecutionState *festate)
+{
+	int			nsel = 0;
+	int			row;
+	int			i;
+
+	if (festate->nbatch_quals == 0)
+	{
+		festate->batch_nsel = festate->batch_rows;
+		return;
+	}
+
+	memset(festate->batch_keep, true, sizeof(bool) * festate->batch_rows);
+	for (i = 0; i < festate->nbatch_quals; i++)
+		simpleEvalBatchQual(festate, &festate->batch_quals[i]);
+
+	/* Branch-free: the index of a row failing the quals gets overwritten */
+	for (row = 0; row < festate->batch_rows; row++)
+	{
+		festate->batch_sel[nsel] = row;
+		nsel += festate->batch_keep[row];
+	}
+
+	festate->batch_nsel = nsel;
+	festate->rows_filtered += festate->batch_rows - nsel;
+}
+
+/*
+ * Compare two numbers, giving -1, 0 or 1.  Like in PostgreSQL, NaN is
+ * equal to itself and greater than any other floating point value.
+ */
+#define SIMPLE_CMP(a, b)	(((a) > (b)) - ((a) < (b)))
+#define SIMPLE_FLOAT_CMP(a, b) \
+	(isnan(a) ? (isnan(b) ? 0 : 1) : (isnan(b) ? -1 : SIMPLE_CMP(a, b)))
+
+/*
+ * Check a batch qual over the rows of the batch, clearing the keep flags
+ * of those failing it.  The values of the column are first laid out as an
+ * array of integers or doubles, then compared with the constant, each of
+ * these loops working over contiguous arrays without branches, so that the
+ * compiler can vectorize them.
+ */
+static void
+simpleEvalBatchQual(SimpleFdwExecutionState *festate, SimpleBatchQual *qual)
+{
+	Datum	   *values = &festate->batch_values[qual->column * festate->fetch_size];
+	bool	   *nulls = &festate->batch_nulls[qual->column * festate->fetch_size];
+	bool	   *keep = festate->batch_keep;
+	int64	   *ints = festate->batch_ints;
+	double	   *floats = festate->batch_floats;
+	int			nrows = festate->batch_rows;
+	int			mask = qual->cmpmask;
+	int			row;
+
+	/*
+	 * The values of NULL entries are (Datum) 0, which is not a pointer to
+	 * follow when 64-bit values are passed by reference; whatever is read
+	 * for them is ignored in the end.
+	 */
+	switch (qual->coltype)
+	{
+		case INT2OID:
+			for (row = 0; row < nrows; row++)
+				ints[row] = DatumGetInt16(values[row]);
+			break;
+		case INT4OID:
+			for (row = 0; row < nrows; row++)
+				ints[row] = DatumGetInt32(values[row]);
+			break;
+		case INT8OID:
+			for (row = 0; row < nrows; row++)
+				ints[row] = nulls[row] ? 0 : DatumGetInt64(values[row]);
+			break;
+		case FLOAT4OID:
+			for (row = 0; row < nrows; row++)
+				floats[row] = DatumGetFloat4(values[row]);
+			break;
+		case FLOAT8OID:
+			for (row = 0; row < nrows; row++)
+				floats[row] = nulls[row] ? 0 : DatumGetFloat8(values[row]);
+			break;
+		default:
+			elog(ERROR, "unexpected type of batch qual column: %u",
+				 qual->coltype);
+	}
+
+	/* Integers compared as floats, as cast by the qual */
+	if (qual->coltype != FLOAT4OID && qual->coltype != FLOAT8OID)
+	{
+		if (qual->cmptype == FLOAT8OID)
+			for (row = 0; row < nrows; row++)
+				floats[row] = (double) ints[row];
+		else if (qual->cmptype == FLOAT4OID)
+			for (row = 0; row < nrows; row++)
+				floats[row] = (float4) ints[row];
+	}
+
+	if (qual->cmptype == INT8OID)
+	{
+		int64		ival = qual->ival;
+
+		for (row = 0; row < nrows; row++)
+		{
+			int			cmp = SIMPLE_CMP(ints[row], ival);
+
+			keep[row] &= !nulls[row] & ((mask >> (cmp + 1)) & 1);
+		}
+	}
+	else
+	{
+		double		fval = qual->fval;
+
+		for (row = 0; row < nrows; row++)
+		{
+			int			cmp = SIMPLE_FLOAT_CMP(floats[row], fval);
+
+			keep[row] &= !nulls[row] & ((mask >> (cmp + 1)) & 1);
+		}
+	}
+}
+
+/*
+ * Get the statement of the scan ready to return its rows: prepare it, or
+ * get it from the cache, and bind the current values of its parameters.
+ */
+static void
+simpleExecuteQuery(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	MemoryContext oldcontext;
+
+	/*
+	 * Execute the query, if required, reusing a cached statement.  Its
+	 * counters are reset, so that EXPLAIN ANALYZE only shows this scan's.
+	 */
+	if (!festate->result)
+	{
+		SimpleStatsCounters conn_before = simple_connection_stats;
+
+		festate->result = simplePrepareStatement(festate->serverid, festate->query);
+		simpleStatsAccumConnection(&festate->stats, &conn_before);
+		sqlite3_stmt_status(festate->result, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+		sqlite3_stmt_status(festate->result, SQLITE_STMTSTATUS_SORT, 1);
+		sqlite3_stmt_status(festate->result, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+		sqlite3_stmt_status(festate->result, SQLITE_STMTSTATUS_VM_STEP, 1);
+	}
+
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+
+	/* Bind the current values of the parameters, if any */
+	if (!festate->params_bound)
+	{
+		int			x;
+
+		simpleEvalParams(node);
+		for (x = 0; x < festate->numParams; x++)
+			simpleBindParameter(festate->result, x + 1,
+								festate->param_types[x],
+								festate->param_values[x],
+								festate->param_nulls[x]);
+
+		festate->params_bound = true;
+	}
+
+#if (PG_VERSION_NUM >= 110000)
+	/* A parallel scan starts with the first chunk it can claim */
+	if (festate->parallel && !festate->chunk_bound)
+	{
+		if (!simpleClaimChunk(festate))
+			festate->eof_reached = true;
+		festate->chunk_bound = true;
+	}
+#endif
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Evaluate the current values of the parameters of the query, if not done
+ * yet since the scan started.  They live in the context of the batch.
+ */
+static void
+simpleEvalParams(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+	int			x = 0;
+
+	if (festate->params_evaluated)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+
+	foreach(lc, festate->param_exprs)
+	{
+		ExprState  *expr_state = (ExprState *) lfirst(lc);
+
+#if (PG_VERSION_NUM >= 100000)
+		festate->param_values[x] = ExecEvalExpr(expr_state, econtext,
+												&festate->param_nulls[x]);
+#else
+		festate->param_values[x] = ExecEvalExpr(expr_state, econtext,
+												&festate->param_nulls[x], NULL);
+#endif
+		x++;
+	}
+
+	festate->params_evaluated = true;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Get the database file of a server whose scan results are cached, NULL if
+ * the server doesn't have the result_cache option.
+ */
+static char *
+simpleGetResultCacheDatabase(Oid serverid)
+{
+	ForeignServer *server = GetForeignServer(serverid);
+	char	   *database = NULL;
+	bool		result_cache = false;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "database") == 0)
+			database = defGetString(def);
+		else if (strcmp(def->defname, "result_cache") == 0)
+			result_cache = defGetBoolean(def);
+	}
+
+	return result_cache ? database : NULL;
+}
+
+#if (PG_VERSION_NUM >= 110000)
+/*
+ * Claim the next chunk of rowids of a parallel scan, and bind its bounds
+ * to the query, which is restarted.  Returns false when all the chunks have
+ * been claimed.
+ */
+static bool
+simpleClaimChunk(SimpleFdwExecutionState *festate)
+{
+	SimpleParallelScanState *pscan = festate->pscan;
+	int64		start;
+	int64		end;
+
+	if (pscan == NULL)
+	{
+		/* No shared state: this participant is alone, read everything */
+		if (festate->whole_range_done)
+			return false;
+		festate->whole_range_done = true;
+		start = PG_INT64_MIN;
+		end = PG_INT64_MAX;
+	}
+	else
+	{
+		SpinLockAcquire(&pscan->mutex);
+		if (pscan->exhausted)
+		{
+			SpinLockRelease(&pscan->mutex);
+			return false;
+		}
+		start = pscan->next_rowid;
+		if (pscan->max_rowid - start < pscan->chunk_size)
+		{
+			end = pscan->max_rowid;
+			pscan->exhausted = true;
+		}
+		else
+		{
+			end = start + pscan->chunk_size - 1;
+			pscan->next_rowid = end + 1;
+		}
+		SpinLockRelease(&pscan->mutex);
+	}
+
+	/* The other parameters keep their values across the reset */
+	sqlite3_reset(festate->result);
+	if (sqlite3_bind_int64(festate->result, festate->numParams + 1, start) != SQLITE_OK ||
+		sqlite3_bind_int64(festate->result, festate->numParams + 2, end) != SQLITE_OK)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("could not bind the rowid range: %s",
+				   sqlite3_errmsg(festate->conn))
+			));
+
+	return true;
+}
+#endif
+
+/*
+ * Restart the scan from the beginning.  Resetting the statement is enough
+ * for SQLite to run it again, there's no need to prepare it again.  The
+ * parameters are bound again before the next row is fetched, as the outer
+ * values may have changed.
+ */
+static void
+simpleReScanForeignScan(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+#if (PG_VERSION_NUM >= 140000)
+	/* Get the statement back from the fetcher */
+	if (festate->fetcher != NULL)
+		simpleAsyncWait(festate->fetcher);
+#endif
+
+	/* If we haven't executed the query yet, there's nothing to do */
+	if (festate->result)
+		sqlite3_reset(festate->result);
+	festate->params_evaluated = false;
+	festate->params_bound = false;
+
+	/* The result is looked up again, with the new parameters */
+	if (festate->cache != NULL)
+		simpleCacheRestart(festate->cache);
+
+	/* Forget the rows prefetched so far */
+	festate->batch_rows = 0;
+	festate->batch_nsel = 0;
+	festate->next_row = 0;
+	festate->eof_reached = false;
+
+#if (PG_VERSION_NUM >= 110000)
+	/* A parallel scan claims a new chunk; the shared state is reset apart */
+	festate->chunk_bound = false;
+	festate->whole_range_done = false;
+#endif
+}
+
+static void
+simpleEndForeignScan(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	if (festate->track_stats)
+		simpleReportScanStats(node);
+
+#if (PG_VERSION_NUM >= 140000)
+	/* Stop the fetcher before its statement goes back to the cache */
+	if (festate->fetcher != NULL)
+	{
+		simpleAsyncDestroy(festate->fetcher);
+		festate->fetcher = NULL;
+	}
+#endif
+
+	/* Give the statement back to the cache */
+	if (festate->result)
+	{
+		simpleReleaseStatement(festate->serverid, festate->result);
+		festate->result = NULL;
+	}
+
+	/* The connection stays open in the cache, for the next scans */
+	festate->conn = NULL;
+
+	if (festate->query)
+	{
+		pfree(festate->query);
+		festate->query = 0;
+	}
+
+}
+
+/*
+ * Show the query sent to SQLite.  VERBOSE adds SQLite's plan of the query,
+ * and ANALYZE what the scan did: the rows fetched, the time spent in SQLite
+ * and converting the values, and the counters of the statement.  The time
+ * spent in SQLite isn't measured for asynchronous scans, whose rows are
+ * fetched by another thread.
+ */
+#if (PG_VERSION_NUM >= 110000)
+#define simpleExplainInteger(label, value, es) \
+	ExplainPropertyInteger(label, NULL, value, es)
+#define simpleExplainTime(label, value, es) \
+	ExplainPropertyFloat(label, "ms", value, 3, es)
+#else
+#define simpleExplainInteger(label, value, es) \
+	ExplainPropertyLong(label, (long) (value), es)
+#define simpleExplainTime(label, value, es) \
+	ExplainPropertyFloat(label, value, 3, es)
+#endif
+
+static void
+simpleExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	char	   *sql;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+#if (PG_VERSION_NUM >= 90500)
+	/* Show the batch quals like plan quals, their Vars having varno 1 */
+	if (festate->nbatch_quals > 0)
+	{
+		Relation	rel = node->ss.ss_currentRelation;
+		List	   *quals = (List *) list_nth(fsplan->fdw_private,
+											  FdwScanPrivateBatchQuals);
+		List	   *context;
+
+		context = deparse_context_for(RelationGetRelationName(rel),
+									  RelationGetRelid(rel));
+		ExplainPropertyText("Batch Filter",
+							deparse_expression((Node *) make_ands_explicit(quals),
+											   context, false, false),
+							es);
+	}
+#endif
+
+	sql = strVal(list_nth(fsplan->fdw_private, FdwScanPrivateSelectSql));
+	ExplainPropertyText("SQLite query", sql, es);
+
+	if (es->verbose)
+	{
+		sqlite3_stmt *stmt;
+		char	   *explain = psprintf("EXPLAIN QUERY PLAN %s", sql);
+		List	   *plan = NIL;
+
+		/* The detail is the fourth column, whatever the SQLite version */
+		if (sqlite3_prepare_v2(festate->conn, explain, -1, &stmt, NULL) == SQLITE_OK)
+		{
+			while (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				const char *detail = (const char *) sqlite3_column_text(stmt, 3);
+
+				if (detail)
+					plan = lappend(plan, pstrdup(detail));
+			}
+			sqlite3_finalize(stmt);
+		}
+		pfree(explain);
+
+		ExplainPropertyList("SQLite plan", plan, es);
+	}
+
+	if (es->analyze)
+	{
+		simpleExplainInteger("SQLite rows fetched", festate->rows_fetched, es);
+		if (festate->nbatch_quals > 0)
+			simpleExplainInteger("Rows Removed by Batch Filter",
+								 festate->rows_filtered, es);
+		if (festate->cache != NULL)
+			ExplainPropertyText("Result cache",
+								simpleCacheStatus(festate->cache), es);
+		if (festate->track_timing)
+		{
+			simpleExplainTime("SQLite step time",
+							  INSTR_TIME_GET_MILLISEC(festate->step_time), es);
+			simpleExplainTime("Conversion time",
+							  INSTR_TIME_GET_MILLISEC(festate->convert_time), es);
+		}
+		if (festate->result)
+		{
+			simpleExplainInteger("SQLite full scan steps",
+								 sqlite3_stmt_status(festate->result,
+													 SQLITE_STMTSTATUS_FULLSCAN_STEP, 0),
+								 es);
+			simpleExplainInteger("SQLite sorts",
+								 sqlite3_stmt_status(festate->result,
+													 SQLITE_STMTSTATUS_SORT, 0),
+								 es);
+			simpleExplainInteger("SQLite automatic indexes",
+								 sqlite3_stmt_status(festate->result,
+													 SQLITE_STMTSTATUS_AUTOINDEX, 0),
+								 es);
+			simpleExplainInteger("SQLite VM steps",
+								 sqlite3_stmt_status(festate->result,
+													 SQLITE_STMTSTATUS_VM_STEP, 0),
+								 es);
+		}
+	}
+}
+
+/*
+ * Add the statistics of a scan to the shared ones of its foreign table.  A
+ * pushed down join or aggregate is counted for each of its tables.
+ */
+static void
+simpleReportScanStats(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	SimpleStatsCounters *stats = &festate->stats;
+
+	stats->scans = 1;
+	stats->remote_scans = (fsplan->scan.plan.qual == NIL &&
+						   festate->nbatch_quals == 0) ? 1 : 0;
+	stats->rows = festate->rows_fetched;
+	stats->step_time = INSTR_TIME_GET_MILLISEC(festate->step_time);
+	stats->convert_time = INSTR_TIME_GET_MILLISEC(festate->convert_time);
+
+#if (PG_VERSION_NUM >= 120000)
+	if (fsplan->scan.scanrelid == 0)
+	{
+		EState	   *estate = node->ss.ps.state;
+#if (PG_VERSION_NUM >= 160000)
+		Bitmapset  *relids = fsplan->fs_base_relids;
+#else
+		Bitmapset  *relids = fsplan->fs_relids;
+#endif
+		int			rti = -1;
+
+		stats->pushed_scans = 1;
+		while ((rti = bms_next_member(relids, rti)) >= 0)
+			simpleStatsReport(exec_rt_fetch(rti, estate)->relid, stats);
+		return;
+	}
+#endif
+
+	simpleStatsReport(RelationGetRelid(node->ss.ss_currentRelation), stats);
+}
+
+/*
+ * Returns true if the statement being planned changes a foreign table of
+ * the given server, at this query level or one above it.
+ */
+static bool
+simpleModifiesServer(PlannerInfo *root, Oid serverid)
+{
+#if (PG_VERSION_NUM >= 140000)
+	for (; root != NULL; root = root->parent_root)
+	{
+		int			rti = -1;
+
+		while ((rti = bms_next_member(root->all_result_relids, rti)) >= 0)
+		{
+			RangeTblEntry *rte = planner_rt_fetch(rti, root);
+
+			if (rte->relkind == RELKIND_FOREIGN_TABLE &&
+				GetForeignTable(rte->relid)->serverid == serverid)
+				return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
+#if (PG_VERSION_NUM >= 110000)
+/*
+ * Foreign scans can run in parallel workers: each worker opens its own
+ * SQLite connection.  That connection doesn't see what the SQLite
+ * transaction of the leader changed and didn't commit yet, nor does it
+ * share the snapshot of a WAL database it read, so the scans of a server
+ * are done by the leader only once a SQLite transaction is open on it, or
+ * when the statement itself changes its tables.
+ */
+static bool
+simpleIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
+								RangeTblEntry *rte)
+{
+	elog(DEBUG1,"entering function %s",__func__);
+
+	if (simpleInTransaction(rel->serverid))
+		return false;
+
+	return !simpleModifiesServer(root, rel->serverid);
+}
+
+static Size
+simpleEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt)
+{
+	elog(DEBUG1,"entering function %s",__func__);
+
+	return sizeof(SimpleParallelScanState);
+}
+
+/*
+ * Set up the shared state of a parallel scan, in the leader: get the range
+ * of the rowids of the table, and choose a chunk size giving each
+ * participant many chunks, so that they finish at about the same time.
+ */
+static void
+simpleInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	SimpleParallelScanState *pscan = (SimpleParallelScanState *) coordinate;
+	char	   *svr_database = NULL;
+	char	   *svr_table = NULL;
+	char	   *query;
+	sqlite3_stmt *stmt;
+	double		span;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	simpleGetOptions(RelationGetRelid(node->ss.ss_currentRelation),
+					 &svr_database, &svr_table);
+
+	SpinLockInit(&pscan->mutex);
+	pscan->exhausted = true;
+	pscan->min_rowid = 0;
+	pscan->max_rowid = 0;
+
+	query = psprintf("SELECT min(rowid), max(rowid) FROM %s", svr_table);
+	if (sqlite3_prepare_v2(festate->conn, query, -1, &stmt, NULL) != SQLITE_OK)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("SQL error during prepare: %s %s",
+				   sqlite3_errmsg(festate->conn), query)
+			));
+
+	/* An empty table has no rowid range, and nothing to claim */
+	if (sqlite3_step(stmt) == SQLITE_ROW &&
+		sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+	{
+		pscan->min_rowid = sqlite3_column_int64(stmt, 0);
+		pscan->max_rowid = sqlite3_column_int64(stmt, 1);
+		pscan->exhausted = false;
+	}
+	sqlite3_finalize(stmt);
+	pfree(query);
+
+	span = (double) pscan->max_rowid - (double) pscan->min_rowid + 1;
+	pscan->chunk_size = (int64) Max(span / ((pcxt->nworkers + 1) * 16),
+									SIMPLE_PARALLEL_MIN_CHUNK);
+	pscan->next_rowid = pscan->min_rowid;
+
+	festate->pscan = pscan;
+}
+
+/*
+ * Reset the shared state before a rescan.  The range of rowids found for
+ * the first scan is kept.
+ */
+static void
+simpleReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+								 void *coordinate)
 {
-	sqlite3                  *db;
-	SimpleFdwExecutionState  *festate;
-	char                     *svr_database = NULL;
-	char                     *svr_table = NULL;
-	char                     *query;
-    size_t                   len;
+	SimpleParallelScanState *pscan = (SimpleParallelScanState *) coordinate;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	SpinLockAcquire(&pscan->mutex);
+	pscan->next_rowid = pscan->min_rowid;
+	pscan->exhausted = (pscan->max_rowid < pscan->min_rowid);
+	SpinLockRelease(&pscan->mutex);
+}
+
+static void
+simpleInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc,
+								  void *coordinate)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	festate->pscan = (SimpleParallelScanState *) coordinate;
+}
+#endif
+
+/*
+ * The rows of a SQLite table are identified by their rowid, which is
+ * carried in the ctid of the tuples, in 48 bits.  That's enough for the
+ * rowids SQLite assigns, but not for every value of an INTEGER PRIMARY
+ * KEY, which is the rowid: such tables need a key column to be changed.
+ */
+#define SIMPLE_MAX_ROWID	((INT64CONST(1) << 48) - 1)
+
+static void
+simpleRowidToItemPointer(int64 rowid, ItemPointer tid)
+{
+	if (rowid < 0 || rowid > SIMPLE_MAX_ROWID)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_INVALID_DATA_TYPE),
+			errmsg("rowid " INT64_FORMAT " can't be stored in a ctid", rowid),
+			errhint("Set the option key 'true' on the column of the INTEGER PRIMARY KEY of the table, so that its rows are found by their key.")
+			));
+
+	ItemPointerSetBlockNumber(tid, (BlockNumber) (rowid >> 16));
+	ItemPointerSetOffsetNumber(tid, (OffsetNumber) (rowid & 0xFFFF));
+}
+
+#if (PG_VERSION_NUM >= 140000)
+static int64
+simpleItemPointerGetRowid(ItemPointer tid)
+{
+	return ((int64) ItemPointerGetBlockNumberNoCheck(tid) << 16) |
+		ItemPointerGetOffsetNumberNoCheck(tid);
+}
+
+/*
+ * Get the key columns of a foreign table, given by the key column option.
+ */
+static List *
+simpleGetKeyAttrs(Relation rel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	List	   *keyAttrs = NIL;
+	int			attnum;
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		if (!TupleDescAttr(tupdesc, attnum - 1)->attisdropped &&
+			simpleIsKeyColumn(RelationGetRelid(rel), attnum))
+			keyAttrs = lappend_int(keyAttrs, attnum);
+	}
+
+	return keyAttrs;
+}
+
+/*
+ * Name of the junk column holding the value of a key column, for an
+ * UPDATE or a DELETE.
+ */
+static char *
+simpleKeyJunkName(AttrNumber attnum)
+{
+	return psprintf("simple_key%d", attnum);
+}
+
+/*
+ * Add the columns identifying the rows to the columns fetched for an
+ * UPDATE or a DELETE: the key columns when the foreign table has some,
+ * which views and WITHOUT ROWID tables need, or else the ctid, which
+ * holds the rowid.
+ */
+static void
+simpleAddForeignUpdateTargets(PlannerInfo *root,
+							  Index rtindex,
+							  RangeTblEntry *target_rte,
+							  Relation target_relation)
+{
+	List	   *keyAttrs = simpleGetKeyAttrs(target_relation);
+	Var		   *var;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	if (keyAttrs != NIL)
+	{
+		TupleDesc	tupdesc = RelationGetDescr(target_relation);
+		ListCell   *lc;
+
+		foreach(lc, keyAttrs)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+
+			var = makeVar(rtindex,
+						  lfirst_int(lc),
+						  attr->atttypid,
+						  attr->atttypmod,
+						  attr->attcollation,
+						  0);
+
+			add_row_identity_var(root, var, rtindex,
+								 simpleKeyJunkName(lfirst_int(lc)));
+		}
+		return;
+	}
+
+	var = makeVar(rtindex,
+				  SelfItemPointerAttributeNumber,
+				  TIDOID,
+				  -1,
+				  InvalidOid,
+				  0);
+
+	add_row_identity_var(root, var, rtindex, "ctid");
+}
+
+/*
+ * Build the statement run for each row of an INSERT, UPDATE or DELETE.
+ * UPDATE and DELETE find their row by its key columns, or its rowid.
+ */
+static List *
+simplePlanForeignModify(PlannerInfo *root,
+						ModifyTable *plan,
+						Index resultRelation,
+						int subplan_index)
+{
+	CmdType		operation = plan->operation;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	Relation	rel;
+	TupleDesc	tupdesc;
+	StringInfoData sql;
+	List	   *targetAttrs = NIL;
+	List	   *keyAttrs = NIL;
+	bool		doNothing = false;
+	int			values_end_len = -1;
+	char	   *svr_database = NULL;
+	char	   *svr_table = NULL;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	if (plan->returningLists)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("RETURNING is not supported for SQLite tables")
+			));
+
+	if (plan->onConflictAction == ONCONFLICT_NOTHING)
+		doNothing = true;
+	else if (plan->onConflictAction != ONCONFLICT_NONE)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("ON CONFLICT DO UPDATE is not supported for SQLite tables")
+			));
+
+	simpleGetOptions(rte->relid, &svr_database, &svr_table);
+
+	/*
+	 * Core code already has some lock on each rel being planned, so we can
+	 * use NoLock here.
+	 */
+	rel = table_open(rte->relid, NoLock);
+	tupdesc = RelationGetDescr(rel);
+
+	if (operation == CMD_UPDATE || operation == CMD_DELETE)
+		keyAttrs = simpleGetKeyAttrs(rel);
+
+	/*
+	 * An INSERT sends all the columns, an UPDATE only the updated ones.
+	 * Generated columns are left to SQLite.
+	 */
+	if (operation == CMD_INSERT)
+		targetAttrs = simpleGetInsertAttrs(rel);
+	else if (operation == CMD_UPDATE)
+	{
+#if (PG_VERSION_NUM >= 160000)
+		Bitmapset  *allUpdatedCols = get_rel_all_updated_cols(root,
+															  find_base_rel(root, resultRelation));
+#else
+		Bitmapset  *allUpdatedCols = bms_union(rte->updatedCols,
+											   rte->extraUpdatedCols);
+#endif
+		int			col = -1;
+
+		while ((col = bms_next_member(allUpdatedCols, col)) >= 0)
+		{
+			AttrNumber	attnum = col + FirstLowInvalidHeapAttributeNumber;
+
+			if (attnum <= InvalidAttrNumber)	/* shouldn't happen */
+				elog(ERROR, "system-column update is not supported");
+			if (TupleDescAttr(tupdesc, attnum - 1)->attgenerated)
+				continue;
+			targetAttrs = lappend_int(targetAttrs, attnum);
+		}
+	}
+
+	initStringInfo(&sql);
+	switch (operation)
+	{
+		case CMD_INSERT:
+			simpleDeparseInsertSql(&sql, rel, svr_table, targetAttrs,
+								   doNothing, &values_end_len);
+			break;
+		case CMD_UPDATE:
+			simpleDeparseUpdateSql(&sql, rel, svr_table, targetAttrs,
+								   keyAttrs);
+			break;
+		case CMD_DELETE:
+			simpleDeparseDeleteSql(&sql, rel, svr_table, keyAttrs);
+			break;
+		default:
+			elog(ERROR, "unexpected operation: %d", (int) operation);
+			break;
+	}
+
+	table_close(rel, NoLock);
+
+	elog(DEBUG1, "simple_fdw: remote statement is: %s", sql.data);
+
+	/* The order of the items must match enum FdwModifyPrivateIndex */
+	return list_make4(makeString(sql.data),
+					  targetAttrs,
+					  makeInteger(values_end_len),
+					  keyAttrs);
+}
+
+/*
+ * Get the batch size of a foreign table: the table's batch_size option,
+ * or the server's.
+ */
+static int
+simpleGetBatchSize(Relation rel)
+{
+	ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+	ForeignServer *server = GetForeignServer(table->serverid);
+	int			batch_size = DEFAULT_BATCH_SIZE;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = atoi(defGetString(def));
+	}
+
+	return batch_size;
+}
+
+/*
+ * Get the columns an INSERT sends to SQLite: all of them, but the
+ * generated ones, which are left to SQLite.
+ */
+static List *
+simpleGetInsertAttrs(Relation rel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	List	   *targetAttrs = NIL;
+	int			attnum;
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+
+		if (!attr->attisdropped && !attr->attgenerated)
+			targetAttrs = lappend_int(targetAttrs, attnum);
+	}
+
+	return targetAttrs;
+}
+
+/*
+ * Create the execution state of a modification, from the items built by
+ * simplePlanForeignModify, and make sure a SQLite transaction is open.
+ */
+static SimpleFdwModifyState *
+simpleCreateModifyState(EState *estate,
+						Relation rel,
+						CmdType operation,
+						List *fdw_private)
+{
+	SimpleFdwModifyState *fmstate;
+
+	fmstate = (SimpleFdwModifyState *) palloc0(sizeof(SimpleFdwModifyState));
+	fmstate->rel = rel;
+	fmstate->serverid = GetForeignTable(RelationGetRelid(rel))->serverid;
+	fmstate->conn = simpleGetConnection(fmstate->serverid);
+
+	/* The changes are made in a SQLite transaction, see connection.c */
+	simpleBeginTransaction(fmstate->serverid);
+
+	fmstate->query = strVal(list_nth(fdw_private, FdwModifyPrivateUpdateSql));
+	fmstate->target_attrs = (List *) list_nth(fdw_private,
+											  FdwModifyPrivateTargetAttnums);
+	fmstate->values_end = intVal(list_nth(fdw_private, FdwModifyPrivateLen));
+	fmstate->key_attrs = (List *) list_nth(fdw_private,
+										   FdwModifyPrivateKeyAttnums);
+	fmstate->p_nums = list_length(fmstate->target_attrs);
+
+	if (operation == CMD_INSERT)
+		fmstate->batch_size = simpleGetBatchSize(rel);
+	else
+		fmstate->batch_size = 1;
+
+	fmstate->stmt = NULL;
+	fmstate->stmt_rows = 0;
+
+	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "simple_fdw temporary data",
+											  ALLOCSET_SMALL_SIZES);
+
+	return fmstate;
+}
+
+static void
+simpleBeginForeignModify(ModifyTableState *mtstate,
+						 ResultRelInfo *rinfo,
+						 List *fdw_private,
+						 int subplan_index,
+						 int eflags)
+{
+	SimpleFdwModifyState *fmstate;
+	CmdType		operation = mtstate->operation;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/*
+	 * Do nothing in EXPLAIN (no ANALYZE) case.  rinfo->ri_FdwState stays
+	 * NULL.
+	 */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	fmstate = simpleCreateModifyState(mtstate->ps.state,
+									  rinfo->ri_RelationDesc,
+									  operation, fdw_private);
+
+	/*
+	 * UPDATE and DELETE find their row with the key junk columns, or the
+	 * ctid one.
+	 */
+	if (operation == CMD_UPDATE || operation == CMD_DELETE)
+	{
+		Plan	   *subplan = outerPlanState(mtstate)->plan;
+
+		if (fmstate->key_attrs != NIL)
+		{
+			ListCell   *lc;
+			int			i = 0;
+
+			fmstate->keyAttnos = (AttrNumber *)
+				palloc(sizeof(AttrNumber) * list_length(fmstate->key_attrs));
+			foreach(lc, fmstate->key_attrs)
+			{
+				char	   *name = simpleKeyJunkName(lfirst_int(lc));
+
+				fmstate->keyAttnos[i] = ExecFindJunkAttributeInTlist(subplan->targetlist,
+																	 name);
+				if (!AttributeNumberIsValid(fmstate->keyAttnos[i]))
+					elog(ERROR, "could not find junk %s column", name);
+				i++;
+			}
+		}
+		else
+		{
+			fmstate->ctidAttno = ExecFindJunkAttributeInTlist(subplan->targetlist,
+															  "ctid");
+			if (!AttributeNumberIsValid(fmstate->ctidAttno))
+				elog(ERROR, "could not find junk ctid column");
+		}
+	}
+
+	rinfo->ri_FdwState = fmstate;
+}
+
+static TupleTableSlot *
+simpleExecForeignInsert(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot)
+{
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	rslot = simpleExecuteModify(rinfo, CMD_INSERT,
+								&slot, &planSlot, &numSlots);
+
+	return rslot ? *rslot : NULL;
+}
+
+static TupleTableSlot **
+simpleExecForeignBatchInsert(EState *estate,
+							 ResultRelInfo *rinfo,
+							 TupleTableSlot **slots,
+							 TupleTableSlot **planSlots,
+							 int *numSlots)
+{
+	elog(DEBUG1,"entering function %s",__func__);
+
+	return simpleExecuteModify(rinfo, CMD_INSERT,
+							   slots, planSlots, numSlots);
+}
+
+/*
+ * Number of rows inserted by a single INSERT statement.  Rows are inserted
+ * one at a time when they have to be seen by triggers or checks after
+ * each insertion, and a batch can't have more parameters than SQLite
+ * accepts in a statement.
+ */
+static int
+simpleGetForeignModifyBatchSize(ResultRelInfo *rinfo)
+{
+	SimpleFdwModifyState *fmstate = (SimpleFdwModifyState *) rinfo->ri_FdwState;
+	int			batch_size;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/* should be called only once */
+	Assert(rinfo->ri_BatchSize == 0);
+
+	if (fmstate)
+		batch_size = fmstate->batch_size;
+	else
+		batch_size = simpleGetBatchSize(rinfo->ri_RelationDesc);
+
+	if (rinfo->ri_projectReturning != NULL ||
+		rinfo->ri_WithCheckOptions != NIL ||
+		(rinfo->ri_TrigDesc &&
+		 (rinfo->ri_TrigDesc->trig_insert_before_row ||
+		  rinfo->ri_TrigDesc->trig_insert_after_row)))
+		return 1;
+
+	/* An INSERT of DEFAULT VALUES can't insert several rows */
+	if (fmstate && fmstate->p_nums == 0)
+		return 1;
+
+	if (fmstate)
+	{
+		int			max_params = sqlite3_limit(fmstate->conn,
+											   SQLITE_LIMIT_VARIABLE_NUMBER,
+											   -1);
+
+		batch_size = Max(1, Min(batch_size, max_params / fmstate->p_nums));
+	}
+
+	return batch_size;
+}
+
+static TupleTableSlot *
+simpleExecForeignUpdate(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot)
+{
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	rslot = simpleExecuteModify(rinfo, CMD_UPDATE,
+								&slot, &planSlot, &numSlots);
+
+	return rslot ? *rslot : NULL;
+}
+
+static TupleTableSlot *
+simpleExecForeignDelete(EState *estate,
+						ResultRelInfo *rinfo,
+						TupleTableSlot *slot,
+						TupleTableSlot *planSlot)
+{
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	rslot = simpleExecuteModify(rinfo, CMD_DELETE,
+								&slot, &planSlot, &numSlots);
+
+	return rslot ? *rslot : NULL;
+}
+
+static void
+simpleEndForeignModify(EState *estate,
+					   ResultRelInfo *rinfo)
+{
+	SimpleFdwModifyState *fmstate = (SimpleFdwModifyState *) rinfo->ri_FdwState;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/* If fmstate is NULL, we are in EXPLAIN; nothing to do */
+	if (fmstate == NULL)
+		return;
+
+	/* Give the statement back to the cache */
+	if (fmstate->stmt)
+	{
+		simpleReleaseStatement(fmstate->serverid, fmstate->stmt);
+		fmstate->stmt = NULL;
+	}
+	fmstate->conn = NULL;
+}
+
+/*
+ * Tables of a server opened read-only, or immutable, can't be modified,
+ * and neither can queries.
+ */
+static int
+simpleIsForeignRelUpdatable(Relation rel)
+{
+	ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+	ForeignServer *server = GetForeignServer(table->serverid);
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "query") == 0)
+			return 0;
+	}
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if ((strcmp(def->defname, "readonly") == 0 ||
+			 strcmp(def->defname, "immutable") == 0) &&
+			defGetBoolean(def))
+			return 0;
+	}
+
+	return (1 << CMD_INSERT) | (1 << CMD_UPDATE) | (1 << CMD_DELETE);
+}
+
+/*
+ * Prepare to insert the rows of a COPY FROM, or the rows routed to a
+ * foreign partition.
+ *
+ * The rows go through the INSERT statement of a modification, as if
+ * planned by simplePlanForeignModify, reused for all of them within the
+ * SQLite transaction.  For COPY FROM, the fast_bulk_load option of the
+ * server also relaxes the durability of SQLite until the end of the
+ * transaction.
+ */
+static void
+simpleBeginForeignInsert(ModifyTableState *mtstate,
+						 ResultRelInfo *rinfo)
+{
+	ModifyTable *plan = castNode(ModifyTable, mtstate->ps.plan);
+	EState	   *estate = mtstate->ps.state;
+	Relation	rel = rinfo->ri_RelationDesc;
+	ForeignServer *server;
+	StringInfoData sql;
+	List	   *targetAttrs;
+	bool		doNothing = false;
+	int			values_end_len;
+	char	   *svr_database = NULL;
+	char	   *svr_table = NULL;
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/*
+	 * If the foreign table we are about to insert routed rows into is also
+	 * an UPDATE subplan result rel that will be updated later, proceeding
+	 * with the INSERT will result in the later UPDATE incorrectly modifying
+	 * those routed rows, so prevent the INSERT.
+	 */
+	if (plan && plan->operation == CMD_UPDATE && rinfo->ri_FdwState)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("cannot route tuples into foreign table to be updated \"%s\"",
+				   RelationGetRelationName(rel))
+			));
+
+	if (plan && plan->returningLists)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("RETURNING is not supported for SQLite tables")
+			));
+
+	if (plan && plan->onConflictAction == ONCONFLICT_NOTHING)
+		doNothing = true;
+	else if (plan && plan->onConflictAction != ONCONFLICT_NONE)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("ON CONFLICT DO UPDATE is not supported for SQLite tables")
+			));
+
+	simpleGetOptions(RelationGetRelid(rel), &svr_database, &svr_table);
+
+	targetAttrs = simpleGetInsertAttrs(rel);
+	initStringInfo(&sql);
+	simpleDeparseInsertSql(&sql, rel, svr_table, targetAttrs,
+						   doNothing, &values_end_len);
+
+	elog(DEBUG1, "simple_fdw: remote statement is: %s", sql.data);
+
+	/* COPY FROM has no plan */
+	server = GetForeignServer(GetForeignTable(RelationGetRelid(rel))->serverid);
+	if (plan == NULL)
+	{
+		foreach(lc, server->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			/* This has to happen before the SQLite transaction starts */
+			if (strcmp(def->defname, "fast_bulk_load") == 0 &&
+				defGetBoolean(def))
+			{
+				simpleGetConnection(server->serverid);
+				simpleBeginBulkLoad(server->serverid);
+			}
+		}
+	}
+
+	rinfo->ri_FdwState = simpleCreateModifyState(estate, rel, CMD_INSERT,
+												 list_make4(makeString(sql.data),
+															targetAttrs,
+															makeInteger(values_end_len),
+															NIL));
+}
 
+static void
+simpleEndForeignInsert(EState *estate,
+					   ResultRelInfo *rinfo)
+{
 	elog(DEBUG1,"entering function %s",__func__);
 
-	/* Fetch options  */
-	simpleGetOptions(RelationGetRelid(node->ss.ss_currentRelation), &svr_database, &svr_table);
+	simpleEndForeignModify(estate, rinfo);
+}
+
+/*
+ * Run the statement of a modification for the given rows: several rows for
+ * a batch of inserts, a single one otherwise.  Returns the slots of the
+ * rows, with *numSlots set to the number of rows actually changed, or NULL
+ * if an UPDATE or DELETE found no row.
+ */
+static TupleTableSlot **
+simpleExecuteModify(ResultRelInfo *rinfo,
+					CmdType operation,
+					TupleTableSlot **slots,
+					TupleTableSlot **planSlots,
+					int *numSlots)
+{
+	SimpleFdwModifyState *fmstate = (SimpleFdwModifyState *) rinfo->ri_FdwState;
+	TupleDesc	tupdesc = RelationGetDescr(fmstate->rel);
+	MemoryContext oldcontext;
+	int			idx = 1;
+	int			changes;
+	int			rc;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+
+	/*
+	 * Get the statement for this number of rows: the same one is used
+	 * until the last batch, which may be shorter.
+	 */
+	if (fmstate->stmt == NULL || fmstate->stmt_rows != *numSlots)
+	{
+		const char *sql = fmstate->query;
+
+		if (fmstate->stmt)
+		{
+			simpleReleaseStatement(fmstate->serverid, fmstate->stmt);
+			fmstate->stmt = NULL;
+		}
+
+		if (*numSlots > 1)
+		{
+			StringInfoData buf;
+
+			initStringInfo(&buf);
+			simpleRebuildInsertSql(&buf, fmstate->query, fmstate->values_end,
+								   fmstate->p_nums, *numSlots);
+			sql = buf.data;
+		}
+
+		fmstate->stmt = simplePrepareStatement(fmstate->serverid, sql);
+		fmstate->stmt_rows = *numSlots;
+	}
+
+	/* Bind the values of the target columns of each row */
+	for (i = 0; i < *numSlots; i++)
+	{
+		ListCell   *lc;
+
+		foreach(lc, fmstate->target_attrs)
+		{
+			int			attnum = lfirst_int(lc);
+			Datum		value;
+			bool		isnull;
+
+			value = slot_getattr(slots[i], attnum, &isnull);
+			simpleBindParameter(fmstate->stmt, idx++,
+								TupleDescAttr(tupdesc, attnum - 1)->atttypid,
+								value, isnull);
+		}
+	}
+
+	/* Bind the key values of the row to update or delete */
+	if ((operation == CMD_UPDATE || operation == CMD_DELETE) &&
+		fmstate->key_attrs != NIL)
+	{
+		ListCell   *lc;
+		int			i = 0;
+
+		foreach(lc, fmstate->key_attrs)
+		{
+			Datum		value;
+			bool		isnull;
+
+			value = ExecGetJunkAttribute(planSlots[0], fmstate->keyAttnos[i++],
+										 &isnull);
+			simpleBindParameter(fmstate->stmt, idx++,
+								TupleDescAttr(tupdesc, lfirst_int(lc) - 1)->atttypid,
+								value, isnull);
+		}
+	}
+	/* Or the rowid */
+	else if (operation == CMD_UPDATE || operation == CMD_DELETE)
+	{
+		Datum		datum;
+		bool		isnull;
+
+		datum = ExecGetJunkAttribute(planSlots[0], fmstate->ctidAttno,
+									 &isnull);
+		/* shouldn't ever get a null result... */
+		if (isnull)
+			elog(ERROR, "ctid is NULL");
+
+		if (sqlite3_bind_int64(fmstate->stmt, idx,
+							   simpleItemPointerGetRowid((ItemPointer) DatumGetPointer(datum))) != SQLITE_OK)
+			ereport(ERROR,
+				(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+				errmsg("could not bind the rowid: %s",
+					   sqlite3_errmsg(fmstate->conn))
+				));
+	}
+
+	rc = sqlite3_step(fmstate->stmt);
+	if (rc != SQLITE_DONE)
+	{
+		char	   *err = pstrdup(sqlite3_errmsg(fmstate->conn));
 
-	/* Connect to the server */
-	if (sqlite3_open(svr_database, &db)) {
+		sqlite3_reset(fmstate->stmt);
 		ereport(ERROR,
-			(errcode(ERRCODE_FDW_OUT_OF_MEMORY),
-			errmsg("Can't open sqlite database %s: %s", svr_database, sqlite3_errmsg(db))
+			(errcode(simpleSqliteErrcode(rc)),
+			errmsg("SQL error during modification: %s", err)
 			));
-		sqlite3_close(db);
 	}
+	changes = sqlite3_changes(fmstate->conn);
+	sqlite3_reset(fmstate->stmt);
 
-	/* Build the query */
-    len = strlen(svr_table) + 15;
-    query = (char *)palloc(len);
-    snprintf(query, len, "SELECT * FROM %s", svr_table);
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(fmstate->temp_cxt);
 
-	/* Stash away the state info we have already */
-	festate = (SimpleFdwExecutionState *) palloc(sizeof(SimpleFdwExecutionState));
-	node->fdw_state = (void *) festate;
-	festate->conn = db;
-	festate->result = NULL;
-	festate->query = query;
+	*numSlots = changes;
+
+	return (changes > 0) ? slots : NULL;
 }
+#endif
 
-static TupleTableSlot *
-simpleIterateForeignScan(ForeignScanState *node)
+#if (PG_VERSION_NUM >= 140000)
+/*
+ * Scans of base tables may run asynchronously under an Append, when
+ * enabled by the async_capable option: their batches are then fetched by
+ * a background thread, while the Append reads its other children.  This
+ * needs a thread-safe SQLite library.
+ */
+static bool
+simpleIsForeignPathAsyncCapable(ForeignPath *path)
+{
+	RelOptInfo *rel = path->path.parent;
+	SimpleFdwPlanState *fpinfo = (SimpleFdwPlanState *) rel->fdw_private;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	if (!IS_SIMPLE_REL(rel) || path->path.parallel_aware)
+		return false;
+
+	return fpinfo->async_capable && simpleAsyncSupported();
+}
+
+static void
+simpleForeignAsyncRequest(AsyncRequest *areq)
 {
-	char        **values;
-	HeapTuple   tuple;
-	int         x;
-    const char  *pzTail;
-    int         rc;
+	elog(DEBUG1,"entering function %s",__func__);
+
+	simpleProduceTupleAsync(areq);
+}
 
+/*
+ * Wait for the end of the batch being fetched, which the fetcher signals
+ * through its pipe.
+ */
+static void
+simpleForeignAsyncConfigureWait(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
 	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
-	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	AppendState *requestor = (AppendState *) areq->requestor;
 
 	elog(DEBUG1,"entering function %s",__func__);
 
-	/* Execute the query, if required */
-	if (!festate->result)
+	/* This is only called for a pending request, so there's a fetcher */
+	Assert(areq->callback_pending);
+	Assert(festate->fetcher != NULL);
+
+	AddWaitEventToSet(requestor->as_eventset, WL_SOCKET_READABLE,
+					  simpleAsyncGetFd(festate->fetcher), NULL, areq);
+}
+
+static void
+simpleForeignAsyncNotify(AsyncRequest *areq)
+{
+	elog(DEBUG1,"entering function %s",__func__);
+
+	simpleProduceTupleAsync(areq);
+}
+
+/*
+ * Produce the next tuple of an asynchronous scan, if one is available
+ * without waiting.  Otherwise, have the next batch fetched in the
+ * background, and mark the request as pending.
+ */
+static void
+simpleProduceTupleAsync(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+
+	for (;;)
+	{
+		/*
+		 * Without a fetcher, ExecProcNode fetches the rows synchronously.
+		 * Otherwise, it returns the rows of the current batch passing the
+		 * local conditions, and an empty slot once the batch is exhausted.
+		 */
+		if (festate->fetcher == NULL ||
+			festate->next_row < festate->batch_nsel)
+		{
+			TupleTableSlot *result = ExecProcNode((PlanState *) node);
+
+			if (!TupIsNull(result) || festate->fetcher == NULL)
+			{
+				ExecAsyncRequestDone(areq, TupIsNull(result) ? NULL : result);
+				return;
+			}
+		}
+
+		if (festate->eof_reached)
+		{
+			ExecAsyncRequestDone(areq, NULL);
+			return;
+		}
+
+		/* Go on with the batch fetched in the background, if it's ready */
+		if (simpleTakeAsyncBatch(node))
+			continue;
+
+		/* Otherwise, have it fetched, and wait for it */
+		simpleExecuteQuery(node);
+		if (festate->eof_reached)
+			continue;
+		simpleAsyncStart(festate->fetcher, festate->result);
+		ExecAsyncRequestPending(areq);
+		return;
+	}
+}
+
+/*
+ * Take the batch fetched in the background, if it's ready, converting its
+ * values into the prefetch buffer.  Returns false if it isn't ready yet.
+ */
+static bool
+simpleTakeAsyncBatch(ForeignScanState *node)
+{
+	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	sqlite3_value **values;
+	MemoryContext oldcontext;
+	int			nrows;
+	bool		eof;
+	int			row;
+	int			x;
+
+	instr_time	start;
+	instr_time	end;
+
+	if (!simpleAsyncTake(festate->fetcher, &values, &nrows, &eof))
+		return false;
+
+	if (festate->track_timing)
+		INSTR_TIME_SET_CURRENT(start);
+
+	MemoryContextReset(festate->temp_cxt);
+	oldcontext = MemoryContextSwitchTo(festate->temp_cxt);
+
+	for (x = 0; x < festate->ncolumns; x++)
+	{
+		for (row = 0; row < nrows; row++)
+		{
+			sqlite3_value *value = values[row * festate->ncolumns + x];
+
+			if (festate->track_stats)
+				festate->stats.bytes += sqlite3_value_bytes(value);
+
+			simpleDecodeValue(festate, x, x * festate->fetch_size + row, value);
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (festate->track_timing)
+	{
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(festate->convert_time, end, start);
+	}
+
+	festate->batch_rows = nrows;
+	festate->next_row = 0;
+	festate->eof_reached = eof;
+	festate->rows_fetched += nrows;
+
+	simpleFilterBatch(festate);
+
+	return true;
+}
+#endif
+
+#if (PG_VERSION_NUM >= 90500)
+/*
+ * Import the tables and views of a SQLite database.  SQLite has a single
+ * schema per database file, "main".
+ *
+ * The columns get the PostgreSQL types matching their declared SQLite
+ * types, following SQLite's rules for column affinities, so that their
+ * values are converted from their binary form rather than from text.
+ * The SQLite name of each column is kept in its column_name option.
+ */
+static List *
+simpleImportForeignSchema(ImportForeignSchemaStmt *stmt,
+						  Oid serverOid)
+{
+	ForeignServer *server = GetForeignServer(serverOid);
+	List	   *commands = NIL;
+	bool		import_not_null = true;
+	sqlite3    *db;
+	sqlite3_stmt *tables;
+	StringInfoData buf;
+	ListCell   *lc;
+
+	elog(DEBUG1,"entering function %s",__func__);
+
+	/* Parse statement options */
+	foreach(lc, stmt->options)
 	{
-		rc = sqlite3_prepare(festate->conn, festate->query, -1, &festate->result, &pzTail);
-		if (rc!=SQLITE_OK) {
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "import_not_null") == 0)
+			import_not_null = defGetBoolean(def);
+		else
 			ereport(ERROR,
-				(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
-				errmsg("SQL error during prepare: %s", sqlite3_errmsg(festate->conn))
+				(errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+				errmsg("invalid option \"%s\"", def->defname)
 				));
-			sqlite3_close(festate->conn);
-		}
 	}
 
-	ExecClearTuple(slot);
+	if (strcmp(stmt->remote_schema, "main") != 0)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_SCHEMA_NOT_FOUND),
+			errmsg("schema \"%s\" is not present on foreign server \"%s\"",
+				   stmt->remote_schema, server->servername),
+			errhint("The tables of a SQLite database are in schema \"main\".")
+			));
+
+	db = simpleGetConnection(serverOid);
+
+	if (sqlite3_prepare_v2(db,
+						   "SELECT name FROM sqlite_master "
+						   "WHERE type IN ('table', 'view') "
+						   "AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\' "
+						   "ORDER BY name",
+						   -1, &tables, NULL) != SQLITE_OK)
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("SQL error during prepare: %s", sqlite3_errmsg(db))
+			));
 
-	/* get the next record, if any, and fill in the slot */
-	if (sqlite3_step(festate->result) == SQLITE_ROW)
+	initStringInfo(&buf);
+	while (sqlite3_step(tables) == SQLITE_ROW)
 	{
-		/* Build the tuple */
-		values = (char **) palloc(sizeof(char *) * sqlite3_column_count(festate->result));
+		char	   *tablename = pstrdup((const char *) sqlite3_column_text(tables, 0));
+		const char *tableopt;
+		sqlite3_stmt *columns;
+		char	   *query;
+		bool		listed = false;
+		bool		first = true;
+		const char *p;
+
+		/* Apply LIMIT TO and EXCEPT */
+		foreach(lc, stmt->table_list)
+		{
+			RangeVar   *rv = (RangeVar *) lfirst(lc);
+
+			if (strcmp(rv->relname, tablename) == 0)
+				listed = true;
+		}
+		if ((stmt->list_type == FDW_IMPORT_SCHEMA_LIMIT_TO && !listed) ||
+			(stmt->list_type == FDW_IMPORT_SCHEMA_EXCEPT && listed))
+			continue;
+
+		/*
+		 * The table option is used as is in the queries: quote the name,
+		 * unless it's a plain identifier.
+		 */
+		tableopt = tablename;
+		for (p = tablename; *p; p++)
+		{
+			if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+				  *p == '_' || (p > tablename && *p >= '0' && *p <= '9')))
+			{
+				tableopt = simpleQuoteIdentifier(tablename);
+				break;
+			}
+		}
+
+		resetStringInfo(&buf);
+		appendStringInfo(&buf, "CREATE FOREIGN TABLE %s (\n",
+						 quote_identifier(tablename));
+
+		query = psprintf("PRAGMA table_info(%s)",
+						 simpleQuoteIdentifier(tablename));
+		if (sqlite3_prepare_v2(db, query, -1, &columns, NULL) != SQLITE_OK)
+		{
+			char	   *err = pstrdup(sqlite3_errmsg(db));
+
+			sqlite3_finalize(tables);
+			ereport(ERROR,
+				(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+				errmsg("SQL error during prepare: %s", err)
+				));
+		}
+
+		/* PRAGMA table_info returns cid, name, type, notnull, dflt_value, pk */
+		while (sqlite3_step(columns) == SQLITE_ROW)
+		{
+			const char *colname = (const char *) sqlite3_column_text(columns, 1);
+			const char *coltype = (const char *) sqlite3_column_text(columns, 2);
+			bool		notnull = sqlite3_column_int(columns, 3) != 0;
+
+			if (!first)
+				appendStringInfoString(&buf, ",\n");
+			first = false;
+
+			appendStringInfo(&buf, "  %s %s OPTIONS (column_name %s)",
+							 quote_identifier(colname),
+							 simpleImportType(coltype ? coltype : ""),
+							 quote_literal_cstr(colname));
+			if (notnull && import_not_null)
+				appendStringInfoString(&buf, " NOT NULL");
+		}
+		sqlite3_finalize(columns);
 
-		for (x = 0; x < sqlite3_column_count(festate->result); x++)
-			values[x] = sqlite3_column_text(festate->result, x);
+		appendStringInfo(&buf, "\n) SERVER %s\nOPTIONS (table %s);",
+						 quote_identifier(server->servername),
+						 quote_literal_cstr(tableopt));
 
-		tuple = BuildTupleFromCStrings(TupleDescGetAttInMetadata(node->ss.ss_currentRelation->rd_att), values);
-		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+		commands = lappend(commands, pstrdup(buf.data));
 	}
+	sqlite3_finalize(tables);
 
-	/* then return the slot */
-	return slot;
+	return commands;
 }
 
-static void
-simpleReScanForeignScan(ForeignScanState *node)
+/*
+ * Get the PostgreSQL type of an imported column, from its declared SQLite
+ * type.  The affinity of the column is found with SQLite's own rules:
+ * INTEGER for types containing "INT", TEXT for "CHAR", "CLOB" or "TEXT",
+ * BLOB for "BLOB" or no type at all, REAL for "REAL", "FLOA" or "DOUB",
+ * and NUMERIC otherwise, the dates, times and booleans being stored in
+ * NUMERIC columns.
+ */
+static const char *
+simpleImportType(const char *decltype)
+{
+	char	   *type = pstrdup(decltype);
+	char	   *p;
+
+	for (p = type; *p; p++)
+		*p = pg_toupper((unsigned char) *p);
+
+	if (strstr(type, "INT"))
+		return "int8";
+	if (strstr(type, "CHAR") || strstr(type, "CLOB") || strstr(type, "TEXT"))
+		return "text";
+	if (strstr(type, "BLOB"))
+		return "bytea";
+	/* values of any type can be stored in a column without a type */
+	if (*type == '\0')
+		return "text";
+	if (strstr(type, "REAL") || strstr(type, "FLOA") || strstr(type, "DOUB"))
+		return "float8";
+	if (strstr(type, "TIMESTAMP") || strstr(type, "DATETIME"))
+		return "timestamptz";
+	if (strstr(type, "DATE"))
+		return "date";
+	if (strstr(type, "BOOL"))
+		return "boolean";
+	if (strstr(type, "NUMERIC") || strstr(type, "DECIMAL"))
+		return "numeric";
+
+	/* Other NUMERIC columns, like JSON or UUID ones, often hold text */
+	return "text";
+}
+#endif
+
+#if (PG_VERSION_NUM >= 90200)
+static bool
+simpleAnalyzeForeignTable(Relation relation,
+						  AcquireSampleRowsFunc *func,
+						  BlockNumber *totalpages)
 {
+	char	   *svr_database = NULL;
+	char	   *svr_table = NULL;
+	struct stat st;
+
 	elog(DEBUG1,"entering function %s",__func__);
+
+	/* Fetch options  */
+	simpleGetOptions(RelationGetRelid(relation), &svr_database, &svr_table);
+
+	/* ANALYZE only reports the number of pages, use the file size */
+	if (stat(svr_database, &st) == 0)
+		*totalpages = (BlockNumber) Max(1, st.st_size / BLCKSZ);
+	else
+		*totalpages = 1;
+
+	*func = simpleAcquireSampleRowsFunc;
+
+	return true;
 }
 
-static void
-simpleEndForeignScan(ForeignScanState *node)
+/*
+ * qsort comparator for rowids
+ */
+static int
+simpleRowidCmp(const void *a, const void *b)
 {
-	SimpleFdwExecutionState *festate = (SimpleFdwExecutionState *) node->fdw_state;
+	sqlite3_int64 ra = *(const sqlite3_int64 *) a;
+	sqlite3_int64 rb = *(const sqlite3_int64 *) b;
+
+	if (ra < rb)
+		return -1;
+	if (ra > rb)
+		return 1;
+	return 0;
+}
+
+/*
+ * Acquire a random sample of rows from the SQLite table.
+ *
+ * When the table has rowids that are dense enough, we pick random rowids
+ * in the [min(rowid), max(rowid)] range and fetch them one by one, so that
+ * only the sampled rows are read.  A candidate rowid hits a row with
+ * probability rows/range, so we try range/rows times as many candidates
+ * as the rows we want.  Otherwise SQLite picks the rows itself with
+ * ORDER BY random() LIMIT, sorting only the rowids when there are some.
+ */
+static int
+simpleAcquireSampleRowsFunc(Relation relation, int elevel,
+							HeapTuple *rows, int targrows,
+							double *totalrows,
+							double *totaldeadrows)
+{
+	sqlite3           *db;
+	sqlite3_stmt      *stmt;
+	char              *svr_database = NULL;
+	char              *svr_table = NULL;
+	char              *query;
+	StringInfoData     sql;
+	List              *retrieved_attrs;
+	TupleDesc          tupdesc = RelationGetDescr(relation);
+	AttInMetadata     *attinmeta;
+	Datum             *values;
+	bool              *nulls;
+	double             tuples;
+	int                numrows = 0;
+	bool               has_rowid = false;
+	sqlite3_int64      minid = 0;
+	sqlite3_int64      maxid = 0;
+	sqlite3_int64     *rowids = NULL;
+	int                nrowids = 0;
+	double             nhits = 0;
+	int                i;
 
 	elog(DEBUG1,"entering function %s",__func__);
 
-	if (festate->result)
+	/* Fetch options  */
+	simpleGetOptions(RelationGetRelid(relation), &svr_database, &svr_table);
+
+	db = simpleGetConnection(GetForeignTable(RelationGetRelid(relation))->serverid);
+	tuples = simpleGetRowCount(db, svr_database, svr_table);
+
+	/* Get the rowid range, if the table has rowids; queries have none */
+	query = psprintf("SELECT min(rowid), max(rowid) FROM %s", svr_table);
+	if (!simpleIsQuery(svr_table) &&
+		sqlite3_prepare_v2(db, query, -1, &stmt, NULL) == SQLITE_OK)
 	{
-		sqlite3_finalize(festate->result);
-		festate->result = NULL;
+		if (sqlite3_step(stmt) == SQLITE_ROW &&
+			sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+		{
+			has_rowid = true;
+			minid = sqlite3_column_int64(stmt, 0);
+			maxid = sqlite3_column_int64(stmt, 1);
+		}
+		sqlite3_finalize(stmt);
+	}
+	pfree(query);
+
+	initStringInfo(&sql);
+	simpleDeparseAnalyzeSql(&sql, relation, svr_table, &retrieved_attrs);
+
+	if (has_rowid && tuples > targrows &&
+		(double) (maxid - minid) + 1 <= 2 * tuples)
+	{
+		double		range = (double) (maxid - minid) + 1;
+		int			ncandidates = (int) ceil(targrows * range / tuples);
+
+		rowids = (sqlite3_int64 *) palloc(sizeof(sqlite3_int64) * ncandidates);
+		for (i = 0; i < ncandidates; i++)
+		{
+			uint64		r = ((uint64) random() << 31) | (uint64) random();
+
+			rowids[i] = minid + (sqlite3_int64) (r % (uint64) range);
+		}
+
+		/*
+		 * Sort the candidates and remove duplicates, so that SQLite looks
+		 * them up in order.  More of them than targrows may exist, the
+		 * sample is then drawn from all of them below.
+		 */
+		qsort(rowids, ncandidates, sizeof(sqlite3_int64), simpleRowidCmp);
+		for (i = 0; i < ncandidates; i++)
+		{
+			if (nrowids == 0 || rowids[nrowids - 1] != rowids[i])
+				rowids[nrowids++] = rowids[i];
+		}
+
+		appendStringInfoString(&sql, " WHERE rowid = ?1");
 	}
+	else if (has_rowid)
+		appendStringInfo(&sql,
+						 " WHERE rowid IN (SELECT rowid FROM %s ORDER BY random() LIMIT %d)",
+						 svr_table, targrows);
+	else
+		appendStringInfo(&sql, " ORDER BY random() LIMIT %d", targrows);
 
-	if (festate->conn)
+	elog(DEBUG1, "simple_fdw: sampling query is: %s", sql.data);
+
+	if (sqlite3_prepare_v2(db, sql.data, -1, &stmt, NULL) != SQLITE_OK)
 	{
-		sqlite3_close(festate->conn);
-		festate->conn = NULL;
+		ereport(ERROR,
+			(errcode(ERRCODE_FDW_UNABLE_TO_CREATE_EXECUTION),
+			errmsg("SQL error during prepare: %s", sqlite3_errmsg(db))
+			));
 	}
 
-	if (festate->query)
+	attinmeta = TupleDescGetAttInMetadata(tupdesc);
+	values = (Datum *) palloc(sizeof(Datum) * tupdesc->natts);
+	nulls = (bool *) palloc(sizeof(bool) * tupdesc->natts);
+
+	for (i = 0; rowids ? i < nrowids : numrows < targrows; i++)
 	{
-		pfree(festate->query);
-		festate->query = 0;
+		ListCell   *lc;
+		int			x = 0;
+		int			pos = numrows;
+
+		if (rowids)
+		{
+			sqlite3_reset(stmt);
+			sqlite3_bind_int64(stmt, 1, rowids[i]);
+		}
+
+		if (sqlite3_step(stmt) != SQLITE_ROW)
+		{
+			/* a hole in the rowid range, or the end of the sample */
+			if (rowids)
+				continue;
+			break;
+		}
+
+		/*
+		 * Once targrows candidates have been found, each one found next
+		 * replaces a random row of the sample, with a probability of
+		 * targrows over the number of rows found so far.  Stopping there
+		 * instead would leave the highest rowids out.
+		 */
+		nhits++;
+		if (numrows == targrows)
+		{
+			pos = (int) (((double) random() / ((double) MAX_RANDOM_VALUE + 1)) * nhits);
+			if (pos >= targrows)
+				continue;
+			heap_freetuple(rows[pos]);
+		}
+
+		memset(nulls, true, sizeof(bool) * tupdesc->natts);
+		foreach(lc, retrieved_attrs)
+		{
+			int			attnum = lfirst_int(lc);
+
+			values[attnum - 1] =
+				simpleConvertColumn(stmt, x,
+									TupleDescAttr(tupdesc, attnum - 1)->atttypid,
+									attinmeta->atttypmods[attnum - 1],
+									&attinmeta->attinfuncs[attnum - 1],
+									attinmeta->attioparams[attnum - 1],
+									&nulls[attnum - 1]);
+			x++;
+		}
+
+		rows[pos] = heap_form_tuple(tupdesc, values, nulls);
+		if (pos == numrows)
+			numrows++;
 	}
 
+	sqlite3_finalize(stmt);
+
+	/*
+	 * If SQLite returned less rows than we asked for, we've read the whole
+	 * table and know its exact size.
+	 */
+	if (!rowids && numrows < targrows)
+		tuples = numrows;
+
+	*totalrows = tuples;
+	*totaldeadrows = 0;
+
+	ereport(elevel,
+			(errmsg("\"%s\": table contains %.0f rows, %d rows in sample",
+					RelationGetRelationName(relation), tuples, numrows)));
+
+	return numrows;
 }
+#endif
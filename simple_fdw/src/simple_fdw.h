@@ -0,0 +1,326 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/simple_fdw.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SIMPLE_FDW_H
+#define SIMPLE_FDW_H
+
+#include "fmgr.h"
+#include "foreign/foreign.h"
+#include "lib/stringinfo.h"
+#include "utils/relcache.h"
+#if (PG_VERSION_NUM >= 120000)
+#include "nodes/pathnodes.h"
+#else
+#include "nodes/relation.h"
+#endif
+
+#include <sqlite3.h>
+
+/*
+ * An index of a SQLite table, as reported by PRAGMA index_list.  The
+ * INTEGER PRIMARY KEY column, which is an alias of the rowid, is reported
+ * as a unique index with no name.
+ */
+typedef struct SimpleIndexInfo
+{
+	char	   *name;			/* index name, NULL for the rowid */
+	bool		unique;			/* is it a unique index? */
+	List	   *columns;		/* SQLite names of the indexed columns */
+	List	   *descending;		/* for each column, is it sorted DESC? */
+	List	   *collations;		/* for each column, its collating sequence */
+} SimpleIndexInfo;
+
+/*
+ * Counters kept for each foreign table in shared memory, see stats.c.  The
+ * connection and statement counters and times are also kept for the whole
+ * backend by connection.c.  Times are in milliseconds.
+ */
+typedef struct SimpleStatsCounters
+{
+	int64		scans;			/* foreign scans run */
+	int64		remote_scans;	/* scans with all their quals sent to SQLite */
+	int64		pushed_scans;	/* scans of pushed down joins or aggregates */
+	int64		rows;			/* rows fetched from SQLite */
+	int64		bytes;			/* bytes of the values fetched */
+	int64		conn_hits;		/* connections found in the cache */
+	int64		conn_misses;	/* connections opened */
+	int64		stmt_hits;		/* statements found in the cache */
+	int64		stmt_misses;	/* statements prepared */
+	double		open_time;		/* time spent opening databases */
+	double		prepare_time;	/* time spent preparing statements */
+	double		step_time;		/* time spent in sqlite3_step */
+	double		convert_time;	/* time spent converting the values */
+} SimpleStatsCounters;
+
+/*
+ * This is what will be set and stashed away in fdw_private and fetched
+ * for subsequent routines.
+ */
+typedef struct
+{
+	char	   *database;		/* SQLite database file */
+	char	   *table;			/* SQLite table name */
+
+	/* Restriction clauses, split into shippable and non-shippable ones */
+	List	   *remote_conds;
+	List	   *local_conds;
+
+	/* Bitmap of attr numbers we need to fetch from SQLite */
+	Bitmapset  *attrs_used;
+
+	/* Indexes of the SQLite table (list of SimpleIndexInfo) */
+	List	   *indexes;
+
+	/* Columns declared NOT NULL in SQLite (String nodes) */
+	List	   *notnull_columns;
+
+	/* Number of rows of the SQLite table */
+	double		tuples;
+
+	/* For a query option: estimated cost of running the query in SQLite */
+	Cost		query_startup_cost;
+	Cost		query_run_cost;
+
+	/* Cost options, from the server */
+	Cost		fdw_startup_cost;
+	Cost		fdw_tuple_cost;
+
+	/* Number of rows fetched at a time, from the table or the server */
+	int			fetch_size;
+
+	/* Can the scan fetch its rows in the background? */
+	bool		async_capable;
+
+	/* Estimates: rows returned by SQLite, and cost of the scan */
+	double		rows;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+#if (PG_VERSION_NUM >= 90600)
+	/* For upper relations: the processing stage, and the relation below */
+	UpperRelationKind stage;
+	RelOptInfo *outerrel;
+
+	/*
+	 * For join relations: the inner relation (the outer one is outerrel),
+	 * the join type and the clauses sent in its ON clause.
+	 */
+	RelOptInfo *innerrel;
+	JoinType	jointype;
+	List	   *joinclauses;
+
+	/* For grouped relations: the target list sent to SQLite */
+	List	   *grouped_tlist;
+#endif
+}	SimpleFdwPlanState;
+
+/*
+ * Indexes of the items stored in the fdw_private list of a ForeignScan
+ * plan node.
+ */
+enum FdwScanPrivateIndex
+{
+	/* SQL statement to execute remotely (as a String node) */
+	FdwScanPrivateSelectSql,
+	/* Integer list of attribute numbers retrieved by the SELECT */
+	FdwScanPrivateRetrievedAttrs,
+	/* Number of rows to fetch at a time, 0 for all (as an Integer node) */
+	FdwScanPrivateFetchSize,
+	/* Local quals checked over whole batches of rows (list of Expr) */
+	FdwScanPrivateBatchQuals
+};
+
+/*
+ * Indexes of the items stored in the fdw_private list of a ForeignPath
+ * created by simpleGetForeignUpperPaths.
+ */
+enum FdwPathPrivateIndex
+{
+	/* has_final_sort flag (as an Integer node) */
+	FdwPathPrivateHasFinalSort,
+	/* has_limit flag (as an Integer node) */
+	FdwPathPrivateHasLimit
+};
+
+/*
+ * Indexes of the items stored in the fdw_private list of a ModifyTable
+ * plan node, for a foreign table.
+ */
+enum FdwModifyPrivateIndex
+{
+	/* SQL statement to execute remotely (as a String node) */
+	FdwModifyPrivateUpdateSql,
+	/* Integer list of target attribute numbers for INSERT/UPDATE */
+	FdwModifyPrivateTargetAttnums,
+	/* Length of the statement up to the end of VALUES (as an Integer node) */
+	FdwModifyPrivateLen,
+	/* Integer list of key attribute numbers for UPDATE/DELETE, if any */
+	FdwModifyPrivateKeyAttnums
+};
+
+/* in deparse.c */
+extern void simpleClassifyConditions(PlannerInfo *root,
+						 RelOptInfo *baserel,
+						 List *input_conds,
+						 List **remote_conds,
+						 List **local_conds);
+extern bool simpleIsForeignExpr(PlannerInfo *root,
+					RelOptInfo *baserel,
+					Expr *expr);
+extern bool simpleIsGroupableExpr(Expr *expr);
+extern bool simpleIsIndexableClause(PlannerInfo *root,
+						RelOptInfo *baserel,
+						Expr *clause);
+extern bool simpleIsIndexedColumn(RelOptInfo *baserel,
+					  Oid relid,
+					  AttrNumber attnum);
+extern bool simplePathkeysUseIndex(PlannerInfo *root,
+					   RelOptInfo *baserel,
+					   List *pathkeys);
+extern Var *simpleFindEmVar(EquivalenceClass *ec, RelOptInfo *rel);
+extern char *simpleGetColumnName(Oid relid, AttrNumber attnum);
+extern bool simpleIsKeyColumn(Oid relid, AttrNumber attnum);
+extern const char *simpleQuoteIdentifier(const char *ident);
+extern void simpleDeparseSelectSql(StringInfo buf,
+					   PlannerInfo *root,
+					   RelOptInfo *baserel,
+					   const char *table,
+					   Bitmapset *attrs_used,
+					   List **retrieved_attrs);
+extern void simpleDeparseAnalyzeSql(StringInfo buf,
+						Relation rel,
+						const char *table,
+						List **retrieved_attrs);
+extern void simpleDeparseInsertSql(StringInfo buf, Relation rel,
+					   const char *table, List *targetAttrs,
+					   bool doNothing, int *values_end_len);
+extern void simpleRebuildInsertSql(StringInfo buf, const char *orig_query,
+					   int values_end_len, int num_params,
+					   int num_rows);
+extern void simpleDeparseUpdateSql(StringInfo buf, Relation rel,
+					   const char *table, List *targetAttrs,
+					   List *keyAttrs);
+extern void simpleDeparseDeleteSql(StringInfo buf, Relation rel,
+					   const char *table, List *keyAttrs);
+extern void simpleAppendWhereClause(StringInfo buf,
+						PlannerInfo *root,
+						RelOptInfo *baserel,
+						List *exprs,
+						List **params_list);
+extern void simpleAppendOrderByClause(StringInfo buf,
+						  PlannerInfo *root,
+						  RelOptInfo *baserel,
+						  List *pathkeys);
+#if (PG_VERSION_NUM >= 120000)
+extern void simpleDeparseGroupSql(StringInfo buf,
+					  PlannerInfo *root,
+					  RelOptInfo *baserel,
+					  const char *table,
+					  List *tlist,
+					  List *remote_conds,
+					  List **params_list);
+#endif
+#if (PG_VERSION_NUM >= 120000)
+extern void simpleDeparseJoinSql(StringInfo buf,
+					 PlannerInfo *root,
+					 RelOptInfo *joinrel,
+					 List *tlist,
+					 List *remote_conds,
+					 List **params_list);
+#endif
+extern void simpleAppendRowidRangeClause(StringInfo buf, bool has_where,
+							 int first_param);
+extern bool simpleIsLimitPushable(PlannerInfo *root);
+extern void simpleAppendLimitClause(StringInfo buf, PlannerInfo *root);
+
+/* in connection.c */
+extern int	simple_statement_cache_size;
+extern SimpleStatsCounters simple_connection_stats;
+
+extern sqlite3 *simpleGetConnection(Oid serverid);
+extern void simpleBeginTransaction(Oid serverid);
+extern bool simpleInTransaction(Oid serverid);
+extern void simpleBeginBulkLoad(Oid serverid);
+extern sqlite3_stmt *simplePrepareStatement(Oid serverid, const char *sql);
+extern void simpleReleaseStatement(Oid serverid, sqlite3_stmt *stmt);
+extern int	simpleSqliteErrcode(int rc);
+extern Datum simple_fdw_statement_cache(PG_FUNCTION_ARGS);
+
+/* in convert.c */
+extern Datum simpleConvertValue(sqlite3_value *value,
+				   Oid typid, int32 typmod,
+				   FmgrInfo *infunc, Oid ioparam,
+				   bool *isnull);
+extern Datum simpleConvertColumn(sqlite3_stmt *stmt, int col,
+					Oid typid, int32 typmod,
+					FmgrInfo *infunc, Oid ioparam,
+					bool *isnull);
+extern void simpleBindParameter(sqlite3_stmt *stmt, int idx,
+					Oid typid, Datum value, bool isnull);
+extern int	simpleSetTransmissionModes(void);
+extern void simpleResetTransmissionModes(int nestlevel);
+
+/* in stats.c */
+extern int	simple_stats_max;
+extern bool simple_stats_track_timing;
+
+extern void simpleStatsInit(void);
+extern bool simpleStatsEnabled(void);
+extern void simpleStatsAccumConnection(SimpleStatsCounters *counters,
+						   const SimpleStatsCounters *before);
+extern void simpleStatsReport(Oid relid, const SimpleStatsCounters *counters);
+extern Datum simple_fdw_stats(PG_FUNCTION_ARGS);
+extern Datum simple_fdw_stats_reset(PG_FUNCTION_ARGS);
+
+/* in cache.c */
+typedef struct SimpleCacheScan SimpleCacheScan;
+
+extern int	simple_result_cache_size;
+extern int	simple_result_cache_entries;
+extern int	simple_result_cache_max_entry;
+
+extern void simpleCacheInit(void);
+extern SimpleCacheScan *simpleCacheBegin(const char *database, const char *sql,
+				 int ncolumns, const Oid *coltypes, const int32 *typmods);
+extern bool simpleCacheLookup(SimpleCacheScan *cs, int nparams, const Oid *types,
+				  const Datum *values, const bool *isnull);
+extern int	simpleCacheRead(SimpleCacheScan *cs, Datum *values, bool *nulls,
+				int stride, int maxrows);
+extern void simpleCacheRecord(SimpleCacheScan *cs, const Datum *values,
+				  const bool *nulls, int stride, int nrows);
+extern void simpleCacheStore(SimpleCacheScan *cs);
+extern void simpleCacheRestart(SimpleCacheScan *cs);
+extern const char *simpleCacheStatus(SimpleCacheScan *cs);
+extern Datum simple_fdw_result_cache(PG_FUNCTION_ARGS);
+extern Datum simple_fdw_result_cache_reset(PG_FUNCTION_ARGS);
+
+/* in async.c */
+#if (PG_VERSION_NUM >= 140000)
+typedef struct SimpleAsyncFetcher SimpleAsyncFetcher;
+
+extern bool simpleAsyncSupported(void);
+extern SimpleAsyncFetcher *simpleAsyncCreate(int ncolumns, int fetch_size);
+extern int	simpleAsyncGetFd(SimpleAsyncFetcher *fetcher);
+extern void simpleAsyncStart(SimpleAsyncFetcher *fetcher, sqlite3_stmt *stmt);
+extern bool simpleAsyncTake(SimpleAsyncFetcher *fetcher,
+				sqlite3_value ***values, int *nrows, bool *eof);
+extern void simpleAsyncWait(SimpleAsyncFetcher *fetcher);
+extern void simpleAsyncWaitStatement(sqlite3_stmt *stmt);
+extern void simpleAsyncDestroy(SimpleAsyncFetcher *fetcher);
+extern void simpleAsyncDestroyAll(void);
+#endif
+
+#endif   /* SIMPLE_FDW_H */
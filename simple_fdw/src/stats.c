@@ -0,0 +1,377 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple Foreign Data Wrapper for PostgreSQL
+ *
+ * Cumulative statistics of the foreign tables, shared by all the backends.
+ *
+ * Each scan counts what it does in its own state, and adds it to the
+ * shared counters of its foreign table when it ends, so the hot paths
+ * never touch shared memory.  The counters live in a hash table allocated
+ * at server start, which needs simple_fdw in shared_preload_libraries;
+ * without it, nothing is collected.  The hash table holds at most
+ * simple_fdw.stats_max tables, the others are not counted.
+ *
+ * Copyright (c) 2013 Guillaume Lelarge
+ *
+ * This software is released under the PostgreSQL Licence
+ *
+ * Author: Guillaume Lelarge <guillaume@lelarge.info>
+ *
+ * IDENTIFICATION
+ *        simple_fdw/src/stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
+#include "utils/tuplestore.h"
+
+#include "simple_fdw.h"
+
+/* GUC variables */
+int			simple_stats_max = 1000;
+bool		simple_stats_track_timing = false;
+
+PG_FUNCTION_INFO_V1(simple_fdw_stats);
+PG_FUNCTION_INFO_V1(simple_fdw_stats_reset);
+
+#define SIMPLE_STATS_COLS	15
+
+#if (PG_VERSION_NUM >= 90600)
+/*
+ * Shared hash table entry, for a foreign table of a database
+ */
+typedef struct SimpleStatsKey
+{
+	Oid			dbid;
+	Oid			relid;
+} SimpleStatsKey;
+
+typedef struct SimpleStatsEntry
+{
+	SimpleStatsKey key;			/* hash key (must be first) */
+	slock_t		mutex;			/* protects the counters */
+	SimpleStatsCounters counters;
+} SimpleStatsEntry;
+
+/*
+ * Shared state: the lock protects the hash table itself, the counters of
+ * each entry being protected by its spinlock.
+ */
+typedef struct SimpleStatsShared
+{
+	LWLock	   *lock;
+} SimpleStatsShared;
+
+static SimpleStatsShared *stats_shared = NULL;
+static HTAB *stats_hash = NULL;
+
+#if (PG_VERSION_NUM >= 150000)
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size stats_memsize(void);
+static void stats_shmem_request(void);
+static void stats_shmem_startup(void);
+#endif
+
+/*
+ * Reserve the shared memory of the statistics, when loaded by
+ * shared_preload_libraries.  Called by _PG_init.
+ */
+void
+simpleStatsInit(void)
+{
+#if (PG_VERSION_NUM >= 90600)
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+#if (PG_VERSION_NUM >= 150000)
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = stats_shmem_request;
+#else
+	stats_shmem_request();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = stats_shmem_startup;
+#endif
+}
+
+/*
+ * Are the statistics collected?
+ */
+bool
+simpleStatsEnabled(void)
+{
+#if (PG_VERSION_NUM >= 90600)
+	return stats_hash != NULL;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Add to the counters what the connection cache did since the snapshot of
+ * simple_connection_stats in *before.
+ */
+void
+simpleStatsAccumConnection(SimpleStatsCounters *counters,
+						   const SimpleStatsCounters *before)
+{
+	counters->conn_hits += simple_connection_stats.conn_hits - before->conn_hits;
+	counters->conn_misses += simple_connection_stats.conn_misses - before->conn_misses;
+	counters->stmt_hits += simple_connection_stats.stmt_hits - before->stmt_hits;
+	counters->stmt_misses += simple_connection_stats.stmt_misses - before->stmt_misses;
+	counters->open_time += simple_connection_stats.open_time - before->open_time;
+	counters->prepare_time += simple_connection_stats.prepare_time - before->prepare_time;
+}
+
+/*
+ * Add the counters of a scan to the shared counters of a foreign table.
+ */
+void
+simpleStatsReport(Oid relid, const SimpleStatsCounters *counters)
+{
+#if (PG_VERSION_NUM >= 90600)
+	SimpleStatsKey key;
+	SimpleStatsEntry *entry;
+	SimpleStatsCounters *c;
+
+	if (stats_hash == NULL)
+		return;
+
+	key.dbid = MyDatabaseId;
+	key.relid = relid;
+
+	LWLockAcquire(stats_shared->lock, LW_SHARED);
+
+	entry = (SimpleStatsEntry *) hash_search(stats_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		bool		found;
+
+		/* Need exclusive lock to make a new hashtable entry */
+		LWLockRelease(stats_shared->lock);
+		LWLockAcquire(stats_shared->lock, LW_EXCLUSIVE);
+
+		entry = (SimpleStatsEntry *) hash_search(stats_hash, &key,
+												 HASH_ENTER_NULL, &found);
+
+		/* The table is full: this foreign table isn't counted */
+		if (entry == NULL)
+		{
+			LWLockRelease(stats_shared->lock);
+			return;
+		}
+
+		if (!found)
+		{
+			SpinLockInit(&entry->mutex);
+			memset(&entry->counters, 0, sizeof(SimpleStatsCounters));
+		}
+	}
+
+	SpinLockAcquire(&entry->mutex);
+	c = &entry->counters;
+	c->scans += counters->scans;
+	c->remote_scans += counters->remote_scans;
+	c->pushed_scans += counters->pushed_scans;
+	c->rows += counters->rows;
+	c->bytes += counters->bytes;
+	c->conn_hits += counters->conn_hits;
+	c->conn_misses += counters->conn_misses;
+	c->stmt_hits += counters->stmt_hits;
+	c->stmt_misses += counters->stmt_misses;
+	c->open_time += counters->open_time;
+	c->prepare_time += counters->prepare_time;
+	c->step_time += counters->step_time;
+	c->convert_time += counters->convert_time;
+	SpinLockRelease(&entry->mutex);
+
+	LWLockRelease(stats_shared->lock);
+#endif
+}
+
+#if (PG_VERSION_NUM >= 90600)
+static Size
+stats_memsize(void)
+{
+	return add_size(MAXALIGN(sizeof(SimpleStatsShared)),
+					hash_estimate_size(simple_stats_max,
+									   sizeof(SimpleStatsEntry)));
+}
+
+static void
+stats_shmem_request(void)
+{
+#if (PG_VERSION_NUM >= 150000)
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+
+	RequestAddinShmemSpace(stats_memsize());
+	RequestNamedLWLockTranche("simple_fdw", 1);
+}
+
+static void
+stats_shmem_startup(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	stats_shared = NULL;
+	stats_hash = NULL;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	stats_shared = ShmemInitStruct("simple_fdw stats",
+								   sizeof(SimpleStatsShared),
+								   &found);
+	if (!found)
+		stats_shared->lock = &(GetNamedLWLockTranche("simple_fdw"))->lock;
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(SimpleStatsKey);
+	info.entrysize = sizeof(SimpleStatsEntry);
+	stats_hash = ShmemInitHash("simple_fdw stats hash",
+							   simple_stats_max, simple_stats_max,
+							   &info,
+							   HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+#endif
+
+/*
+ * Return the statistics of all the foreign tables, of all the databases.
+ */
+Datum
+simple_fdw_stats(PG_FUNCTION_ARGS)
+{
+#if (PG_VERSION_NUM >= 90600)
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	SimpleStatsEntry *entry;
+
+	if (stats_hash == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("simple_fdw must be loaded via shared_preload_libraries")
+			));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("set-valued function called in context that cannot accept a set")
+			));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			errmsg("materialize mode required, but it is not allowed in this context")
+			));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(stats_shared->lock, LW_SHARED);
+
+	hash_seq_init(&hash_seq, stats_hash);
+	while ((entry = (SimpleStatsEntry *) hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[SIMPLE_STATS_COLS];
+		bool		nulls[SIMPLE_STATS_COLS];
+		SimpleStatsCounters c;
+		int			i = 0;
+
+		/* copy the counters, to hold the spinlock as briefly as possible */
+		SpinLockAcquire(&entry->mutex);
+		c = entry->counters;
+		SpinLockRelease(&entry->mutex);
+
+		MemSet(nulls, 0, sizeof(nulls));
+		values[i++] = ObjectIdGetDatum(entry->key.dbid);
+		values[i++] = ObjectIdGetDatum(entry->key.relid);
+		values[i++] = Int64GetDatumFast(c.scans);
+		values[i++] = Int64GetDatumFast(c.remote_scans);
+		values[i++] = Int64GetDatumFast(c.pushed_scans);
+		values[i++] = Int64GetDatumFast(c.rows);
+		values[i++] = Int64GetDatumFast(c.bytes);
+		values[i++] = Int64GetDatumFast(c.conn_hits);
+		values[i++] = Int64GetDatumFast(c.conn_misses);
+		values[i++] = Int64GetDatumFast(c.stmt_hits);
+		values[i++] = Int64GetDatumFast(c.stmt_misses);
+		values[i++] = Float8GetDatumFast(c.open_time);
+		values[i++] = Float8GetDatumFast(c.prepare_time);
+		values[i++] = Float8GetDatumFast(c.step_time);
+		values[i++] = Float8GetDatumFast(c.convert_time);
+		Assert(i == SIMPLE_STATS_COLS);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(stats_shared->lock);
+
+	return (Datum) 0;
+#else
+	ereport(ERROR,
+		(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+		errmsg("simple_fdw statistics require PostgreSQL 9.6 or later")
+		));
+	PG_RETURN_VOID();
+#endif
+}
+
+/*
+ * Forget the statistics of all the foreign tables.
+ */
+Datum
+simple_fdw_stats_reset(PG_FUNCTION_ARGS)
+{
+#if (PG_VERSION_NUM >= 90600)
+	HASH_SEQ_STATUS hash_seq;
+	SimpleStatsEntry *entry;
+
+	if (stats_hash == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("simple_fdw must be loaded via shared_preload_libraries")
+			));
+
+	LWLockAcquire(stats_shared->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, stats_hash);
+	while ((entry = (SimpleStatsEntry *) hash_seq_search(&hash_seq)) != NULL)
+		hash_search(stats_hash, &entry->key, HASH_REMOVE, NULL);
+
+	LWLockRelease(stats_shared->lock);
+#endif
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,2 @@
+-- Aggregate of the whole table, grouped by dim_id.
+SELECT dim_id, count(*), max(id) FROM :table GROUP BY dim_id;
@@ -0,0 +1,119 @@
+#!/bin/sh
+#
+# Benchmarks of simple_fdw, run with pgbench.
+#
+# For each number of rows given (default: 1000 100000 1000000), a SQLite
+# database is created by fixtures.sh, and imported into schema
+# bench_<rows> of the PostgreSQL database.  Each workload is then run for
+# each table shape, and a line is printed with its transactions and rows
+# per second, and the 50th, 95th and 99th percentiles of its latency:
+#
+#   full_scan      every column of every row
+#   point_lookup   one row by its primary key
+#   join           1000 rows joined with a dimension table and grouped
+#   aggregate      the whole table grouped
+#   bulk_insert    10000 rows inserted in batches, on narrow_int's columns
+#
+# The connection to PostgreSQL is set by the usual PG* variables, and the
+# run by:
+#   BENCH_DIR       directory of the SQLite databases, kept between runs
+#                   (default /tmp/simple_fdw_bench)
+#   BENCH_OPTIONS   options of the foreign servers, e.g.
+#                   "fetch_size '1000', mmap_size '1073741824'"
+#   BENCH_TIME      duration of each run in seconds (default 10)
+#   BENCH_CLIENTS   number of pgbench clients (default 1)
+#   BENCH_SHAPES    table shapes (default narrow_int narrow_text wide_int
+#                   wide_text)
+#   BENCH_WORKLOADS workloads to run (default all of them)
+#
+# usage: bench.sh [rows...]
+#
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+dir=${BENCH_DIR:-/tmp/simple_fdw_bench}
+options=${BENCH_OPTIONS:-}
+duration=${BENCH_TIME:-10}
+clients=${BENCH_CLIENTS:-1}
+shapes=${BENCH_SHAPES:-narrow_int narrow_text wide_int wide_text}
+workloads=${BENCH_WORKLOADS:-full_scan point_lookup join aggregate bulk_insert}
+
+if [ $# -eq 0 ]; then
+	set -- 1000 100000 1000000
+fi
+
+mkdir -p "$dir"
+logs=$(mktemp -d)
+trap 'rm -rf "$logs"' EXIT
+
+# Rows processed by a transaction of a workload
+workload_rows() {
+	case $1 in
+		full_scan|aggregate) echo "$2" ;;
+		point_lookup) echo 1 ;;
+		join) [ "$2" -lt 1000 ] && echo "$2" || echo 1000 ;;
+		bulk_insert) echo 10000 ;;
+	esac
+}
+
+# Print the given percentiles, in milliseconds, of the latencies logged
+# by pgbench in files "$logs"/log.*, in microseconds in their third column
+percentiles() {
+	cat "$logs"/log.* | awk '{ print $3 }' | sort -n | awk -v p="$*" '
+		{ lat[NR] = $1 }
+		END {
+			n = split(p, ps, " ")
+			for (i = 1; i <= n; i++) {
+				k = int(NR * ps[i] / 100 + 0.5)
+				if (k < 1) k = 1
+				if (k > NR) k = NR
+				printf " %10.3f", lat[k] / 1000
+			}
+		}'
+}
+
+printf '%-12s %-12s %10s %10s %12s %10s %10s %10s\n' \
+	workload table rows tps rows/s p50_ms p95_ms p99_ms
+
+for rows in "$@"; do
+	schema=bench_$rows
+	database=$dir/$schema.db
+
+	if [ ! -f "$database" ]; then
+		echo "creating $database" >&2
+		"$here"/fixtures.sh "$rows" "$database"
+	fi
+
+	psql -X -q -v ON_ERROR_STOP=1 -v schema="$schema" \
+		-v database="$database" -v options="$options" \
+		-f "$here"/setup.sql > /dev/null
+
+	for workload in $workloads; do
+		if [ "$workload" = bulk_insert ]; then
+			tables=sink
+		else
+			tables=$shapes
+		fi
+
+		for shape in $tables; do
+			rm -f "$logs"/log.*
+			tps=$(pgbench -n -T "$duration" -c "$clients" -j "$clients" \
+					-D table="$schema.$shape" -D schema="$schema" \
+					-D rows="$rows" -l --log-prefix="$logs"/log \
+					-f "$here/$workload.sql" 2> /dev/null |
+				  sed -n 's/^tps = \([0-9.]*\).*/\1/p')
+			if [ -z "$tps" ]; then
+				echo "pgbench failed: $workload on $schema.$shape" >&2
+				exit 1
+			fi
+			n=$(workload_rows "$workload" "$rows")
+
+			printf '%-12s %-12s %10s %10.1f %12.0f' \
+				"$workload" "$shape" "$rows" "$tps" \
+				"$(awk -v tps="$tps" -v n="$n" 'BEGIN { print tps * n }')"
+			percentiles 50 95 99
+			printf '\n'
+		done
+	done
+done
@@ -0,0 +1,7 @@
+-- Insert of 10000 rows in batches, then rolled back, so that the table
+-- stays empty from one transaction to the next.
+BEGIN;
+INSERT INTO :schema.sink
+SELECT g, 1 + g % 1000, g * 7 % 10007, g, g / 3.0
+  FROM generate_series(1, 10000) g;
+ROLLBACK;
@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Create the SQLite database used by the benchmarks, with "rows" rows in
+# each of its tables:
+#   narrow_int   an INTEGER PRIMARY KEY, three integers and a real
+#   narrow_text  an INTEGER PRIMARY KEY, an integer and three short texts
+#   wide_int     an INTEGER PRIMARY KEY and twenty integers
+#   wide_text    an INTEGER PRIMARY KEY, an integer and twenty texts
+#   sink         empty, with the columns of narrow_int, for the inserts
+# and a dim table of 1000 rows the dim_id column of each table refers to.
+#
+# usage: fixtures.sh rows file
+#
+
+set -e
+
+rows=$1
+file=$2
+
+if [ -z "$rows" ] || [ -z "$file" ]; then
+	echo "usage: $0 rows file" >&2
+	exit 1
+fi
+
+# Twenty columns with the given type, and their values computed from i
+cols() {
+	n=1
+	while [ $n -le 20 ]; do
+		printf ', c%d %s' $n "$1"
+		n=$((n + 1))
+	done
+}
+vals() {
+	n=1
+	while [ $n -le 20 ]; do
+		printf ', %s' "$(echo "$1" | sed "s/N/$n/g")"
+		n=$((n + 1))
+	done
+}
+
+rm -f "$file"
+sqlite3 "$file" > /dev/null <<SQL
+PRAGMA journal_mode = OFF;
+PRAGMA synchronous = OFF;
+BEGIN;
+
+CREATE TABLE dim (id INTEGER PRIMARY KEY, label TEXT NOT NULL);
+WITH RECURSIVE g(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM g WHERE i < 1000)
+INSERT INTO dim SELECT i, 'label ' || i FROM g;
+
+CREATE TABLE narrow_int (id INTEGER PRIMARY KEY, dim_id INTEGER,
+                         a INTEGER, b INTEGER, r REAL);
+WITH RECURSIVE g(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM g WHERE i < $rows)
+INSERT INTO narrow_int
+SELECT i, 1 + i % 1000, i * 7 % 10007, abs(random() % 1000000), i / 3.0 FROM g;
+
+CREATE TABLE narrow_text (id INTEGER PRIMARY KEY, dim_id INTEGER,
+                          a TEXT, b TEXT, c TEXT);
+WITH RECURSIVE g(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM g WHERE i < $rows)
+INSERT INTO narrow_text
+SELECT i, 1 + i % 1000, 'a' || i, hex(randomblob(8)), printf('%032d', i) FROM g;
+
+CREATE TABLE wide_int (id INTEGER PRIMARY KEY, dim_id INTEGER $(cols INTEGER));
+WITH RECURSIVE g(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM g WHERE i < $rows)
+INSERT INTO wide_int SELECT i, 1 + i % 1000 $(vals 'i * N % 100003') FROM g;
+
+CREATE TABLE wide_text (id INTEGER PRIMARY KEY, dim_id INTEGER $(cols TEXT));
+WITH RECURSIVE g(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM g WHERE i < $rows)
+INSERT INTO wide_text SELECT i, 1 + i % 1000 $(vals "'cN-' || i") FROM g;
+
+CREATE TABLE sink (id INTEGER PRIMARY KEY, dim_id INTEGER,
+                   a INTEGER, b INTEGER, r REAL);
+
+COMMIT;
+ANALYZE;
+SQL
@@ -0,0 +1,3 @@
+-- Full scan, fetching every column of every row: count(t) needs the
+-- whole row, so it is neither pushed down nor given a narrower target list.
+SELECT count(t) FROM :table t;
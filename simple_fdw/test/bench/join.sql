@@ -0,0 +1,6 @@
+-- Join of a range of 1000 rows with the dimension table, grouped by label.
+\set lo random(1, greatest(:rows - 999, 1))
+SELECT d.label, count(*)
+  FROM :table f JOIN :schema.dim d ON d.id = f.dim_id
+ WHERE f.id BETWEEN :lo AND :lo + 999
+ GROUP BY d.label;
@@ -0,0 +1,3 @@
+-- Lookup of a random row by its INTEGER PRIMARY KEY.
+\set id random(1, :rows)
+SELECT * FROM :table WHERE id = :id;
@@ -0,0 +1,14 @@
+--
+-- Create the foreign tables of a benchmark database in schema :schema,
+-- with the server options :options.  Run by bench.sh.
+--
+SET client_min_messages = warning;
+CREATE EXTENSION IF NOT EXISTS simple_fdw;
+DROP SERVER IF EXISTS :schema CASCADE;
+DROP SCHEMA IF EXISTS :schema CASCADE;
+CREATE SCHEMA :schema;
+SELECT format('CREATE SERVER %I FOREIGN DATA WRAPPER simple_fdw OPTIONS (database %L%s)',
+              :'schema', :'database',
+              CASE WHEN :'options' <> '' THEN ', ' || :'options' ELSE '' END) \gexec
+IMPORT FOREIGN SCHEMA main FROM SERVER :schema INTO :schema;
+ALTER FOREIGN TABLE :schema.sink OPTIONS (ADD batch_size '100');
@@ -0,0 +1,65 @@
+-- SQLite database used by the regression tests, loaded with the sqlite3
+-- command line tool before each test.
+
+CREATE TABLE categories (
+    id INTEGER PRIMARY KEY,
+    label TEXT NOT NULL
+);
+INSERT INTO categories VALUES (1, 'fruit');
+INSERT INTO categories VALUES (2, 'vegetable');
+INSERT INTO categories VALUES (3, 'dairy');
+
+CREATE TABLE items (
+    id INTEGER PRIMARY KEY,
+    name TEXT NOT NULL,
+    price REAL,
+    qty INTEGER,
+    category_id INTEGER,
+    data BLOB
+);
+CREATE INDEX items_category ON items (category_id);
+INSERT INTO items VALUES (1, 'apple', 0.5, 10, 1, x'01');
+INSERT INTO items VALUES (2, 'banana', 0.25, 20, 1, NULL);
+INSERT INTO items VALUES (3, 'carrot', 0.75, 15, 2, x'0203');
+INSERT INTO items VALUES (4, 'cheese', 4.5, 3, 3, NULL);
+INSERT INTO items VALUES (5, 'leek', 1.5, NULL, 2, NULL);
+INSERT INTO items VALUES (6, 'milk', 1, 6, 3, x'');
+INSERT INTO items VALUES (7, 'pear', 0.5, 8, 1, NULL);
+INSERT INTO items VALUES (8, 'Apricot', 2, 5, NULL, NULL);
+
+CREATE VIEW cheap_items AS
+    SELECT id, name, price FROM items WHERE price < 1;
+
+CREATE TABLE kv (
+    k TEXT PRIMARY KEY,
+    v TEXT
+) WITHOUT ROWID;
+INSERT INTO kv VALUES ('a', 'one');
+INSERT INTO kv VALUES ('b', 'two');
+
+CREATE TABLE types (
+    id INTEGER PRIMARY KEY,
+    i INTEGER,
+    r REAL,
+    t TEXT,
+    b BLOB,
+    n NUMERIC,
+    d DATE,
+    ts DATETIME,
+    flag BOOLEAN,
+    v VARCHAR(10),
+    untyped
+);
+INSERT INTO types VALUES (1, 42, 3.5, 'text', x'deadbeef', 12.25,
+    '2024-02-29', '2024-02-29 12:34:56', 1, 'short', 'anything');
+INSERT INTO types VALUES (2, -9223372036854775808, -0.125, '', x'', 0,
+    '1999-12-31', '1999-12-31 23:59:59', 0, '', 7);
+INSERT INTO types VALUES (3, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL);
+INSERT INTO types VALUES (4, 100000, 1e100, 'it''s', x'00', '3.14',
+    '2000-01-01', '2000-01-01 00:00:00', 1, 'x', x'41');
+
+CREATE TABLE notes (
+    id INTEGER PRIMARY KEY,
+    body TEXT
+);
@@ -0,0 +1,49 @@
+--
+-- IMPORT FOREIGN SCHEMA
+--
+\! rm -f /tmp/simple_fdw_import.db
+\! sqlite3 /tmp/simple_fdw_import.db < test/fixtures/regress.sql
+SET datestyle = 'ISO, YMD';
+SET timezone = 'UTC';
+CREATE SERVER import_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_import.db');
+CREATE SCHEMA import_all;
+CREATE SCHEMA import_some;
+CREATE SCHEMA import_except;
+IMPORT FOREIGN SCHEMA public FROM SERVER import_server INTO import_all;
+IMPORT FOREIGN SCHEMA main FROM SERVER import_server INTO import_all
+  OPTIONS (import_defaults 'true');
+-- all the tables and views
+IMPORT FOREIGN SCHEMA main FROM SERVER import_server INTO import_all;
+SELECT c.relname, ft.ftoptions
+  FROM pg_foreign_table ft JOIN pg_class c ON c.oid = ft.ftrelid
+  WHERE c.relnamespace = 'import_all'::regnamespace ORDER BY c.relname COLLATE "C";
+SELECT attname, format_type(atttypid, atttypmod) AS type, attnotnull, attfdwoptions
+  FROM pg_attribute WHERE attrelid = 'import_all.types'::regclass AND attnum > 0
+  ORDER BY attnum;
+SELECT attname, format_type(atttypid, atttypmod) AS type, attnotnull, attfdwoptions
+  FROM pg_attribute WHERE attrelid = 'import_all.categories'::regclass AND attnum > 0
+  ORDER BY attnum;
+SELECT * FROM import_all.types ORDER BY id;
+SELECT * FROM import_all.cheap_items ORDER BY id;
+SELECT * FROM import_all.kv ORDER BY k;
+-- LIMIT TO and EXCEPT
+IMPORT FOREIGN SCHEMA main LIMIT TO (categories, kv, missing)
+  FROM SERVER import_server INTO import_some OPTIONS (import_not_null 'false');
+SELECT c.relname, ft.ftoptions
+  FROM pg_foreign_table ft JOIN pg_class c ON c.oid = ft.ftrelid
+  WHERE c.relnamespace = 'import_some'::regnamespace ORDER BY c.relname COLLATE "C";
+SELECT attname, format_type(atttypid, atttypmod) AS type, attnotnull, attfdwoptions
+  FROM pg_attribute WHERE attrelid = 'import_some.categories'::regclass AND attnum > 0
+  ORDER BY attnum;
+IMPORT FOREIGN SCHEMA main EXCEPT (categories, items, types)
+  FROM SERVER import_server INTO import_except;
+SELECT c.relname, ft.ftoptions
+  FROM pg_foreign_table ft JOIN pg_class c ON c.oid = ft.ftrelid
+  WHERE c.relnamespace = 'import_except'::regnamespace ORDER BY c.relname COLLATE "C";
+-- cleanup
+SET client_min_messages = warning;
+DROP SCHEMA import_all CASCADE;
+DROP SCHEMA import_some CASCADE;
+DROP SCHEMA import_except CASCADE;
+DROP SERVER import_server CASCADE;
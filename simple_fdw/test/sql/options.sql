@@ -0,0 +1,70 @@
+--
+-- Validation of the server, table and column options
+--
+\! rm -f /tmp/simple_fdw_options.db
+\! sqlite3 /tmp/simple_fdw_options.db < test/fixtures/regress.sql
+-- server options
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (dbname '/tmp/simple_fdw_options.db');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/a.db', database '/tmp/b.db');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', fdw_startup_cost '-1');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', fdw_tuple_cost 'cheap');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', fetch_size '0');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', batch_size '10x');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', readonly 'maybe');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', mmap_size '-1');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', temp_store 'disk');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', result_cache 'true');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', busy_timeout '-1');
+CREATE SERVER options_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_options.db', fetch_size '50',
+           fdw_startup_cost '5', fdw_tuple_cost '0.1', cache_size '-2000',
+           temp_store 'memory', async_capable 'false');
+-- table options
+CREATE FOREIGN TABLE options_items (id bigint, name text)
+  SERVER options_server OPTIONS (database '/tmp/simple_fdw_options.db');
+CREATE FOREIGN TABLE options_items (id bigint, name text)
+  SERVER options_server OPTIONS (table 'items', table 'categories');
+CREATE FOREIGN TABLE options_items (id bigint, name text)
+  SERVER options_server OPTIONS (table 'items', query 'SELECT id, name FROM items');
+CREATE FOREIGN TABLE options_items (id bigint, name text)
+  SERVER options_server OPTIONS (table 'items', fetch_size '-5');
+CREATE FOREIGN TABLE options_items (id bigint, name text)
+  SERVER options_server OPTIONS (table 'items', fetch_size '2');
+ALTER FOREIGN TABLE options_items OPTIONS (ADD query 'SELECT id, name FROM items');
+-- column options
+ALTER FOREIGN TABLE options_items ALTER COLUMN name OPTIONS (name 'label');
+ALTER FOREIGN TABLE options_items ALTER COLUMN name OPTIONS (column_name '');
+ALTER FOREIGN TABLE options_items ALTER COLUMN id OPTIONS (key 'yes please');
+ALTER FOREIGN TABLE options_items ALTER COLUMN id OPTIONS (key 'true');
+-- the fetch size of the table overrides the server's
+SELECT * FROM options_items ORDER BY id;
+-- a table needs a table or a query option
+CREATE FOREIGN TABLE options_missing (id bigint) SERVER options_server;
+SELECT * FROM options_missing;
+-- a server needs a database
+CREATE SERVER options_nodb FOREIGN DATA WRAPPER simple_fdw;
+CREATE FOREIGN TABLE options_nodb_items (id bigint)
+  SERVER options_nodb OPTIONS (table 'items');
+SELECT * FROM options_nodb_items;
+-- a database that can't be opened
+CREATE SERVER options_nofile FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/nonexistent/simple_fdw.db', readonly 'true');
+CREATE FOREIGN TABLE options_nofile_items (id bigint)
+  SERVER options_nofile OPTIONS (table 'items');
+SELECT * FROM options_nofile_items;
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER options_server CASCADE;
+DROP SERVER options_nodb CASCADE;
+DROP SERVER options_nofile CASCADE;
@@ -0,0 +1,70 @@
+--
+-- Aggregates and joins computed by SQLite
+--
+\! rm -f /tmp/simple_fdw_pushdown.db
+\! sqlite3 /tmp/simple_fdw_pushdown.db < test/fixtures/regress.sql
+CREATE SERVER pushdown_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_pushdown.db');
+CREATE FOREIGN TABLE items (
+  id bigint,
+  name text,
+  price float8,
+  qty integer,
+  category_id bigint
+) SERVER pushdown_server OPTIONS (table 'items');
+CREATE FOREIGN TABLE categories (
+  id bigint,
+  label text
+) SERVER pushdown_server OPTIONS (table 'categories');
+CREATE TABLE local_categories (id bigint, label text);
+INSERT INTO local_categories SELECT * FROM categories;
+-- the plan nodes of a query, without the queries sent to SQLite
+CREATE FUNCTION plan_nodes(query text) RETURNS SETOF text
+LANGUAGE plpgsql AS $$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query LOOP
+    IF line NOT LIKE '%:%' THEN
+      RETURN NEXT line;
+    END IF;
+  END LOOP;
+END;
+$$;
+-- aggregates
+SELECT * FROM plan_nodes('SELECT count(*), sum(qty), min(price), max(price) FROM items');
+SELECT count(*), count(qty), sum(qty), min(price), max(price), sum(price) FROM items;
+SELECT * FROM plan_nodes('SELECT category_id, count(*), sum(qty) FROM items GROUP BY category_id');
+SELECT category_id, count(*), sum(qty) FROM items GROUP BY category_id ORDER BY category_id;
+SELECT category_id, avg(price) FROM items WHERE category_id > 1
+  GROUP BY category_id ORDER BY category_id;
+SELECT * FROM plan_nodes('SELECT count(*) FROM items WHERE qty > 5');
+SELECT count(*) FROM items WHERE qty > 5;
+-- aggregates computed locally
+SELECT * FROM plan_nodes('SELECT avg(qty) FROM items');
+SELECT avg(qty) FROM items;
+SELECT count(DISTINCT category_id) FROM items;
+SELECT * FROM plan_nodes('SELECT count(*) FROM items WHERE lower(name) = ''milk''');
+SELECT count(*) FROM items WHERE lower(name) = 'milk';
+SELECT category_id FROM items GROUP BY category_id HAVING count(*) > 2;
+-- joins
+SELECT * FROM plan_nodes('SELECT i.name, c.label FROM items i JOIN categories c ON i.category_id = c.id');
+SELECT i.name, c.label FROM items i JOIN categories c ON i.category_id = c.id
+  ORDER BY i.id;
+SELECT * FROM plan_nodes('SELECT i.name, c.label FROM items i LEFT JOIN categories c ON i.category_id = c.id');
+SELECT i.name, c.label FROM items i LEFT JOIN categories c ON i.category_id = c.id
+  WHERE i.qty < 10 ORDER BY i.id;
+SELECT i.name, c.label FROM items i JOIN categories c ON i.category_id = c.id
+  WHERE c.label = 'dairy' AND i.price > 2 ORDER BY i.id;
+-- a join with a local table is done locally, SQLite answering one
+-- indexed lookup for each outer row when that's cheaper
+SELECT l.label, i.name FROM local_categories l JOIN items i ON i.category_id = l.id
+  WHERE l.label = 'vegetable' ORDER BY i.id;
+-- an aggregate over a join
+SELECT c.label, count(*) FROM items i JOIN categories c ON i.category_id = c.id
+  GROUP BY c.label ORDER BY c.label COLLATE "C";
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER pushdown_server CASCADE;
+DROP TABLE local_categories;
+DROP FUNCTION plan_nodes(text);
@@ -0,0 +1,33 @@
+--
+-- Foreign tables defined by a query
+--
+\! rm -f /tmp/simple_fdw_query.db
+\! sqlite3 /tmp/simple_fdw_query.db < test/fixtures/regress.sql
+CREATE SERVER query_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_query.db');
+CREATE FOREIGN TABLE cheap (id bigint, name text, price float8)
+  SERVER query_server
+  OPTIONS (query 'SELECT id, name, price FROM items WHERE price < 1');
+SELECT * FROM cheap ORDER BY id;
+-- the clauses are applied to the result of the query
+EXPLAIN (COSTS OFF) SELECT name FROM cheap WHERE id = 3;
+SELECT name FROM cheap WHERE id = 3;
+SELECT count(*), sum(price) FROM cheap;
+-- a query joining and grouping the SQLite tables
+CREATE FOREIGN TABLE category_totals (label text, items bigint, total float8)
+  SERVER query_server
+  OPTIONS (query 'SELECT c.label, count(*) AS items, sum(i.price * i.qty) AS total
+                  FROM items i JOIN categories c ON c.id = i.category_id
+                  GROUP BY c.label');
+SELECT * FROM category_totals ORDER BY label COLLATE "C";
+SELECT label FROM category_totals WHERE total > 12 ORDER BY label COLLATE "C";
+-- the queries are checked by SQLite
+CREATE FOREIGN TABLE broken (id bigint)
+  SERVER query_server OPTIONS (query 'SELECT nope FROM items');
+SELECT * FROM broken;
+-- and they can't be modified
+INSERT INTO cheap VALUES (9, 'plum', 0.8);
+DELETE FROM cheap WHERE id = 1;
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER query_server CASCADE;
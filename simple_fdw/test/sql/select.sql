@@ -0,0 +1,78 @@
+--
+-- Scans, and the clauses sent to SQLite
+--
+\! rm -f /tmp/simple_fdw_select.db
+\! sqlite3 /tmp/simple_fdw_select.db < test/fixtures/regress.sql
+CREATE SERVER select_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_select.db', fetch_size '3');
+CREATE FOREIGN TABLE items (
+  id bigint,
+  name text,
+  price float8,
+  qty integer,
+  category_id bigint,
+  data bytea
+) SERVER select_server OPTIONS (table 'items');
+-- full scans, fetched three rows at a time
+SELECT * FROM items;
+SELECT count(*) FROM (SELECT * FROM items OFFSET 0) s;
+EXPLAIN (COSTS OFF) SELECT name, price FROM items;
+-- comparisons
+EXPLAIN (COSTS OFF) SELECT id, name FROM items WHERE id = 2;
+SELECT id, name FROM items WHERE id = 2;
+EXPLAIN (COSTS OFF) SELECT id, name FROM items WHERE price >= 1 AND qty < 6;
+SELECT id, name FROM items WHERE price >= 1 AND qty < 6 ORDER BY id;
+SELECT id, name FROM items WHERE name = 'leek' OR name <> name;
+-- IN lists
+EXPLAIN (COSTS OFF) SELECT id FROM items WHERE id IN (1, 3, 5);
+SELECT id FROM items WHERE id IN (1, 3, 5) ORDER BY id;
+SELECT id FROM items WHERE category_id NOT IN (1, 2) ORDER BY id;
+SELECT id FROM items WHERE name = ANY (ARRAY['pear', 'milk']) ORDER BY id;
+-- NULL tests
+EXPLAIN (COSTS OFF) SELECT id FROM items WHERE qty IS NULL;
+SELECT id FROM items WHERE qty IS NULL;
+SELECT id FROM items WHERE category_id IS NOT NULL AND data IS NULL ORDER BY id;
+SELECT id FROM items WHERE NOT (qty > 5) ORDER BY id;
+-- LIKE is sent as GLOB, which is case sensitive too
+EXPLAIN (COSTS OFF) SELECT name FROM items WHERE name LIKE 'a%';
+SELECT name FROM items WHERE name LIKE 'a%';
+SELECT name FROM items WHERE name LIKE '_e%' ORDER BY name COLLATE "C";
+SELECT name FROM items WHERE name NOT LIKE '%e%' ORDER BY id;
+-- a pattern ending with the escape character is an error, raised locally
+EXPLAIN (COSTS OFF) SELECT name FROM items WHERE name LIKE 'ab\';
+SELECT name FROM items WHERE name LIKE 'ab\';
+-- ordering comparisons of text are only sent in the C collation
+EXPLAIN (COSTS OFF) SELECT name FROM items WHERE name > 'm' COLLATE "C";
+SELECT name FROM items WHERE name > 'm' COLLATE "C" ORDER BY id;
+-- text is compared bytewise, whatever the collating sequence of the column
+\! sqlite3 /tmp/simple_fdw_select.db "CREATE TABLE words (w TEXT COLLATE NOCASE); INSERT INTO words VALUES ('apple'), ('Apple'), ('Banana')"
+CREATE FOREIGN TABLE words (w text) SERVER select_server OPTIONS (table 'words');
+EXPLAIN (COSTS OFF) SELECT w FROM words WHERE w = 'apple';
+SELECT w FROM words WHERE w = 'apple';
+SELECT w FROM words WHERE w IN ('APPLE', 'banana');
+SELECT max(w COLLATE "C") FROM words;
+-- clauses SQLite can't run are checked locally
+EXPLAIN (COSTS OFF) SELECT id, name FROM items WHERE lower(name) = 'apricot';
+SELECT id, name FROM items WHERE lower(name) = 'apricot';
+EXPLAIN (COSTS OFF) SELECT id FROM items WHERE id = 4 AND length(name) = 6;
+SELECT id FROM items WHERE id = 4 AND length(name) = 6;
+-- comparisons of numbers SQLite can't run are checked over whole batches
+EXPLAIN (COSTS OFF) SELECT id FROM items WHERE price < 'Infinity' AND qty::float8 > 7.5;
+SELECT id FROM items WHERE price < 'Infinity' AND qty::float8 > 7.5 ORDER BY id;
+SELECT id FROM items WHERE 'NaN'::float8 > price AND 4 <= qty::bigint ORDER BY id;
+-- ORDER BY and LIMIT
+EXPLAIN (COSTS OFF) SELECT id, name FROM items ORDER BY id LIMIT 2 OFFSET 1;
+SELECT id, name FROM items ORDER BY id LIMIT 2 OFFSET 1;
+EXPLAIN (COSTS OFF) SELECT id FROM items ORDER BY id DESC LIMIT 1;
+SELECT id FROM items ORDER BY id DESC LIMIT 1;
+EXPLAIN (COSTS OFF) SELECT id FROM items WHERE qty > 5 LIMIT 3;
+SELECT id, name FROM items WHERE lower(name) <> 'milk' ORDER BY id LIMIT 2;
+SELECT id, name FROM items ORDER BY price DESC, id LIMIT 3;
+-- system columns: the ctid is made from the rowid
+SELECT ctid, id FROM items WHERE id IN (1, 8) ORDER BY id;
+-- ANALYZE sets the row count of the table
+ANALYZE items;
+SELECT reltuples FROM pg_class WHERE relname = 'items';
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER select_server CASCADE;
@@ -0,0 +1,63 @@
+--
+-- Conversion of the SQLite values to the types of the columns
+--
+\! rm -f /tmp/simple_fdw_types.db
+\! sqlite3 /tmp/simple_fdw_types.db < test/fixtures/regress.sql
+SET datestyle = 'ISO, YMD';
+SET timezone = 'UTC';
+CREATE SERVER types_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_types.db');
+CREATE FOREIGN TABLE types (
+  id integer,
+  i bigint,
+  r float8,
+  t text,
+  b bytea,
+  n numeric,
+  d date,
+  ts timestamp,
+  flag boolean,
+  v varchar(10),
+  untyped text
+) SERVER types_server OPTIONS (table 'types');
+SELECT * FROM types ORDER BY id;
+-- the same values, read into other types
+CREATE FOREIGN TABLE types_other (
+  id integer,
+  i numeric,
+  r real,
+  t varchar(2),
+  n float8,
+  d text,
+  ts timestamptz,
+  flag integer,
+  untyped bytea
+) SERVER types_server OPTIONS (table 'types');
+SELECT id, i, n, d, ts, flag FROM types_other ORDER BY id;
+-- a REAL out of the range of real is an error
+SELECT id, r FROM types_other ORDER BY id;
+SELECT id, untyped FROM types_other WHERE id IN (1, 4) ORDER BY id;
+-- typmods are checked
+SELECT t FROM types_other WHERE id = 1;
+-- values that don't fit into the column
+CREATE FOREIGN TABLE types_small (id integer, i smallint, r integer, flag boolean)
+  SERVER types_server OPTIONS (table 'types');
+SELECT i FROM types_small WHERE id = 4;
+SELECT r FROM types_small WHERE id = 1;
+SELECT id, flag FROM types_small ORDER BY id;
+-- a column can have another name in SQLite
+CREATE FOREIGN TABLE types_renamed (
+  key integer OPTIONS (column_name 'id'),
+  "Text" text OPTIONS (column_name 't'),
+  number numeric OPTIONS (column_name 'n')
+) SERVER types_server OPTIONS (table 'types');
+EXPLAIN (COSTS OFF) SELECT "Text" FROM types_renamed WHERE key = 1 AND number = 12.25;
+SELECT "Text" FROM types_renamed WHERE key = 1 AND number = 12.25;
+SELECT key, "Text" FROM types_renamed WHERE key < 3 ORDER BY key;
+-- numeric comparisons are checked locally: SQLite keeps this value as TEXT
+\! sqlite3 /tmp/simple_fdw_types.db "INSERT INTO types (id, n) VALUES (5, '12345678901234567890.5')"
+EXPLAIN (COSTS OFF) SELECT id, n FROM types WHERE n > 5;
+SELECT id, n FROM types WHERE n > 5 ORDER BY id;
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER types_server CASCADE;
@@ -0,0 +1,110 @@
+--
+-- INSERT, UPDATE and DELETE
+--
+\! rm -f /tmp/simple_fdw_write.db
+\! sqlite3 /tmp/simple_fdw_write.db < test/fixtures/regress.sql
+CREATE SERVER write_server FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_write.db');
+CREATE FOREIGN TABLE notes (id bigint, body text)
+  SERVER write_server OPTIONS (table 'notes');
+INSERT INTO notes VALUES (1, 'first'), (2, 'second');
+-- SQLite picks the rowid
+INSERT INTO notes (body) VALUES ('third');
+SELECT * FROM notes ORDER BY id;
+-- the rows to change are found by their rowid
+UPDATE notes SET body = 'changed' WHERE id = 2;
+DELETE FROM notes WHERE body = 'first';
+SELECT * FROM notes ORDER BY id;
+SELECT ctid, * FROM notes ORDER BY id;
+-- errors and unsupported clauses
+INSERT INTO notes VALUES (2, 'duplicate');
+INSERT INTO notes VALUES (2, 'duplicate') ON CONFLICT DO NOTHING;
+INSERT INTO notes VALUES (4, 'fourth') RETURNING id;
+SELECT * FROM notes ORDER BY id;
+-- the changes follow the local transactions and subtransactions
+BEGIN;
+INSERT INTO notes VALUES (10, 'rolled back');
+SELECT count(*) FROM notes;
+ROLLBACK;
+SELECT count(*) FROM notes;
+-- the scans of a server can't be parallel while a SQLite transaction is
+-- open on it: the workers wouldn't see the changes not committed yet
+BEGIN;
+INSERT INTO notes VALUES (10, 'not committed');
+SET LOCAL parallel_setup_cost = 0;
+SET LOCAL parallel_tuple_cost = 0;
+SET LOCAL min_parallel_table_scan_size = 0;
+EXPLAIN (COSTS OFF) SELECT id, body FROM notes;
+SELECT id, body FROM notes ORDER BY id;
+ROLLBACK;
+BEGIN;
+UPDATE notes SET body = body || '!';
+SAVEPOINT s1;
+DELETE FROM notes;
+SELECT count(*) FROM notes;
+ROLLBACK TO SAVEPOINT s1;
+COMMIT;
+SELECT * FROM notes ORDER BY id;
+-- the tables of a server changed by a statement are read completely
+-- before the first change, joined or not, whatever their fetch size
+ALTER FOREIGN TABLE notes OPTIONS (ADD fetch_size '1');
+INSERT INTO notes SELECT id + 100, body FROM notes;
+INSERT INTO notes SELECT n1.id + 200, n2.body FROM notes n1 JOIN notes n2 USING (id)
+  WHERE n1.id < 100;
+SELECT * FROM notes ORDER BY id;
+DELETE FROM notes WHERE id >= 100;
+ALTER FOREIGN TABLE notes OPTIONS (DROP fetch_size);
+-- batched inserts
+ALTER FOREIGN TABLE notes OPTIONS (ADD batch_size '4');
+INSERT INTO notes SELECT g, 'note ' || g FROM generate_series(100, 109) g;
+SELECT count(*), min(id), max(id) FROM notes WHERE id >= 100;
+SELECT body FROM notes WHERE id = 105;
+-- COPY FROM
+COPY notes FROM stdin;
+200	copied
+201	\N
+\.
+SELECT * FROM notes WHERE id >= 200 ORDER BY id;
+-- WITHOUT ROWID tables are changed through their key columns
+CREATE FOREIGN TABLE kv (k text OPTIONS (key 'true'), v text)
+  SERVER write_server OPTIONS (table 'kv');
+UPDATE kv SET v = 'deux' WHERE k = 'b';
+DELETE FROM kv WHERE k = 'a';
+INSERT INTO kv VALUES ('c', 'three');
+SELECT * FROM kv ORDER BY k;
+-- dates and times are written in ISO style, and timestamptz in UTC, so that
+-- any session reads them back and finds the rows by their key
+\! sqlite3 /tmp/simple_fdw_write.db "CREATE TABLE events (at TEXT PRIMARY KEY, day TEXT, what TEXT)"
+CREATE FOREIGN TABLE events (at timestamptz OPTIONS (key 'true'), day date, what text)
+  SERVER write_server OPTIONS (table 'events');
+SET datestyle = 'SQL, DMY';
+SET timezone = 'Europe/Paris';
+INSERT INTO events VALUES ('2024-02-29 12:34:56', '2024-02-29', 'leap day');
+\! sqlite3 /tmp/simple_fdw_write.db "SELECT * FROM events"
+SET datestyle = 'ISO, MDY';
+SET timezone = 'America/New_York';
+SELECT * FROM events;
+UPDATE events SET what = 'changed' WHERE day = '2024-02-29';
+SELECT what FROM events;
+RESET datestyle;
+RESET timezone;
+-- a rowid above 2^48 can't be a ctid: such rows are changed by their key
+INSERT INTO notes VALUES (281474976710656, 'big');
+UPDATE notes SET body = 'bigger' WHERE id = 281474976710656;
+CREATE FOREIGN TABLE notes_by_id (id bigint OPTIONS (key 'true'), body text)
+  SERVER write_server OPTIONS (table 'notes');
+UPDATE notes_by_id SET body = 'bigger' WHERE id = 281474976710656;
+SELECT * FROM notes_by_id WHERE id = 281474976710656;
+DELETE FROM notes_by_id WHERE id = 281474976710656;
+-- the tables of a read-only server can't be changed
+CREATE SERVER write_readonly FOREIGN DATA WRAPPER simple_fdw
+  OPTIONS (database '/tmp/simple_fdw_write.db', readonly 'true');
+CREATE FOREIGN TABLE notes_readonly (id bigint, body text)
+  SERVER write_readonly OPTIONS (table 'notes');
+INSERT INTO notes_readonly VALUES (5, 'fifth');
+UPDATE notes_readonly SET body = NULL;
+SELECT count(*) FROM notes_readonly;
+-- cleanup
+SET client_min_messages = warning;
+DROP SERVER write_server CASCADE;
+DROP SERVER write_readonly CASCADE;